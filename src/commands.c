@@ -1,3 +1,5 @@
+#include <stdlib.h>
+#include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
@@ -6,6 +8,8 @@
 #include "commands.h"
 #include "file.h"
 #include "format.h"
+#include "patch.h"
+#include "statusbar.h"
 #include "util/log.h"
 #include "util/map.h"
 #include "util/pubsub.h"
@@ -30,9 +34,13 @@ static void it_init(ArgIterator* args, char* ptr);
 static bool quit(HEdit* hedit, bool force, ArgIterator* args, void* user) {
     
     // Do not exit if there's a dirty file open
-    if (hedit->file != NULL && hedit_file_is_dirty(hedit->file) && !force) {
-        log_error("There are unsaved changes. Save your changes with :write, or use :quit! to exit discarding changes.");
-        return false;
+    if (!force) {
+        for (size_t i = 0; i < hedit->buffers_len; i++) {
+            if (hedit_file_is_dirty(hedit->buffers[i]->file)) {
+                log_error("There are unsaved changes in buffer %zu. Save your changes with :write, or use :quit! to exit discarding changes.", i + 1);
+                return false;
+            }
+        }
     }
 
     tickit_stop(hedit->tickit);
@@ -41,90 +49,45 @@ static bool quit(HEdit* hedit, bool force, ArgIterator* args, void* user) {
 
 static bool edit(HEdit* hedit, bool force, ArgIterator* args, void* user) {
 
-    if (hedit->file != NULL && !force) {
-        log_error("Another file is already opened.");
-        return false;
-    }
-
     const char* path = it_next(args);
     if (path == NULL) {
         log_error(":edit requires path of file to open.");
         return false;
     }
 
+    // If the file is already open in another buffer, just switch to it
+    for (size_t i = 0; i < hedit->buffers_len; i++) {
+        const char* name = hedit_file_name(hedit->buffers[i]->file);
+        if (name != NULL && strcmp(name, path) == 0) {
+            return hedit_buffer_switch(hedit, i);
+        }
+    }
+
     File* f = hedit_file_open(path);
     if (f == NULL) {
         return false;
     }
 
-    if (hedit->file != NULL) {
-        HEditFileEvent ev = {
-            .e = {
-                .hedit = hedit,
-                .type = HEDIT_EVENT_TYPE_FILE_CLOSE
-            },
-            .file = hedit->file
-        };
-        pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_CLOSE, &ev);
-        hedit_file_close(hedit->file);
+    if (!hedit_buffer_open(hedit, f)) {
+        hedit_file_close(f);
+        return false;
     }
 
-    hedit->file = f;
-    hedit_format_guess(hedit);
-    
-    HEditFileEvent ev = {
-        .e = {
-            .hedit = hedit,
-            .type = HEDIT_EVENT_TYPE_FILE_OPEN
-        },
-        .file = hedit->file
-    };
-    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_OPEN, &ev);
-
-    hedit_switch_view(hedit, HEDIT_VIEW_EDIT);
-
     return true;
 }
 
 static bool new(HEdit* hedit, bool force, ArgIterator* args, void* user) {
 
-    if (hedit->file != NULL && !force) {
-        log_error("Another file is already opened.");
-        return false;
-    }
-
     File* f = hedit_file_open(NULL);
     if (f == NULL) {
         return false;
     }
 
-    // Close the exiting file (if any)
-    if (hedit->file != NULL) {
-        HEditFileEvent ev = {
-            .e = {
-                .hedit = hedit,
-                .type = HEDIT_EVENT_TYPE_FILE_CLOSE
-            },
-            .file = hedit->file
-        };
-        pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_CLOSE, &ev);
-        hedit_file_close(hedit->file);
+    if (!hedit_buffer_open(hedit, f)) {
+        hedit_file_close(f);
+        return false;
     }
 
-    hedit->file = f;
-    hedit_format_guess(hedit);
-    
-    HEditFileEvent ev = {
-        .e = {
-            .hedit = hedit,
-            .type = HEDIT_EVENT_TYPE_FILE_OPEN
-        },
-        .file = hedit->file
-    };
-    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_OPEN, &ev);
-
-    hedit_switch_view(hedit, HEDIT_VIEW_EDIT);
-
     return true;
 }
 
@@ -140,22 +103,76 @@ static bool close(HEdit* hedit, bool force, ArgIterator* args, void* user) {
         return false;
     }
 
-    HEditFileEvent ev = {
-        .e = {
-            .hedit = hedit,
-            .type = HEDIT_EVENT_TYPE_FILE_CLOSE
-        },
-        .file = hedit->file
-    };
-    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_CLOSE, &ev);
+    hedit_buffer_close(hedit);
+    return true;
 
-    hedit_file_close(hedit->file);
-    hedit->file = NULL;
+}
 
-    hedit_switch_view(hedit, HEDIT_VIEW_SPLASH);
+static bool buffer(HEdit* hedit, bool force, ArgIterator* args, void* user) {
 
-    return true;
+    // Buffers are numbered starting from 1, like in `:ls`
+    const char* arg = it_next(args);
+    int n;
+    if (arg == NULL || !str2int(arg, 10, &n) || n <= 0) {
+        log_error("Usage: buffer <number>");
+        return false;
+    }
+
+    return hedit_buffer_switch(hedit, n - 1);
+}
 
+static bool bnext(HEdit* hedit, bool force, ArgIterator* args, void* user) {
+    if (hedit->buffers_len == 0) {
+        log_error("No file open.");
+        return false;
+    }
+    return hedit_buffer_switch(hedit, (hedit->current_buffer + 1) % hedit->buffers_len);
+}
+
+static bool bprevious(HEdit* hedit, bool force, ArgIterator* args, void* user) {
+    if (hedit->buffers_len == 0) {
+        log_error("No file open.");
+        return false;
+    }
+    return hedit_buffer_switch(hedit, (hedit->current_buffer + hedit->buffers_len - 1) % hedit->buffers_len);
+}
+
+static bool ls(HEdit* hedit, bool force, ArgIterator* args, void* user) {
+
+    if (hedit->buffers_len == 0) {
+        log_error("No file open.");
+        return false;
+    }
+
+    // Show all the buffers on a single line, marking the current one with `%` and the modified ones with `+`.
+    // The first pass measures the line, the second one writes it.
+    char* msg = NULL;
+    size_t size = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t len = 0;
+        for (size_t i = 0; i < hedit->buffers_len; i++) {
+            File* f = hedit->buffers[i]->file;
+            const char* name = hedit_file_name(f);
+            len += snprintf(msg != NULL ? msg + len : NULL, msg != NULL ? size - len : 0, "%s%zu%s %s%s",
+                            i > 0 ? "  " : "",
+                            i + 1,
+                            i == hedit->current_buffer ? "%" : "",
+                            name != NULL ? name : "[No Name]",
+                            hedit_file_is_dirty(f) ? " +" : "");
+        }
+        if (msg == NULL) {
+            size = len + 1;
+            msg = malloc(size);
+            if (msg == NULL) {
+                log_fatal("Out of memory.");
+                return false;
+            }
+        }
+    }
+
+    hedit_statusbar_show_message(hedit->statusbar, false, msg);
+    free(msg);
+    return true;
 }
 
 static bool write(HEdit* hedit, bool force, ArgIterator* args, void* user) {
@@ -245,11 +262,40 @@ static bool map(HEdit* hedit, bool force, ArgIterator* args, void* user) {
     return hedit_map_keys(hedit, mode->id, from, to, force);
 }
 
+static bool patch(HEdit* hedit, bool force, ArgIterator* args, void* user) {
+
+    if (hedit->file == NULL) {
+        log_error("No file open.");
+        return false;
+    }
+
+    const char* action = it_next(args);
+    const char* path = it_next(args);
+    if (action == NULL || path == NULL) {
+        log_error("Usage: patch apply|export <file>");
+        return false;
+    }
+
+    if (strcmp(action, "apply") == 0) {
+        return hedit_patch_apply(hedit->file, path);
+    } else if (strcmp(action, "export") == 0) {
+        return hedit_patch_export(hedit->file, path);
+    } else {
+        log_error("Unknown patch action: %s. Usage: patch apply|export <file>", action);
+        return false;
+    }
+}
+
 static bool logview(HEdit* hedit, bool force, ArgIterator* args, void* user) {
     hedit_switch_view(hedit, HEDIT_VIEW_LOG);
     return true;
 }
 
+static bool statsview(HEdit* hedit, bool force, ArgIterator* args, void* user) {
+    hedit_switch_view(hedit, HEDIT_VIEW_STATS);
+    return true;
+}
+
 
 
 // ----------------------------------------------------------------------------
@@ -316,7 +362,13 @@ bool hedit_init_commands(HEdit* hedit) {
     REG(wq);
     REG(set);
     REG(map);
+    REG(patch);
+    REG2(buffer, b);
+    REG2(bnext, bn);
+    REG2(bprevious, bp);
+    REG2(ls, buffers);
     hedit_command_register(hedit, "log", logview, NULL, NULL);
+    hedit_command_register(hedit, "stats", statsview, NULL, NULL);
 
     return true;
 
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <assert.h>
 #include <string.h>
 #include <strings.h>
@@ -16,6 +17,8 @@
 #include "util/map.h"
 #include "util/buffer.h"
 #include "util/pubsub.h"
+#include "util/metrics.h"
+#include "util/trace.h"
 
 
 static bool mode_command_on_enter(HEdit* hedit, Mode* prev) {
@@ -239,6 +242,183 @@ void hedit_switch_view(HEdit* hedit, enum Views v) {
 
 
 
+Document* hedit_buffer_current(HEdit* hedit) {
+    return hedit->buffers_len > 0 ? hedit->buffers[hedit->current_buffer] : NULL;
+}
+
+static void publish_option_change(HEdit* hedit, Option* opt) {
+    HEditOptionEvent ev = {
+        .e = {
+            .hedit = hedit,
+            .type = HEDIT_EVENT_TYPE_OPTION_CHANGE
+        },
+        .option = opt
+    };
+    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_OPTION_CHANGE, &ev);
+}
+
+/** Moves the state of the active document from the global state to the document itself. */
+static void document_stash(HEdit* hedit) {
+    Document* doc = hedit_buffer_current(hedit);
+    if (doc == NULL) {
+        return;
+    }
+
+    doc->format = hedit->format;
+    hedit->format = NULL;
+
+    // The `format` option reflects the format of the active document
+    Option* opt = hedit_option_get(hedit, "format");
+    if (opt != NULL) {
+        char* empty = strdup("");
+        if (empty == NULL) {
+            log_fatal("Out of memory.");
+            return;
+        }
+        doc->format_name = opt->value.str;
+        opt->value.str = empty;
+    }
+}
+
+/** Makes the document at the given index the active one, restoring its state. */
+static void document_activate(HEdit* hedit, size_t index) {
+    Document* doc = hedit->buffers[index];
+
+    hedit->current_buffer = index;
+    hedit->file = doc->file;
+    hedit->format = doc->format;
+    doc->format = NULL;
+
+    Option* opt = hedit_option_get(hedit, "format");
+    if (opt != NULL) {
+        free(opt->value.str);
+        opt->value.str = doc->format_name;
+        doc->format_name = NULL;
+        publish_option_change(hedit, opt);
+    }
+
+    // Let the edit view pick up the state of the new document
+    if (hedit->view != NULL && hedit->view->id == HEDIT_VIEW_EDIT) {
+        hedit->view->on_enter(hedit, hedit->view);
+    }
+
+    HEditFileEvent ev = {
+        .e = {
+            .hedit = hedit,
+            .type = HEDIT_EVENT_TYPE_BUFFER_SWITCH
+        },
+        .file = hedit->file
+    };
+    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_BUFFER_SWITCH, &ev);
+
+    hedit_statusbar_show_message(hedit->statusbar, false, NULL);
+    hedit_redraw(hedit);
+}
+
+static void document_free(Document* doc) {
+    hedit_file_close(doc->file);
+    if (doc->format != NULL) {
+        hedit_format_free(doc->format);
+    }
+    free(doc->format_name);
+    free(doc->view_state);
+    free(doc);
+}
+
+bool hedit_buffer_open(HEdit* hedit, File* file) {
+
+    Document* doc = calloc(1, sizeof(Document));
+    Document** buffers = realloc(hedit->buffers, sizeof(Document*) * (hedit->buffers_len + 1));
+    if (doc == NULL || buffers == NULL) {
+        log_fatal("Out of memory.");
+        free(doc);
+        return false;
+    }
+    hedit->buffers = buffers;
+    doc->file = file;
+
+    // New documents start without a format, so that the guess below always sets one
+    if ((doc->format_name = strdup("")) == NULL) {
+        log_fatal("Out of memory.");
+        free(doc);
+        return false;
+    }
+
+    document_stash(hedit);
+    hedit->buffers[hedit->buffers_len++] = doc;
+    document_activate(hedit, hedit->buffers_len - 1);
+    hedit_format_guess(hedit);
+
+    HEditFileEvent ev = {
+        .e = {
+            .hedit = hedit,
+            .type = HEDIT_EVENT_TYPE_FILE_OPEN
+        },
+        .file = hedit->file
+    };
+    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_OPEN, &ev);
+
+    hedit_switch_view(hedit, HEDIT_VIEW_EDIT);
+
+    return true;
+}
+
+bool hedit_buffer_switch(HEdit* hedit, size_t index) {
+    if (index >= hedit->buffers_len) {
+        log_error("No buffer %zu.", index + 1);
+        return false;
+    }
+    if (index == hedit->current_buffer) {
+        return true;
+    }
+
+    document_stash(hedit);
+    document_activate(hedit, index);
+    hedit_switch_view(hedit, HEDIT_VIEW_EDIT);
+    return true;
+}
+
+void hedit_buffer_close(HEdit* hedit) {
+    Document* doc = hedit_buffer_current(hedit);
+    if (doc == NULL) {
+        return;
+    }
+
+    HEditFileEvent ev = {
+        .e = {
+            .hedit = hedit,
+            .type = HEDIT_EVENT_TYPE_FILE_CLOSE
+        },
+        .file = hedit->file
+    };
+    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_CLOSE, &ev);
+
+    // Remove the document from the list
+    size_t index = hedit->current_buffer;
+    document_stash(hedit);
+    memmove(hedit->buffers + index, hedit->buffers + index + 1, sizeof(Document*) * (hedit->buffers_len - index - 1));
+    hedit->buffers_len--;
+
+    if (hedit->buffers_len > 0) {
+        document_activate(hedit, MIN(index, hedit->buffers_len - 1));
+    } else {
+        hedit->file = NULL;
+        hedit->current_buffer = 0;
+
+        // No document is activated to publish the empty `format` option
+        Option* opt = hedit_option_get(hedit, "format");
+        if (opt != NULL) {
+            publish_option_change(hedit, opt);
+        }
+        hedit_switch_view(hedit, HEDIT_VIEW_SPLASH);
+    }
+
+    // Free the document only after the switch, so that the views never see a dangling state
+    document_free(doc);
+}
+
+
+
 static Theme* default_theme() {
 
     Theme* theme = malloc(sizeof(Theme));
@@ -406,16 +586,16 @@ void hedit_switch_theme(HEdit* hedit, Theme* newtheme) {
 
 
 
-bool hedit_option_register(HEdit* hedit, const char* name, enum OptionType type, const Value default_value,
-                           bool (*on_change)(HEdit*, Option*, const Value*, void* user),
-                           void (*free_f)(HEdit*, Option*, void* user), void* user)
+Option* hedit_option_register(HEdit* hedit, const char* name, enum OptionType type, const Value default_value,
+                              bool (*on_change)(HEdit*, Option*, const Value*, void* user),
+                              void (*free_f)(HEdit*, Option*, void* user), void* user)
 {
     assert(type >= HEDIT_OPTION_TYPE_INT && type <= HEDIT_OPTION_TYPE_MAX);
 
     Option* opt = malloc(sizeof(Option));
     if (opt == NULL) {
         log_fatal("Out of memory.");
-        return false;
+        return NULL;
     }
 
     if (!map_put(hedit->options, name, opt)) {
@@ -423,7 +603,7 @@ bool hedit_option_register(HEdit* hedit, const char* name, enum OptionType type,
             log_fatal("Out of memory.");
         }
         free(opt);
-        return false;
+        return NULL;
     }
 
     opt->name = name;
@@ -442,13 +622,17 @@ bool hedit_option_register(HEdit* hedit, const char* name, enum OptionType type,
             log_fatal("Out of memory.");
             map_delete(hedit->options, name);
             free(opt);
-            return false;
+            return NULL;
         }
         opt->default_value = (Value){ .str = dup };
         opt->value = (Value){ .str = dup2 };
     }
     
-    return true;
+    return opt;
+}
+
+Option* hedit_option_get(HEdit* hedit, const char* name) {
+    return map_get(hedit->options, name);
 }
 
 bool hedit_option_set(HEdit* hedit, const char* name, const char* newstr) {
@@ -553,6 +737,7 @@ bool hedit_option_set(HEdit* hedit, const char* name, const char* newstr) {
 
     opt->value = newvalue;
     log_debug("New value for option %s: %s", name, newstr);
+    publish_option_change(hedit, opt);
 
     return true;
 
@@ -580,6 +765,10 @@ static bool option_colwidth(HEdit* hedit, Option* opt, const Value* v, void* use
     }
 }
 
+static bool option_logsize(HEdit* hedit, Option* opt, const Value* v, void* user) {
+    return v->i > 0 && hedit_log_view_resize(v->i);
+}
+
 static bool option_cb_redraw(HEdit* hedit, Option* opt, const Value* v, void* user) {
     hedit_redraw(hedit);
     return true;
@@ -595,16 +784,20 @@ static bool init_builtin_options(HEdit* hedit) {
     // Register all the options!
 
 #define REG(name, type, def, on_change) \
-    if (!hedit_option_register(hedit, name, HEDIT_OPTION_TYPE_##type, (const Value) def, on_change, NULL, NULL)) { \
-        return false; \
-    }
+    hedit_option_register(hedit, name, HEDIT_OPTION_TYPE_##type, (const Value) def, on_change, NULL, NULL)
 
-    REG("colwidth",    INT,   { .i = 16   },  option_colwidth);
-    REG("lineoffset",  BOOL,  { .b = true },  option_cb_redraw);
+    // Keep the handles of the options read on every frame
+    if ((hedit->builtin_options.colwidth   = REG("colwidth",    INT,   { .i = 16   },  option_colwidth)) == NULL ||
+        (hedit->builtin_options.lineoffset = REG("lineoffset",  BOOL,  { .b = true },  option_cb_redraw)) == NULL ||
+        REG("logsize", INT, { .i = HEDIT_LOG_VIEW_DEFAULT_SIZE }, option_logsize) == NULL) {
+        return false;
+    }
 
 #ifndef WITH_V8
     // Provide an always "none" format option if V8 is not available
-    REG("format", STRING, { .str = "none" }, option_cb_redraw);
+    if (REG("format", STRING, { .str = "none" }, option_cb_redraw) == NULL) {
+        return false;
+    }
 #endif
 
 #undef REG
@@ -623,11 +816,22 @@ static int on_viewwin_expose(TickitWindow* win, TickitEventFlags flags, void* in
 
     HEdit* hedit = user;
     TickitExposeEventInfo* e = info;
+    static Metric* exposes = NULL;
+    static Metric* draw_time = NULL;
+    if (exposes == NULL) {
+        exposes = metrics_counter("view.exposes");
+        draw_time = metrics_histogram("view.draw_time");
+    }
 
     // Delegate the drawing of the main window to the current view
     assert(hedit->view != NULL);
+    TRACE_BEGIN_ARG("on_viewwin_expose", hedit->view->name);
+    uint64_t start = metrics_now();
     tickit_renderbuffer_eraserect(e->rb, &e->rect);
     hedit->view->on_draw(hedit, win, e);
+    metrics_add(exposes, 1);
+    metrics_observe(draw_time, metrics_now() - start);
+    TRACE_END("on_viewwin_expose");
 
     return 1;
 }
@@ -669,7 +873,14 @@ static int on_keypress(TickitWindow* win, TickitEventFlags flags, void* info, vo
         snprintf(key, 30, "<%s>", e->str);
     }
 
+    // Record the key with the time it arrived, so that the session can be replayed
+    if (hedit->key_recording != NULL) {
+        fprintf(hedit->key_recording, "%llu\t%s\n", (unsigned long long) (metrics_now() - hedit->key_recording_start), key);
+    }
+
+    TRACE_BEGIN_ARG("on_keypress", key);
     hedit_emit_keys(hedit, key);
+    TRACE_END("on_keypress");
     
     return 1;
 
@@ -732,6 +943,8 @@ bool hedit_map_keys(HEdit* hedit, enum Modes m, const char* from, const char* to
 
 void hedit_emit_keys(HEdit* hedit, const char* keys) {
     
+    TRACE_BEGIN_ARG("hedit_emit_keys", keys);
+
     // Split each single key
     char buf[20];
     size_t keys_len = strlen(keys);
@@ -776,13 +989,19 @@ void hedit_emit_keys(HEdit* hedit, const char* keys) {
 
         // Invoke the action, or pass the key as raw input
         if (a != NULL) {
+            TRACE_BEGIN_ARG("action", buf);
             a->cb(hedit, &a->arg);
+            TRACE_END("action");
         } else if (hedit->mode->on_input != NULL) {
+            TRACE_BEGIN_ARG("on_input", buf);
             hedit->mode->on_input(hedit, buf);
+            TRACE_END("on_input");
         }
 
     }
 
+    TRACE_END("hedit_emit_keys");
+
 }
 
 HEdit* hedit_core_init(Options* cli_options, Tickit* tickit) {
@@ -793,6 +1012,7 @@ HEdit* hedit_core_init(Options* cli_options, Tickit* tickit) {
         INIT_VIEW(HEDIT_VIEW_SPLASH);
         INIT_VIEW(HEDIT_VIEW_LOG);
         INIT_VIEW(HEDIT_VIEW_EDIT);
+        INIT_VIEW(HEDIT_VIEW_STATS);
 #pragma GCC diagnostic warning "-Wimplicit-function-declaration"
     }
 
@@ -806,6 +1026,16 @@ HEdit* hedit_core_init(Options* cli_options, Tickit* tickit) {
     hedit->tickit = tickit;
     hedit->rootwin = tickit_get_rootwin(tickit);
     hedit->exit = false;
+
+    // Open the file to record the keys to
+    if (cli_options->record_keys != NULL) {
+        hedit->key_recording = fopen(cli_options->record_keys, "w");
+        if (hedit->key_recording == NULL) {
+            log_fatal("Cannot open %s: %s.", cli_options->record_keys, strerror(errno));
+            goto error;
+        }
+        hedit->key_recording_start = metrics_now();
+    }
     
     // Initialize default builtin options
     if (!init_builtin_options(hedit)) {
@@ -875,6 +1105,9 @@ error:
             tickit_window_destroy(hedit->viewwin);
         }
         hedit_statusbar_teardown(hedit->statusbar);
+        if (hedit->key_recording != NULL) {
+            fclose(hedit->key_recording);
+        }
         free(hedit);
     }
 
@@ -905,14 +1138,11 @@ void hedit_core_teardown(HEdit* hedit) {
 
     // Clear the buffers
     buffer_free(hedit->command_buffer);
-    if (hedit->file != NULL) {
-        hedit_file_close(hedit->file);
-    }
-    
-    // File format
-    if (hedit->format != NULL) {
-        hedit_format_free(hedit->format);
+    document_stash(hedit);
+    for (size_t i = 0; i < hedit->buffers_len; i++) {
+        document_free(hedit->buffers[i]);
     }
+    free(hedit->buffers);
 
     // Free the theme
     if (hedit->theme != NULL) {
@@ -931,6 +1161,11 @@ void hedit_core_teardown(HEdit* hedit) {
     tickit_window_close(hedit->viewwin);
     tickit_window_destroy(hedit->viewwin);
 
+    // Stop recording the keys
+    if (hedit->key_recording != NULL) {
+        fclose(hedit->key_recording);
+    }
+
     // Terminate V8
 #ifdef WITH_V8
     hedit_js_teardown(hedit);
@@ -1,7 +1,9 @@
 #ifndef __CORE_H__
 #define __CORE_H__
 
+#include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <tickit.h>
 
 typedef struct HEdit HEdit;
@@ -85,6 +87,7 @@ enum Views {
     HEDIT_VIEW_SPLASH = 1,
     HEDIT_VIEW_LOG,
     HEDIT_VIEW_EDIT,
+    HEDIT_VIEW_STATS,
     HEDIT_VIEW_MAX
 };
 
@@ -119,6 +122,12 @@ struct View {
 /** Global definition of all the available views. */
 extern View hedit_views[];
 
+/** Number of messages kept by the log view, until changed with the `logsize` option. */
+#define HEDIT_LOG_VIEW_DEFAULT_SIZE 10000
+
+/** Changes the number of messages kept by the log view, keeping the most recent ones. */
+bool hedit_log_view_resize(size_t size);
+
 #define INIT_VIEW(v) __init_view_##v()
 #define REGISTER_VIEW(id, def) REGISTER_VIEW2(id, def, {})
 #define REGISTER_VIEW2(id, definition, init_block) \
@@ -150,6 +159,21 @@ struct Option {
 
 
 
+/**
+ * A file open in the editor, together with the state that belongs to it:
+ * the format used to highlight it and the cursor position in the edit view.
+ * The editor keeps a list of documents (the buffers listed by `:ls`), and only one of them is active.
+ */
+typedef struct Document Document;
+struct Document {
+    File* file;
+    Format* format; // Valid only while the document is in background, see `HEdit.format`
+    char* format_name; // Value of the `format` option while the document is in background
+    void* view_state; // Private state of the edit view for this document
+};
+
+
+
 /**
  * Global state of the editor.
  * Contains eveything needed to describe the precise state of HEdit:
@@ -161,10 +185,17 @@ struct HEdit {
 
     // Components
     Map* options; // Map of Option*
+    struct {
+        Option* colwidth;
+        Option* lineoffset;
+    } builtin_options; // Handles of the options read on every frame
     Map* commands; // Map of Command*
     Mode* mode;
-    File* file;
-    Format* format;
+    File* file; // File of the active document
+    Format* format; // Format of the active document
+    Document** buffers;
+    size_t buffers_len;
+    size_t current_buffer;
     View* view;
     void* viewdata; // Private state of the current view
     Statusbar* statusbar;
@@ -179,6 +210,10 @@ struct HEdit {
     int on_resize_bind_id;
     int on_viewwin_expose_bind_id;
 
+    // Recording of the keys pressed, if requested from the cli
+    FILE* key_recording;
+    uint64_t key_recording_start;
+
     // Exit flag and exit code
     bool exit;
     int exitcode;
@@ -195,7 +230,9 @@ typedef enum HEditEventType {
     HEDIT_EVENT_TYPE_FILE_OPEN,
     HEDIT_EVENT_TYPE_FILE_WRITE,
     HEDIT_EVENT_TYPE_FILE_CLOSE,
-    HEDIT_EVENT_TYPE_FILE_CHANGE
+    HEDIT_EVENT_TYPE_FILE_CHANGE,
+    HEDIT_EVENT_TYPE_BUFFER_SWITCH,
+    HEDIT_EVENT_TYPE_OPTION_CHANGE
 } HEditEventType;
 
 
@@ -208,6 +245,8 @@ typedef enum HEditEventType {
 #define HEDIT_EVENT_TOPIC_FILE_WRITE        "hedit/file/write"
 #define HEDIT_EVENT_TOPIC_FILE_CLOSE        "hedit/file/close"
 #define HEDIT_EVENT_TOPIC_FILE_CHANGE       "hedit/file/change"
+#define HEDIT_EVENT_TOPIC_BUFFER_SWITCH     "hedit/buffer-switch"
+#define HEDIT_EVENT_TOPIC_OPTION_CHANGE     "hedit/option-change"
 
 
 
@@ -250,6 +289,13 @@ typedef struct HEditFileChangeEvent {
 
 
 
+typedef struct HEditOptionEvent {
+    HEditEvent e;
+    Option* option;
+} HEditOptionEvent;
+
+
+
 /**
  * Initializes a new global state.
  * This function should be called only once at the beginning of the program.
@@ -288,15 +334,42 @@ void hedit_switch_mode(HEdit* hedit, enum Modes m);
 void hedit_switch_theme(HEdit* hedit, Theme* theme);
 
 
-/** Registers a new option. */
-bool hedit_option_register(HEdit* hedit, const char* name, enum OptionType type, const Value default_value,
-                           bool (*on_change)(HEdit*, Option*, const Value*, void* user),
-                           void (*free)(HEdit*, Option*, void* user), void* user);
+/**
+ * Registers a new option.
+ *
+ * @return A handle to the option, valid until the editor is torn down, or NULL in case of error.
+ *         Its `value` is always the current one, so it can be read without looking the option up by name.
+ */
+Option* hedit_option_register(HEdit* hedit, const char* name, enum OptionType type, const Value default_value,
+                              bool (*on_change)(HEdit*, Option*, const Value*, void* user),
+                              void (*free)(HEdit*, Option*, void* user), void* user);
 
-/** Changes the value of an option. */
+/** Returns a handle to the option with the given name, or NULL if the option does not exist. */
+Option* hedit_option_get(HEdit* hedit, const char* name);
+
+/**
+ * Changes the value of an option.
+ * On success, the change is published on `HEDIT_EVENT_TOPIC_OPTION_CHANGE`.
+ */
 bool hedit_option_set(HEdit* hedit, const char* name, const char* newvalue);
 
 
+/**
+ * Adds a newly opened file to the list of buffers and makes it the active one.
+ * The buffer takes ownership of the file.
+ */
+bool hedit_buffer_open(HEdit* hedit, File* file);
+
+/** Makes active the buffer at the given index. */
+bool hedit_buffer_switch(HEdit* hedit, size_t index);
+
+/** Closes the active buffer and switches to the next one, if any. */
+void hedit_buffer_close(HEdit* hedit);
+
+/** Returns the active document, or NULL if no file is open. */
+Document* hedit_buffer_current(HEdit* hedit);
+
+
 /** Returns the view with the given name, or NULL if the view does not exist. */
 View* hedit_view_from_name(const char*);
 
@@ -15,6 +15,8 @@
 #include "util/log.h"
 #include "util/common.h"
 #include "util/list.h"
+#include "util/metrics.h"
+#include "util/trace.h"
 
 // TODO: This is horrible.
 #include "core.h"
@@ -168,6 +170,15 @@ struct FileIterator {
     Piece* current_piece;
 };
 
+// Metrics shared by all the open files
+static struct {
+    Metric* pieces;
+    Metric* mmap_bytes;
+    Metric* malloc_bytes;
+    Metric* revisions;
+    Metric* changes;
+} metrics;
+
 
 // Functions to manage blocks
 static Block* block_alloc(File*, size_t);
@@ -219,6 +230,7 @@ static Block* block_alloc(File* file, size_t size) {
 
     // Add the created block to the list of all blocks for tracking
     list_add_tail(&file->all_blocks, &block->list);
+    metrics_add(metrics.malloc_bytes, block->size);
 
     return block;
 
@@ -244,6 +256,7 @@ static Block* block_alloc_mmap(File* file, int fd, size_t size) {
 
     // Add the created block to the list of all blocks for tracking
     list_add_tail(&file->all_blocks, &block->list);
+    metrics_add(metrics.mmap_bytes, block->size);
 
     return block;
    
@@ -253,9 +266,11 @@ static void block_free(File* file, Block* block) {
     switch (block->type) {
         case BLOCK_MALLOC:
             free(block->data);
+            metrics_add(metrics.malloc_bytes, -(int64_t) block->size);
             break;
         case BLOCK_MMAP:
             munmap(block->data, block->size);
+            metrics_add(metrics.mmap_bytes, -(int64_t) block->size);
             break;
         default:
             abort();
@@ -290,6 +305,7 @@ static Piece* piece_alloc(File* file) {
     list_init(&piece->global_list);
 
     list_add_tail(&file->all_pieces, &piece->global_list);
+    metrics_add(metrics.pieces, 1);
 
     return piece;
 }
@@ -297,6 +313,7 @@ static Piece* piece_alloc(File* file) {
 static void piece_free(Piece* piece) {
     list_del(&piece->global_list);
     free(piece);
+    metrics_add(metrics.pieces, -1);
 }
 
 static bool piece_find(File* file, size_t abs, Piece** piece, size_t* offset) {
@@ -440,6 +457,7 @@ static Change* change_alloc(File* file, size_t pos) {
     span_init(&change->replacement, NULL, NULL);
 
     list_add_tail(&file->pending_changes, &change->list);
+    metrics_add(metrics.changes, 1);
     return change;
 }
 
@@ -451,6 +469,7 @@ static void change_free(Change* change, bool free_pieces) {
         }
     }
     free(change);
+    metrics_add(metrics.changes, -1);
 }
 
 static Revision* revision_alloc(File* file) {
@@ -463,6 +482,7 @@ static Revision* revision_alloc(File* file) {
     list_init(&rev->list);
 
     list_add_tail(&file->all_revisions, &rev->list);
+    metrics_add(metrics.revisions, 1);
 
     return rev;
 }
@@ -472,6 +492,7 @@ static void revision_free(Revision* rev, bool free_pieces) {
         change_free(change, free_pieces);
     }
     free(rev);
+    metrics_add(metrics.revisions, -1);
 }
 
 static bool revision_purge(File* file) {
@@ -514,11 +535,30 @@ static void publish_change(File* file, size_t offset, size_t len) {
         .offset = offset,
         .len = len
     };
-    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_CHANGE, &ev);
+
+    // This is published for every edit, so intern the topic once per thread like the default context
+    static __thread int topic = -1;
+    PubSub* pubsub = pubsub_default();
+    if (topic < 0) {
+        topic = pubsub_topic_intern(pubsub, HEDIT_EVENT_TOPIC_FILE_CHANGE);
+    }
+
+    TRACE_BEGIN("publish_change");
+    pubsub_publish_interned(pubsub, topic, &ev);
+    TRACE_END("publish_change");
 }
 
 File* hedit_file_open(const char* path) {
 
+    // Look up the metrics once
+    if (metrics.pieces == NULL) {
+        metrics.pieces = metrics_counter("file.pieces");
+        metrics.mmap_bytes = metrics_counter("file.blocks.mmap_bytes");
+        metrics.malloc_bytes = metrics_counter("file.blocks.malloc_bytes");
+        metrics.revisions = metrics_counter("file.revisions");
+        metrics.changes = metrics_counter("file.changes");
+    }
+
     // Initialize a new File structure
     File* file = calloc(1, sizeof(File));
     if (file == NULL) {
@@ -935,7 +975,7 @@ bool hedit_file_is_dirty(File* file) {
     return file->dirty;
 }
 
-bool hedit_file_insert(File* file, size_t offset, const unsigned char* data, size_t len) {
+static bool file_insert(File* file, size_t offset, const unsigned char* data, size_t len) {
 
     if (len == 0) {
         return true;
@@ -1092,7 +1132,14 @@ success:
 
 }
 
-bool hedit_file_delete(File* file, size_t offset, size_t len) {
+bool hedit_file_insert(File* file, size_t offset, const unsigned char* data, size_t len) {
+    TRACE_BEGIN("hedit_file_insert");
+    bool ok = file_insert(file, offset, data, len);
+    TRACE_END("hedit_file_insert");
+    return ok;
+}
+
+static bool file_delete(File* file, size_t offset, size_t len) {
 
     if (len == 0) {
         return true;
@@ -1190,6 +1237,13 @@ success:
 
 }
 
+bool hedit_file_delete(File* file, size_t offset, size_t len) {
+    TRACE_BEGIN("hedit_file_delete");
+    bool ok = file_delete(file, offset, len);
+    TRACE_END("hedit_file_delete");
+    return ok;
+}
+
 bool hedit_file_replace(File* file, size_t offset, const unsigned char* data, size_t len) {
     // A replacement is just a convenience shortcut for insertion and deletion
     if (hedit_file_delete(file, offset, len)) {
@@ -1223,7 +1277,7 @@ bool hedit_file_commit_revision(File* file) {
     return true;
 }
 
-bool hedit_file_undo(File* file, size_t* pos) {
+static bool file_undo(File* file, size_t* pos) {
 
     // Commit any pending change
     if (!hedit_file_commit_revision(file)) {
@@ -1252,7 +1306,14 @@ bool hedit_file_undo(File* file, size_t* pos) {
 
 }
 
-bool hedit_file_redo(File* file, size_t* pos) {
+bool hedit_file_undo(File* file, size_t* pos) {
+    TRACE_BEGIN("hedit_file_undo");
+    bool ok = file_undo(file, pos);
+    TRACE_END("hedit_file_undo");
+    return ok;
+}
+
+static bool file_redo(File* file, size_t* pos) {
     
     // Commit any pending change
     if (!hedit_file_commit_revision(file)) {
@@ -1283,6 +1344,39 @@ bool hedit_file_redo(File* file, size_t* pos) {
 
 }
 
+bool hedit_file_redo(File* file, size_t* pos) {
+    TRACE_BEGIN("hedit_file_redo");
+    bool ok = file_redo(file, pos);
+    TRACE_END("hedit_file_redo");
+    return ok;
+}
+
+bool hedit_file_rollback(File* file) {
+    size_t pos;
+    if (!hedit_file_undo(file, &pos)) {
+        return false;
+    }
+    revision_purge(file);
+    return true;
+}
+
+bool hedit_file_original(File* file, const unsigned char** data, size_t* len) {
+
+    // The original contents are always the first block, and they are always mmapped
+    if (!list_empty(&file->all_blocks)) {
+        Block* b = list_first(&file->all_blocks, Block, list);
+        if (b->type == BLOCK_MMAP) {
+            *data = b->data;
+            *len = b->len;
+            return true;
+        }
+    }
+
+    *data = NULL;
+    *len = 0;
+    return false;
+}
+
 bool hedit_file_read_byte(File* file, size_t offset, unsigned char* out) {
     Piece* p;
     size_t p_offset;
@@ -1367,6 +1461,11 @@ bool hedit_file_iter_next(FileIterator* it, const unsigned char** data, size_t*
 
 }
 
+bool hedit_file_iter_stable(FileIterator* it) {
+    // Only the cached piece is ever modified in place
+    return it->current_piece != NULL && it->current_piece != it->file->cache;
+}
+
 void hedit_file_iter_free(FileIterator* it) {
     free(it);
 }
\ No newline at end of file
@@ -60,6 +60,18 @@ bool hedit_file_undo(File*, size_t* pos);
 /** Redoes an undone modification. `*pos` contains the location of the last change, if the file changed. */
 bool hedit_file_redo(File*, size_t* pos);
 
+/**
+ * Undoes the last revision, committing any pending change first, and discards it so that it cannot be redone.
+ * Meant to roll back a group of edits that failed halfway.
+ */
+bool hedit_file_rollback(File*);
+
+/**
+ * Returns the original contents of the file, as they were on disk when the file was opened.
+ * Returns `false` and sets `*data` to NULL and `*len` to 0 if the file was empty or created from scratch.
+ */
+bool hedit_file_original(File*, const unsigned char** data, size_t* len);
+
 /** Reads a single byte from the file. */
 bool hedit_file_read_byte(File*, size_t offset, unsigned char* out);
 
@@ -83,6 +95,12 @@ FileIterator* hedit_file_iter(File*, size_t start, size_t len);
  */
 bool hedit_file_iter_next(FileIterator*, const unsigned char** data, size_t* len);
 
+/**
+ * Returns whether the data returned by the last call to `hedit_file_iter_next` is stable,
+ * i.e. it will never be modified in place by later edits and stays valid until the file is closed.
+ */
+bool hedit_file_iter_stable(FileIterator*);
+
 /** Releases all the resources held by the given iterator. */
 void hedit_file_iter_free(FileIterator*);
 
@@ -21,6 +21,10 @@ FormatSegment* hedit_format_iter_current(FormatIterator* it) {
     return NULL;
 }
 
+const char* hedit_format_iter_name(FormatIterator* it) {
+    return NULL;
+}
+
 FormatSegment* hedit_format_iter_next(FormatIterator* it) {
     return NULL;
 }
@@ -3,13 +3,14 @@
 
 #include <stdlib.h>
 #include "build-config.h"
+#include "util/segindex.h"
 
 
 #define MAX_SEGMENT_NAME_LEN 256
 
 /** A segment of bytes with a specific meaning. */
 typedef struct {
-    const char* name;
+    int name; // Use `hedit_format_iter_name` to get the full name
     size_t from;
     size_t to;
     int color;
@@ -20,14 +21,16 @@ typedef struct {
 
 #include <v8.h>
 
-// Forward declaration
+// Forward declarations
+struct HEdit;
 class JsFormatIterator;
 
 /** Holds a reference to a JS array describing the segments making up a format. */
 class JsFormat {
 public:
-    JsFormat(v8::Isolate* isolate, v8::Local<v8::Context> ctx, v8::Local<v8::Object> obj)
-        : _isolate(isolate),
+    JsFormat(HEdit* hedit, v8::Isolate* isolate, v8::Local<v8::Context> ctx, v8::Local<v8::Object> obj)
+        : _hedit(hedit),
+          _isolate(isolate),
           _ctx(isolate, ctx),
           _obj(isolate, obj) {}
 
@@ -38,16 +41,25 @@ public:
 
     JsFormatIterator* Iterator();
 
+    v8::Local<v8::Object> GetObject() {
+        return _obj.Get(_isolate);
+    }
+
 private:
+    HEdit* _hedit;
     v8::Isolate* _isolate;
     v8::Persistent<v8::Context> _ctx;
     v8::Persistent<v8::Object> _obj;
 };
 
-/** Simple iterator over the JS object held inside a JsFormat. */
+/**
+ * Iterator over the segments of a JsFormat.
+ * The segments are read from the native index filled by the JS side,
+ * which is called only when the segments needed are not in the index yet.
+ */
 class JsFormatIterator {
 public:
-    JsFormatIterator(v8::Isolate* isolate, v8::Local<v8::Object> jsIterator);
+    JsFormatIterator(HEdit* hedit, v8::Isolate* isolate, v8::Local<v8::Object> jsIterator);
 
     ~JsFormatIterator() {
         _jsIterator.Reset();
@@ -58,19 +70,23 @@ public:
     FormatSegment* Seek(size_t pos);
     FormatSegment* Next();
     FormatSegment* Current();
+    const char* Name();
 
 private:
+    HEdit* _hedit;
     v8::Isolate* _isolate;
     v8::Persistent<v8::Object> _jsIterator;
     v8::Persistent<v8::Function> _nextFunction;
     v8::Persistent<v8::Function> _seekFunction;
+    SegmentIndex* _index;
+    size_t _pos = 0;
     FormatSegment _current;
     char _currentName[MAX_SEGMENT_NAME_LEN];
     bool _initialized = false;
     bool _done = false;
 
-    bool AdvanceIterator();
-    void UnpackJsSegment(v8::Local<v8::Object> seg);
+    bool CallJs(const v8::Persistent<v8::Function>& fn, int argc, v8::Local<v8::Value> argv[]);
+    FormatSegment* Load(size_t i);
 };
 
 #endif
@@ -128,6 +144,12 @@ FormatSegment* hedit_format_iter_seek(FormatIterator* it, size_t pos);
 /** Returns the current segment without advancing the iterator. */
 FormatSegment* hedit_format_iter_current(FormatIterator* it);
 
+/**
+ * Returns the full name of the current segment.
+ * The name is built on request and stays valid until the next call.
+ */
+const char* hedit_format_iter_name(FormatIterator* it);
+
 /**
  * Advances the iterator to the next available segment.
  * If no more segments are available, `NULL` is returned.
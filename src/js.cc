@@ -1,8 +1,15 @@
+#include <list>
 #include <map>
+#include <regex>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include <stdint.h>
 #include <wordexp.h>
 #include <assert.h>
 #include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
@@ -15,6 +22,9 @@
 #include "commands.h"
 #include "util/log.h"
 #include "util/pubsub.h"
+#include "util/nametree.h"
+#include "util/metrics.h"
+#include "util/trace.h"
 
 using namespace v8;
 
@@ -37,6 +47,72 @@ static Global<Function> js_event_broker;
 // All the file format implementation is pushed to the JS side.
 static Global<Function> format_guess_function;
 
+// Buffers handed out by `__hedit.file_chunks`, each holding a copy of a piece of a file.
+// They are copies because the memory of the pieces must never be written from JS, and V8 has no read-only buffers.
+// They get detached as soon as the piece they were copied from may change or go away.
+struct ChunkView {
+    Global<ArrayBuffer> buf;
+    void* data;
+    File* file;
+    bool stable;
+    std::list<ChunkView>::iterator self;
+};
+static std::list<ChunkView> chunk_views;
+
+// Segment indexes handed out by `__hedit.segindex_new`, freed when the JS object wrapping them is collected.
+struct SegmentIndexHandle {
+    Global<Object> obj;
+    SegmentIndex* index;
+    std::list<SegmentIndexHandle>::iterator self;
+};
+static std::list<SegmentIndexHandle> segment_indexes;
+static Global<ObjectTemplate> segindex_template;
+
+// Mirror of the tree of segment names of `hedit/private/names`.
+static NameTree* segment_names;
+
+// Callbacks scheduled with `__hedit.later`, waiting for their timer to fire.
+struct LaterCallback {
+    HEdit* hedit;
+    Global<Function> fn;
+    int timer;
+    std::list<LaterCallback>::iterator self;
+};
+static std::list<LaterCallback> later_callbacks;
+
+// Watchdog terminating the calls from the native side into JS that run for longer than the `scripttimeout`
+// option (in milliseconds, 0 to disable). Only the outermost call is timed: nested calls share its budget.
+#define DEFAULT_SCRIPT_TIMEOUT 2000
+static std::thread watchdog_thread;
+static std::mutex watchdog_mutex;
+static std::condition_variable watchdog_cond;
+static std::chrono::steady_clock::time_point watchdog_deadline;
+static bool watchdog_armed;
+static bool watchdog_fired;
+static bool watchdog_quit;
+static int watchdog_timeout = DEFAULT_SCRIPT_TIMEOUT;
+static int watchdog_depth;
+
+// Documents whose format has been terminated by the watchdog, until their `format` option falls back to `none`.
+// The format of a listed document is not called anymore. The fallback applies only while the document is active:
+// `timer` is -1 while it waits in background.
+struct FormatFallback {
+    HEdit* hedit;
+    Document* doc;
+    int timer;
+    std::list<FormatFallback>::iterator self;
+};
+static std::list<FormatFallback> format_fallbacks;
+
+// Performance metrics of the calls into JS, see `util/metrics.h`
+static struct {
+    Metric* event_calls;
+    Metric* event_time;
+    Metric* format_calls;
+    Metric* format_time;
+    Metric* format_seek_time;
+} metrics;
+
 
 
 // Forward declarations
@@ -44,6 +120,7 @@ static inline Local<String> v8_str(const char* str);
 static inline Local<String> v8_str(const char* str, size_t len);
 static MaybeLocal<Module> EvalModule(const char* origin_str, const Persistent<Context>& ctx, const char* contents, size_t len);
 static MaybeLocal<Module> EvalModule(Local<String> origin_str, const Persistent<Context>& ctx, const char* contents, size_t len);
+static std::string ReexportSource(const std::string& name, Local<Object> ns);
 
 
 
@@ -75,21 +152,45 @@ size_t JsBuiltinModule::GetSourceLen() {
     return _source_len;
 }
 
+const std::map<std::string, std::shared_ptr<JsBuiltinModule>>& JsBuiltinModule::All() {
+    return _all_modules;
+}
+
 Persistent<Module>& JsBuiltinModule::GetHandle() {
     return _module;
 }
 
+Local<Object> JsBuiltinModule::GetNamespace(Isolate* isolate) {
+    if (!_namespace.IsEmpty()) {
+        return _namespace.Get(isolate);
+    } else {
+        return Local<Object>::Cast(_module.Get(isolate)->GetModuleNamespace());
+    }
+}
+
+void JsBuiltinModule::Restore(Isolate* isolate, Local<Object> ns) {
+    _namespace.Reset(isolate, ns);
+}
+
 bool JsBuiltinModule::Eval(Isolate* isolate) {
     HandleScope handle_scope(isolate);
 
     if (!this->GetHandle().IsEmpty()) {
         return true;
     } else {
+        // Modules restored from the snapshot have already been evaluated,
+        // but user modules still need a real module to import from:
+        // compile a tiny one re-exporting all the bindings of the restored namespace.
+        std::string source;
+        if (!_namespace.IsEmpty()) {
+            source = ReexportSource(this->GetName(), _namespace.Get(isolate));
+        }
+
         MaybeLocal<Module> m = EvalModule(
             String::Concat(v8_str("builtin:"), v8_str(this->GetName().c_str())),
             builtin_context,
-            this->GetSource(),
-            this->GetSourceLen()
+            source.empty() ? this->GetSource() : source.c_str(),
+            source.empty() ? this->GetSourceLen() : source.size()
         );
         if (!m.IsEmpty()) {
             this->GetHandle().Reset(isolate, m.ToLocalChecked());
@@ -117,6 +218,223 @@ static inline const char* c_str(String::Utf8Value& str) {
     return *str != NULL ? *str : "<string conversion failed>";
 }
 
+// Describes why a JS call failed: either the exception it threw, or its termination by the watchdog.
+static std::string ErrorString(TryCatch& tt) {
+    if (tt.HasTerminated()) {
+        return "execution took longer than " + std::to_string(watchdog_timeout) + "ms";
+    }
+    String::Utf8Value str(isolate, tt.Exception());
+    return c_str(str);
+}
+
+static void WatchdogLoop() {
+    std::unique_lock<std::mutex> lock(watchdog_mutex);
+    while (!watchdog_quit) {
+        if (!watchdog_armed) {
+            watchdog_cond.wait(lock);
+        } else if (std::chrono::steady_clock::now() < watchdog_deadline) {
+            watchdog_cond.wait_until(lock, watchdog_deadline);
+        } else {
+            watchdog_armed = false;
+            watchdog_fired = true;
+            isolate->TerminateExecution();
+        }
+    }
+}
+
+// Arms the watchdog for the lifetime of the object. Create one around every call into JS from the native side.
+class WatchdogScope {
+public:
+    WatchdogScope() {
+        if (watchdog_depth++ > 0 || watchdog_timeout <= 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(watchdog_mutex);
+        watchdog_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(watchdog_timeout);
+        watchdog_armed = true;
+        watchdog_cond.notify_one();
+    }
+
+    ~WatchdogScope() {
+        if (--watchdog_depth > 0) {
+            return;
+        }
+
+        // The termination propagates up to the outermost call: only there V8 can run JS again.
+        // The watchdog might also have fired just after the call returned.
+        std::lock_guard<std::mutex> lock(watchdog_mutex);
+        watchdog_armed = false;
+        if (watchdog_fired) {
+            watchdog_fired = false;
+            isolate->CancelTerminateExecution();
+        }
+    }
+};
+
+// Records a trace span for the lifetime of the object. `name` must be a string literal.
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* detail = NULL) : _name(name) {
+        TRACE_BEGIN_ARG(name, detail);
+    }
+
+    ~TraceScope() {
+        TRACE_END(_name);
+    }
+
+private:
+    const char* _name;
+};
+
+static bool OnScriptTimeoutChange(HEdit* hedit, Option* opt, const ::Value* v, void* user) {
+    if (v->i < 0) {
+        return false;
+    }
+    watchdog_timeout = v->i;
+    return true;
+}
+
+static FormatFallback* FindFormatFallback(Document* doc) {
+    for (FormatFallback& fb : format_fallbacks) {
+        if (fb.doc == doc) {
+            return &fb;
+        }
+    }
+    return NULL;
+}
+
+static int OnFormatFallbackTimer(Tickit* t, TickitEventFlags flags, void* user) {
+    FormatFallback* fb = (FormatFallback*) user;
+    HEdit* hedit = fb->hedit;
+
+    // The document went in background before the fallback: wait for it to be active again
+    fb->timer = -1;
+    if (fb->doc != hedit_buffer_current(hedit)) {
+        return 1;
+    }
+
+    format_fallbacks.erase(fb->self);
+    hedit_option_set(hedit, "format", "none");
+
+    return 1;
+}
+
+static void ScheduleFormatFallback(FormatFallback* fb) {
+    fb->timer = tickit_timer_after_msec(fb->hedit->tickit, 0, 0, OnFormatFallbackTimer, fb);
+}
+
+// Called when the format of the active document has been terminated by the watchdog: stops asking it for segments,
+// and switches that document to the `none` format as soon as the current redraw is over.
+static void FormatTerminated(HEdit* hedit) {
+    Document* doc = hedit_buffer_current(hedit);
+    if (doc == NULL || FindFormatFallback(doc) != NULL) {
+        return;
+    }
+
+    log_error("The format took longer than %dms and has been terminated: falling back to none.", watchdog_timeout);
+    format_fallbacks.emplace_front();
+    FormatFallback& fb = format_fallbacks.front();
+    fb.hedit = hedit;
+    fb.doc = doc;
+    fb.self = format_fallbacks.begin();
+    ScheduleFormatFallback(&fb);
+}
+
+// Drops the pending fallback of the active document, when it is closed or gets a new format.
+static void DropFormatFallback(HEdit* hedit) {
+    FormatFallback* fb = FindFormatFallback(hedit_buffer_current(hedit));
+    if (fb == NULL) {
+        return;
+    }
+    if (fb->timer != -1) {
+        tickit_timer_cancel(hedit->tickit, fb->timer);
+    }
+    format_fallbacks.erase(fb->self);
+}
+
+// Resumes the pending fallback of a document that has just become active.
+static void ResumeFormatFallback(HEdit* hedit) {
+    FormatFallback* fb = FindFormatFallback(hedit_buffer_current(hedit));
+    if (fb != NULL && fb->timer == -1) {
+        ScheduleFormatFallback(fb);
+    }
+}
+
+static void ChunkViewWeakCallback(const WeakCallbackInfo<ChunkView>& data) {
+    ChunkView* view = data.GetParameter();
+    free(view->data);
+    chunk_views.erase(view->self);
+}
+
+static void SegmentIndexWeakCallback(const WeakCallbackInfo<SegmentIndexHandle>& data) {
+    SegmentIndexHandle* handle = data.GetParameter();
+    segindex_free(handle->index);
+    segment_indexes.erase(handle->self);
+}
+
+static inline SegmentIndex* UnwrapSegmentIndex(Local<v8::Value> obj) {
+    assert(obj->IsObject());
+    return (SegmentIndex*) Local<Object>::Cast(obj)->GetAlignedPointerFromInternalField(0);
+}
+
+// Detaches all the chunk views of a file, or only the ones that can be modified in place if `all` is false.
+static void DetachChunkViews(File* file, bool all) {
+    HandleScope handle_scope(isolate);
+
+    auto it = chunk_views.begin();
+    while (it != chunk_views.end()) {
+        if (it->file == file && (all || !it->stable)) {
+            it->buf.Get(isolate)->Neuter();
+            free(it->data);
+            it = chunk_views.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+// Invalidates the format cache of the document of a changed file, from the first changed byte onwards.
+// The document is not necessarily the active one: the server can edit any of them.
+static void InvalidateFormat(HEdit* hedit, File* file, size_t offset) {
+    Format* format = NULL;
+    if (file == hedit->file) {
+        format = hedit->format;
+    } else {
+        for (size_t i = 0; i < hedit->buffers_len; i++) {
+            if (hedit->buffers[i]->file == file) {
+                format = hedit->buffers[i]->format;
+                break;
+            }
+        }
+    }
+    if (format == NULL) {
+        return;
+    }
+
+    Local<Context> ctx = isolate->GetCurrentContext();
+    Local<Object> obj = format->GetObject();
+    Local<v8::Value> fn;
+    if (!obj->Get(ctx, v8_str("invalidateFrom")).ToLocal(&fn) || !fn->IsFunction()) {
+        return;
+    }
+
+    TraceScope trace("js.format_invalidate");
+    WatchdogScope watchdog;
+    TryCatch tt;
+    Local<v8::Value> argv[1] = { Number::New(isolate, (double) offset) };
+    Local<v8::Value> res;
+    if (!Local<Function>::Cast(fn)->Call(ctx, obj, 1, argv).ToLocal(&res)) {
+        log_error("Exception while invalidating the format cache: %s", ErrorString(tt).c_str());
+        return;
+    }
+
+    // Only the active document is on screen
+    if (res->BooleanValue(ctx).FromJust() && format == hedit->format) {
+        log_debug("Format cache invalidated from offset %zu.", offset);
+        hedit_redraw_view(hedit);
+    }
+}
+
 static void NativePubSubHandler(PubSub* pubsub, const char* topic, void* data, void* user) {
     HEditEvent* ev = static_cast<HEditEvent*>(data);
 
@@ -147,12 +465,39 @@ static void NativePubSubHandler(PubSub* pubsub, const char* topic, void* data, v
             break;
         }
         
+        case HEDIT_EVENT_TYPE_FILE_CLOSE: {
+            HEditFileEvent* ev2 = reinterpret_cast<HEditFileEvent*>(ev);
+            DetachChunkViews(ev2->file, true);
+            DropFormatFallback(ev->hedit);
+            argc = 1;
+            argv[0] = v8_str(topic);
+            break;
+        }
+
+        case HEDIT_EVENT_TYPE_BUFFER_SWITCH: {
+            ResumeFormatFallback(ev->hedit);
+            argc = 1;
+            argv[0] = v8_str(topic);
+            break;
+        }
+
         case HEDIT_EVENT_TYPE_FILE_CHANGE: {
             HEditFileChangeEvent* ev2 = reinterpret_cast<HEditFileChangeEvent*>(ev);
+            DetachChunkViews(ev2->file, false);
+            InvalidateFormat(ev->hedit, ev2->file, ev2->offset);
             argc = 3;
             argv[0] = v8_str(topic);
-            argv[1] = Integer::NewFromUnsigned(isolate, (uint32_t) ev2->offset);
-            argv[2] = Integer::NewFromUnsigned(isolate, (uint32_t) ev2->len);
+            // Offsets are passed as doubles, which are exact up to 2^53, so they do not wrap on files over 4GiB
+            argv[1] = Number::New(isolate, (double) ev2->offset);
+            argv[2] = Number::New(isolate, (double) ev2->len);
+            break;
+        }
+
+        case HEDIT_EVENT_TYPE_OPTION_CHANGE: {
+            HEditOptionEvent* ev2 = reinterpret_cast<HEditOptionEvent*>(ev);
+            argc = 2;
+            argv[0] = v8_str(topic);
+            argv[1] = v8_str(ev2->option->name);
             break;
         }
         
@@ -164,12 +509,15 @@ static void NativePubSubHandler(PubSub* pubsub, const char* topic, void* data, v
     }
 
     // Invoke the JS broker
+    TraceScope trace("js.event", topic);
+    WatchdogScope watchdog;
     TryCatch tt;
+    uint64_t start = metrics_now();
     if (js_event_broker.Get(isolate)->Call(user_context.Get(isolate), Null(isolate), argc, argv).IsEmpty()) {
-        Local<v8::Value> ex = tt.Exception();
-        String::Utf8Value str(isolate, ex);
-        log_error("Error during JS event dispatch: %s", c_str(str));
+        log_error("Error during JS event dispatch: %s", ErrorString(tt).c_str());
     }
+    metrics_add(metrics.event_calls, 1);
+    metrics_observe(metrics.event_time, metrics_now() - start);
     
 }
 
@@ -201,7 +549,7 @@ static void Require(const FunctionCallbackInfo<v8::Value>& args) {
         return;
     }
 
-    args.GetReturnValue().Set(builtin->GetHandle().Get(isolate)->GetModuleNamespace());
+    args.GetReturnValue().Set(builtin->GetNamespace(isolate));
 
 }
 
@@ -237,6 +585,56 @@ static void Redraw(const FunctionCallbackInfo<v8::Value>& args) {
     hedit_redraw_view(hedit);
 }
 
+static int OnLaterTimer(Tickit* t, TickitEventFlags flags, void* user) {
+    LaterCallback* cb = (LaterCallback*) user;
+    HEdit* hedit = cb->hedit;
+
+    // Enter JS
+    Isolate::Scope isolate_scope(isolate);
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = user_context.Get(isolate);
+    Context::Scope context_scope(ctx);
+
+    // The callback is removed before being called, so that it can schedule itself again
+    Local<Function> fn = cb->fn.Get(isolate);
+    later_callbacks.erase(cb->self);
+
+    TraceScope trace("js.later");
+    WatchdogScope watchdog;
+    TryCatch tt(isolate);
+    if (fn->Call(ctx, Null(isolate), 0, {}).IsEmpty()) {
+
+        // Deferred callbacks continue the linearization of the active format in the background
+        if (tt.HasTerminated()) {
+            FormatTerminated(hedit);
+        } else {
+            log_error("Exception in deferred JS callback: %s", ErrorString(tt).c_str());
+        }
+    }
+
+    return 1;
+}
+
+// __hedit.later(msec, function () {});
+static void Later(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+    HEdit* hedit = (HEdit*) Local<External>::Cast(args.Data())->Value();
+
+    assert(args.Length() == 2);
+    assert(args[1]->IsFunction());
+
+    int msec = args[0]->Int32Value(ctx).FromJust();
+
+    later_callbacks.emplace_front();
+    LaterCallback& cb = later_callbacks.front();
+    cb.hedit = hedit;
+    cb.fn.Reset(isolate, Local<Function>::Cast(args[1]));
+    cb.self = later_callbacks.begin();
+    cb.timer = tickit_timer_after_msec(hedit->tickit, msec, 0, OnLaterTimer, &cb);
+}
+
 // __hedit.log("file", line, severity, "contents");
 static void Log(const FunctionCallbackInfo<v8::Value>& args) {
     Isolate* isolate = args.GetIsolate();
@@ -396,11 +794,11 @@ static bool JsCommandHandler(HEdit* hedit, bool force, ArgIterator* arg, void* u
     }
 
     // Invoke the js callback
+    TraceScope trace("js.command");
+    WatchdogScope watchdog;
     TryCatch tt;
     if (handler->Get(isolate)->Call(user_context.Get(isolate), Null(isolate), jsargs.size(), jsargs.data()).IsEmpty()) {
-        Local<v8::Value> ex = tt.Exception();
-        String::Utf8Value str(isolate, ex);
-        log_error("Exception during JS command callback: %s", c_str(str));
+        log_error("Exception during JS command callback: %s", ErrorString(tt).c_str());
         return false;
     }
 
@@ -497,7 +895,7 @@ static void GetOption(const FunctionCallbackInfo<v8::Value>& args) {
     String::Utf8Value name(isolate, args[0]);
 
     // Retrive the option
-    Option* opt = (Option*) map_get(hedit->options, *name);
+    Option* opt = hedit_option_get(hedit, *name);
     if (opt == NULL) {
         isolate->ThrowException(
             String::Concat(v8_str("Unknown option: "), args[0]->ToString(ctx).ToLocalChecked())
@@ -534,14 +932,14 @@ static bool JsOptionHandler(HEdit* hedit, Option* opt, const ::Value* v, void* u
     Context::Scope context_scope(ctx);
 
     // Delegate to the JS handler
+    TraceScope trace("js.option", opt->name);
+    WatchdogScope watchdog;
     TryCatch tt;
     Local<v8::Value> ret;
     Local<v8::Value> args[] = { v8_str(v->str) };
     MaybeLocal<v8::Value> maybeRet = handler->Get(isolate)->Call(ctx, Null(isolate), 1, args);
     if (!maybeRet.ToLocal(&ret)) {
-        Local<v8::Value> ex = tt.Exception();
-        String::Utf8Value str(isolate, ex);
-        log_error("Exception during JS option callback: %s", c_str(str));
+        log_error("Exception during JS option callback: %s", ErrorString(tt).c_str());
         return false;
     }
 
@@ -579,7 +977,7 @@ static void RegisterOption(const FunctionCallbackInfo<v8::Value>& args) {
     Persistent<Function>* handler = new Persistent<Function>(isolate, Local<Function>::Cast(args[2]));
 
     ::Value v = { 0, false, *defaultValue };
-    bool res = hedit_option_register(hedit, *name, HEDIT_OPTION_TYPE_STRING, v, JsOptionHandler, JsOptionFree, handler);
+    bool res = hedit_option_register(hedit, *name, HEDIT_OPTION_TYPE_STRING, v, JsOptionHandler, JsOptionFree, handler) != NULL;
     args.GetReturnValue().Set(res);
 
     if (!res) {
@@ -773,10 +1171,25 @@ static void FileSetFormat(const FunctionCallbackInfo<v8::Value>& args) {
         return;
     }
 
-    JsFormat* format = new JsFormat(isolate, ctx, obj);
+    JsFormat* format = new JsFormat(hedit, isolate, ctx, obj);
     hedit_set_format(hedit, format);
 }
 
+// __hedit.file_getFormat();
+static void FileGetFormat(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    HEdit* hedit = (HEdit*) Local<External>::Cast(args.Data())->Value();
+
+    assert(args.Length() == 0);
+
+    if (hedit->format == NULL) {
+        args.GetReturnValue().SetNull();
+    } else {
+        args.GetReturnValue().Set(hedit->format->GetObject());
+    }
+}
+
 // __hedit.file_read(offset, len);
 static void FileRead(const FunctionCallbackInfo<v8::Value>& args) {
     Isolate* isolate = args.GetIsolate();
@@ -791,8 +1204,11 @@ static void FileRead(const FunctionCallbackInfo<v8::Value>& args) {
     size_t len = args[1]->IntegerValue(ctx).FromJust();
 
     // Clamp the length so that it does not exceed the actual length of the file
-    if (offset + len > hedit_file_size(hedit->file)) {
-        len -= offset + len - hedit_file_size(hedit->file);
+    size_t size = hedit_file_size(hedit->file);
+    if (offset >= size) {
+        len = 0;
+    } else if (len > size - offset) {
+        len = size - offset;
     }
 
     // Allocate an ArrayBuffer to hold the results
@@ -813,6 +1229,211 @@ static void FileRead(const FunctionCallbackInfo<v8::Value>& args) {
     args.GetReturnValue().Set(buf);
 }
 
+// __hedit.file_chunks(offset, len)
+static void FileChunks(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+    HEdit* hedit = (HEdit*) Local<External>::Cast(args.Data())->Value();
+
+    assert(args.Length() == 2);
+    assert(hedit->file != NULL);
+
+    size_t offset = args[0]->IntegerValue(ctx).FromJust();
+    size_t len = args[1]->IntegerValue(ctx).FromJust();
+
+    // Copy each piece in its own buffer, so that the scan does not need a contiguous copy of the whole range
+    Local<Array> chunks = Array::New(isolate);
+    uint32_t i = 0;
+    FileIterator* it = hedit_file_iter(hedit->file, offset, len);
+    const unsigned char* chunk;
+    size_t chunk_len;
+    while (hedit_file_iter_next(it, &chunk, &chunk_len)) {
+        if (chunk_len == 0) {
+            continue;
+        }
+
+        // The buffer is externalized, since only those can be detached
+        void* data = malloc(chunk_len);
+        if (data == NULL) {
+            log_fatal("Out of memory.");
+            break;
+        }
+        memcpy(data, chunk, chunk_len);
+        Local<ArrayBuffer> buf = ArrayBuffer::New(isolate, data, chunk_len, ArrayBufferCreationMode::kExternalized);
+        chunk_views.emplace_back();
+        ChunkView& view = chunk_views.back();
+        view.self = std::prev(chunk_views.end());
+        view.data = data;
+        view.file = hedit->file;
+        view.stable = hedit_file_iter_stable(it);
+        view.buf.Reset(isolate, buf);
+        view.buf.SetWeak(&view, ChunkViewWeakCallback, WeakCallbackType::kParameter);
+
+        chunks->Set(ctx, i++, buf).FromJust();
+    }
+    hedit_file_iter_free(it);
+
+    args.GetReturnValue().Set(chunks);
+}
+
+// __hedit.segindex_new()
+static void SegindexNew(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    if (segindex_template.IsEmpty()) {
+        Local<ObjectTemplate> tpl = ObjectTemplate::New(isolate);
+        tpl->SetInternalFieldCount(1);
+        segindex_template.Reset(isolate, tpl);
+    }
+
+    SegmentIndex* index = segindex_new();
+    if (index == NULL) {
+        log_fatal("Out of memory.");
+        return;
+    }
+
+    Local<Object> obj = segindex_template.Get(isolate)->NewInstance(ctx).ToLocalChecked();
+    obj->SetAlignedPointerInInternalField(0, index);
+
+    segment_indexes.emplace_back();
+    SegmentIndexHandle& handle = segment_indexes.back();
+    handle.self = std::prev(segment_indexes.end());
+    handle.index = index;
+    handle.obj.Reset(isolate, obj);
+    handle.obj.SetWeak(&handle, SegmentIndexWeakCallback, WeakCallbackType::kParameter);
+
+    args.GetReturnValue().Set(obj);
+}
+
+// __hedit.names_add(parent, name)
+static void NamesAdd(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    assert(args.Length() == 2);
+
+    if (segment_names == NULL && (segment_names = nametree_new()) == NULL) {
+        log_fatal("Out of memory.");
+        return;
+    }
+
+    int parent = args[0]->Int32Value(ctx).FromJust();
+    String::Utf8Value name(isolate, args[1]);
+    if (nametree_add(segment_names, parent, c_str(name)) < 0) {
+        log_fatal("Out of memory.");
+    }
+}
+
+// __hedit.segindex_append(index, from, to, color, name)
+static void SegindexAppend(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    assert(args.Length() == 5);
+
+    size_t from = args[1]->IntegerValue(ctx).FromJust();
+    size_t to = args[2]->IntegerValue(ctx).FromJust();
+    int color = args[3]->Int32Value(ctx).FromJust();
+    int name = args[4]->Int32Value(ctx).FromJust();
+
+    if (!segindex_append(UnwrapSegmentIndex(args[0]), from, to, color, name)) {
+        log_fatal("Out of memory.");
+    }
+}
+
+// __hedit.segindex_truncate(index, len)
+static void SegindexTruncate(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    assert(args.Length() == 2);
+
+    segindex_truncate(UnwrapSegmentIndex(args[0]), args[1]->IntegerValue(ctx).FromJust());
+}
+
+// __hedit.segindex_drop(index, count)
+static void SegindexDrop(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    assert(args.Length() == 2);
+
+    segindex_drop(UnwrapSegmentIndex(args[0]), args[1]->IntegerValue(ctx).FromJust());
+}
+
+// __hedit.segindex_find(index, pos)
+static void SegindexFind(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    assert(args.Length() == 2);
+
+    size_t i = segindex_find(UnwrapSegmentIndex(args[0]), args[1]->IntegerValue(ctx).FromJust());
+    args.GetReturnValue().Set(Number::New(isolate, i));
+}
+
+// __hedit.segindex_get(index, i)
+static void SegindexGet(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    assert(args.Length() == 2);
+
+    size_t from, to;
+    int color, name;
+    if (!segindex_get(UnwrapSegmentIndex(args[0]), args[1]->IntegerValue(ctx).FromJust(), &from, &to, &color, &name)) {
+        return;
+    }
+
+    Local<Object> segment = Object::New(isolate);
+    segment->Set(ctx, v8_str("from"), Number::New(isolate, from)).FromJust();
+    segment->Set(ctx, v8_str("to"), Number::New(isolate, to)).FromJust();
+    segment->Set(ctx, v8_str("color"), Integer::New(isolate, color)).FromJust();
+    segment->Set(ctx, v8_str("name"), Integer::New(isolate, name)).FromJust();
+    args.GetReturnValue().Set(segment);
+}
+
+static bool AddMetric(Metric* m, void* user) {
+    Local<Object> stats = *(Local<Object>*) user;
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    Local<v8::Value> value;
+    if (m->type == METRIC_COUNTER) {
+        value = Number::New(isolate, (double) m->value);
+    } else {
+        Local<Object> histogram = Object::New(isolate);
+        histogram->Set(ctx, v8_str("count"), Number::New(isolate, (double) m->count)).FromJust();
+        histogram->Set(ctx, v8_str("sum"), Number::New(isolate, (double) m->sum)).FromJust();
+        histogram->Set(ctx, v8_str("max"), Number::New(isolate, (double) m->max)).FromJust();
+        histogram->Set(ctx, v8_str("p50"), Number::New(isolate, (double) metrics_quantile(m, 0.5))).FromJust();
+        histogram->Set(ctx, v8_str("p99"), Number::New(isolate, (double) metrics_quantile(m, 0.99))).FromJust();
+        value = histogram;
+    }
+    stats->Set(ctx, v8_str(m->name), value).FromJust();
+    return true;
+}
+
+// __hedit.stats()
+static void Stats(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    HandleScope handle_scope(isolate);
+
+    assert(args.Length() == 0);
+
+    Local<Object> stats = Object::New(isolate);
+    metrics_iterate(AddMetric, &stats);
+    args.GetReturnValue().Set(stats);
+}
+
 // __hedit.statusbar_showMessage(msg, sticky);
 static void StatusbarShowMessage(const FunctionCallbackInfo<v8::Value>& args) {
     Isolate* isolate = args.GetIsolate();
@@ -923,6 +1544,57 @@ static MaybeLocal<Module> EvalModule(Local<String> origin_str, const Persistent<
     return MaybeLocal<Module>(handle_scope.Escape(m));
 }
 
+// V8 6.4 cannot give back the module of a namespace restored from the snapshot, so there is nothing
+// for `export * from` to resolve to: the values of the bindings are re-exported instead.
+// They are the same as long as the builtins do not export variables, see `hedit_js_write_snapshot`.
+static std::string ReexportSource(const std::string& name, Local<Object> ns) {
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = builtin_context.Get(isolate);
+
+    // The restored namespaces are reachable from the `__hedit` object of the builtin context
+    std::string source = "const m = __hedit.__modules['" + name + "'];";
+    Local<Array> names = ns->GetOwnPropertyNames(ctx).ToLocalChecked();
+    for (uint32_t i = 0; i < names->Length(); i++) {
+        String::Utf8Value export_name(isolate, names->Get(ctx, i).ToLocalChecked());
+        if (strcmp(c_str(export_name), "default") == 0) {
+            source += "export default m.default;";
+        } else {
+            source += std::string("export const { ") + c_str(export_name) + " } = m;";
+        }
+    }
+
+    return source;
+}
+
+static void RestoreSnapshot(Local<Context> ctx, Local<ObjectTemplate> hedit_template) {
+    HandleScope handle_scope(isolate);
+    Context::Scope context_scope(ctx);
+    Local<Object> global = ctx->Global();
+
+    // Replace the stub `__hedit` object used while building the snapshot with the real one
+    Local<Object> stub = Local<Object>::Cast(global->Get(ctx, v8_str("__hedit")).ToLocalChecked());
+    Local<Object> modules = Local<Object>::Cast(stub->Get(ctx, v8_str("__modules")).ToLocalChecked());
+    Local<Object> obj = hedit_template->NewInstance(ctx).ToLocalChecked();
+    obj->Set(ctx, v8_str("__modules"), modules).FromJust();
+    global->Set(ctx, v8_str("__hedit"), obj).FromJust();
+
+    // Tell the loader which modules have already been evaluated
+    Local<Array> names = modules->GetOwnPropertyNames(ctx).ToLocalChecked();
+    for (uint32_t i = 0; i < names->Length(); i++) {
+        Local<v8::Value> name = names->Get(ctx, i).ToLocalChecked();
+        String::Utf8Value name_str(isolate, name);
+        std::shared_ptr<JsBuiltinModule> builtin = JsBuiltinModule::FromName(std::string(c_str(name_str)));
+        if (builtin != nullptr) {
+            builtin->Restore(isolate, Local<Object>::Cast(modules->Get(ctx, name).ToLocalChecked()));
+        }
+    }
+
+    // The `hedit` module registered its event broker with the stub
+    Local<v8::Value> broker = stub->Get(ctx, v8_str("__eventBroker")).ToLocalChecked();
+    if (broker->IsFunction()) {
+        js_event_broker.Reset(isolate, Local<Function>::Cast(broker));
+    }
+}
 
 static void LoadUserConfig() {
     
@@ -998,8 +1670,12 @@ bool hedit_js_init(HEdit* hedit) {
     V8::InitializePlatform(::platform.get());
     V8::Initialize();
 
-    // Create a new Isolate
+    // Create a new Isolate, starting from the snapshot with the builtin modules if we have one
+    bool from_snapshot = hedit_js_snapshot.raw_size > 0;
     create_params.array_buffer_allocator = ArrayBuffer::Allocator::NewDefaultAllocator();
+    if (from_snapshot) {
+        create_params.snapshot_blob = &hedit_js_snapshot;
+    }
     isolate = Isolate::New(create_params);
 
     {
@@ -1017,6 +1693,7 @@ bool hedit_js_init(HEdit* hedit) {
         SET("registerEventBroker", RegisterEventBroker);
         SET("registerFormatGuessFunction", RegisterFormatGuessFunction);
         SET("redraw", Redraw);
+        SET("later", Later);
         SET("log", Log);
         SET("setTheme", SetTheme);
         SET("mode", GetMode);
@@ -1039,7 +1716,17 @@ bool hedit_js_init(HEdit* hedit) {
         SET("file_insert", FileInsert);
         SET("file_delete", FileDelete);
         SET("file_setFormat", FileSetFormat);
+        SET("file_getFormat", FileGetFormat);
         SET("file_read", FileRead);
+        SET("file_chunks", FileChunks);
+        SET("segindex_new", SegindexNew);
+        SET("names_add", NamesAdd);
+        SET("segindex_append", SegindexAppend);
+        SET("segindex_truncate", SegindexTruncate);
+        SET("segindex_drop", SegindexDrop);
+        SET("segindex_find", SegindexFind);
+        SET("segindex_get", SegindexGet);
+        SET("stats", Stats);
         SET("statusbar_showMessage", StatusbarShowMessage);
         SET("statusbar_hideMessage", StatusbarHideMessage);
         Local<ObjectTemplate> builtin_global = ObjectTemplate::New(isolate);
@@ -1047,7 +1734,13 @@ bool hedit_js_init(HEdit* hedit) {
 
         // Create the contexts
         Local<Context> user_ctx = Context::New(isolate);
-        Local<Context> builtin_ctx = Context::New(isolate, NULL, builtin_global);
+        Local<Context> builtin_ctx;
+        if (from_snapshot) {
+            builtin_ctx = Context::FromSnapshot(isolate, 0).ToLocalChecked();
+            RestoreSnapshot(builtin_ctx, obj);
+        } else {
+            builtin_ctx = Context::New(isolate, NULL, builtin_global);
+        }
 
         // Set the same access token to allow access between the two contexts
         Local<Symbol> token = Symbol::New(isolate, v8_str("security-token"));
@@ -1065,6 +1758,21 @@ bool hedit_js_init(HEdit* hedit) {
             return false;
         }
 
+        // Look up the metrics once
+        metrics.event_calls = metrics_counter("js.events.calls");
+        metrics.event_time = metrics_histogram("js.events.time");
+        metrics.format_calls = metrics_counter("js.format.calls");
+        metrics.format_time = metrics_histogram("js.format.time");
+        metrics.format_seek_time = metrics_histogram("format.seek_time");
+
+        // Start the watchdog before running any JS
+        ::Value timeout = { DEFAULT_SCRIPT_TIMEOUT, false, NULL };
+        if (!hedit_option_register(hedit, "scripttimeout", HEDIT_OPTION_TYPE_INT, timeout, OnScriptTimeoutChange, NULL, NULL)) {
+            log_fatal("Cannot register the scripttimeout option.");
+            return false;
+        }
+        watchdog_thread = std::thread(WatchdogLoop);
+
         // Execute the builtin initializer
         if (!JsBuiltinModule::FromName("hedit/private/__init")->Eval(isolate)) {
             abort();
@@ -1077,6 +1785,114 @@ bool hedit_js_init(HEdit* hedit) {
     return true;
 }
 
+// Stand-in for the `__hedit` object while building the snapshot.
+// The native functions cannot end up in the snapshot (they hold a pointer to the HEdit instance),
+// so the builtin modules must not call them while being evaluated, with the only exception
+// of the event broker registration, which is replayed by `RestoreSnapshot`.
+static const char snapshot_prelude[] =
+    "var __hedit = {"
+    "    __modules: {},"
+    "    registerEventBroker(f) { this.__eventBroker = f; }"
+    "};";
+
+bool hedit_js_write_snapshot(const char* path) {
+
+    // Initialize V8
+    V8::InitializeICU();
+    ::platform = platform::NewDefaultPlatform();
+    V8::InitializePlatform(::platform.get());
+    V8::Initialize();
+
+    StartupData blob = { nullptr, 0 };
+    {
+        SnapshotCreator creator;
+        isolate = creator.GetIsolate();
+        {
+            HandleScope handle_scope(isolate);
+
+            // The user context is the default one, the builtin context is the first additional one
+            creator.SetDefaultContext(Context::New(isolate));
+            Local<Context> ctx = Context::New(isolate);
+            builtin_context.Reset(isolate, ctx);
+            Context::Scope context_scope(ctx);
+
+            TryCatch tt(isolate);
+            Local<Script> prelude;
+            if (!Script::Compile(ctx, v8_str(snapshot_prelude)).ToLocal(&prelude) || prelude->Run(ctx).IsEmpty()) {
+                String::Utf8Value str(isolate, tt.Exception());
+                log_fatal("Cannot evaluate snapshot prelude: %s", c_str(str));
+                return false;
+            }
+            Local<Object> hedit = Local<Object>::Cast(ctx->Global()->Get(ctx, v8_str("__hedit")).ToLocalChecked());
+            Local<Object> modules = Local<Object>::Cast(hedit->Get(ctx, v8_str("__modules")).ToLocalChecked());
+
+            // Evaluate all the builtin modules, but the initializer, which needs the real `__hedit`.
+            // Their exports are re-exported by value once restored, so they must not change afterwards.
+            std::regex exported_variable("(^|[\\s;])export\\s+(let|var)\\s");
+            for (auto& it : JsBuiltinModule::All()) {
+                if (it.first == "hedit/private/__init") {
+                    continue;
+                }
+                if (std::regex_search(std::string(it.second->GetSource(), it.second->GetSourceLen()), exported_variable)) {
+                    log_fatal("Builtin module %s exports a variable, which cannot be restored from the snapshot.", it.first.c_str());
+                    return false;
+                }
+                if (!it.second->Eval(isolate)) {
+                    log_fatal("Cannot evaluate builtin module %s.", it.first.c_str());
+                    return false;
+                }
+                modules->Set(ctx, v8_str(it.first.c_str()), it.second->GetNamespace(isolate)).FromJust();
+            }
+
+            // No global handles can survive in a snapshot
+            for (auto& it : JsBuiltinModule::All()) {
+                it.second->GetHandle().Reset();
+            }
+            builtin_context.Reset();
+
+            creator.AddContext(ctx);
+        }
+
+        // Keep the compiled code of the functions run during the evaluation
+        blob = creator.CreateBlob(SnapshotCreator::FunctionCodeHandling::kKeep);
+        isolate = nullptr;
+    }
+
+    V8::Dispose();
+    V8::ShutdownPlatform();
+
+    if (blob.data == nullptr) {
+        log_fatal("Cannot create snapshot.");
+        return false;
+    }
+
+    // Dump the blob as a C++ source file
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        log_fatal("Cannot open %s: %s.", path, strerror(errno));
+        delete[] blob.data;
+        return false;
+    }
+    fprintf(f, "// Generated by hedit_mksnapshot. Do not edit.\n\n");
+    fprintf(f, "#include <js.h>\n\n");
+    fprintf(f, "static const unsigned char data[] = {");
+    for (int i = 0; i < blob.raw_size; i++) {
+        fprintf(f, "%s0x%02x,", i % 16 == 0 ? "\n    " : " ", (unsigned char) blob.data[i]);
+    }
+    fprintf(f, "\n};\n\n");
+    fprintf(f, "v8::StartupData hedit_js_snapshot = { (const char*) data, %d };\n", blob.raw_size);
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    if (ok) {
+        log_info("Snapshot written to %s (%d bytes).", path, blob.raw_size);
+    } else {
+        log_fatal("Cannot write %s.", path);
+    }
+
+    delete[] blob.data;
+    return ok;
+}
+
 void hedit_js_teardown(HEdit* hedit) {
     log_debug("V8 teardown.");
 
@@ -1084,6 +1900,42 @@ void hedit_js_teardown(HEdit* hedit) {
     pubsub_unregister(native_pubsub_subscription);
     js_event_broker.Reset();
     format_guess_function.Reset();
+    for (ChunkView& view : chunk_views) {
+        free(view.data);
+    }
+    chunk_views.clear();
+
+    // Cancel the pending deferred callbacks
+    for (LaterCallback& cb : later_callbacks) {
+        tickit_timer_cancel(hedit->tickit, cb.timer);
+    }
+    later_callbacks.clear();
+    for (FormatFallback& fb : format_fallbacks) {
+        if (fb.timer != -1) {
+            tickit_timer_cancel(hedit->tickit, fb.timer);
+        }
+    }
+    format_fallbacks.clear();
+
+    // Stop the watchdog
+    if (watchdog_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(watchdog_mutex);
+            watchdog_quit = true;
+            watchdog_cond.notify_one();
+        }
+        watchdog_thread.join();
+    }
+
+    // Free the segment indexes still referenced from JS
+    for (SegmentIndexHandle& handle : segment_indexes) {
+        segindex_free(handle.index);
+        handle.obj.Reset();
+    }
+    segment_indexes.clear();
+    segindex_template.Reset();
+    nametree_free(segment_names);
+    segment_names = NULL;
 
     // Dispose the contexts
     builtin_context.Reset();
@@ -1097,6 +1949,9 @@ void hedit_js_teardown(HEdit* hedit) {
 }
 
 void hedit_set_format(HEdit* hedit, Format* format) {
+
+    // A new format starts afresh, even if the previous one has been terminated
+    DropFormatFallback(hedit);
     if (hedit->format != NULL) {
         delete hedit->format;
     }
@@ -1113,12 +1968,19 @@ void hedit_format_guess(HEdit* hedit) {
     HandleScope handle_scope(isolate);
     Context::Scope context_scope(user_context.Get(isolate));
 
-    TryCatch tt;
+    // The watchdog must be disarmed before falling back to `none`, which calls JS again
     Local<v8::Value> ret;
-    if (!format_guess_function.Get(isolate)->Call(user_context.Get(isolate), Null(isolate), 0, {}).ToLocal(&ret)) {
-        Local<v8::Value> ex = tt.Exception();
-        String::Utf8Value str(isolate, ex);
-        log_error("Exception during JS format guessing: %s", c_str(str));
+    bool guessed;
+    {
+        TraceScope trace("js.format_guess");
+        WatchdogScope watchdog;
+        TryCatch tt;
+        guessed = format_guess_function.Get(isolate)->Call(user_context.Get(isolate), Null(isolate), 0, {}).ToLocal(&ret);
+        if (!guessed) {
+            log_error("Exception during JS format guessing: %s", ErrorString(tt).c_str());
+        }
+    }
+    if (!guessed) {
         hedit_option_set(hedit, "format", "none");
         return;
     }
@@ -1152,7 +2014,10 @@ FormatSegment* hedit_format_iter_seek(FormatIterator* it, size_t pos) {
     HandleScope handle_scope(isolate);
     Context::Scope context_scope(user_context.Get(isolate));
 
-    return it->Seek(pos);
+    uint64_t start = metrics_now();
+    FormatSegment* segment = it->Seek(pos);
+    metrics_observe(metrics.format_seek_time, metrics_now() - start);
+    return segment;
 
 }
 
@@ -1178,6 +2043,10 @@ FormatSegment* hedit_format_iter_next(FormatIterator* it) {
 
 }
 
+const char* hedit_format_iter_name(FormatIterator* it) {
+    return it->Name();
+}
+
 void hedit_format_iter_free(FormatIterator* it) {
     delete it;
 }
@@ -1214,18 +2083,20 @@ JsFormatIterator* JsFormat::Iterator() {
         return NULL;
     }
 
-    return new JsFormatIterator(_isolate, Local<Object>::Cast(iterator));
+    return new JsFormatIterator(_hedit, _isolate, Local<Object>::Cast(iterator));
 }
 
-JsFormatIterator::JsFormatIterator(Isolate* isolate, Local<Object> jsIterator)
-        : _isolate(isolate),
+JsFormatIterator::JsFormatIterator(HEdit* hedit, Isolate* isolate, Local<Object> jsIterator)
+        : _hedit(hedit),
+          _isolate(isolate),
           _jsIterator(isolate, jsIterator)
 {
-    _current.name = (const char*) &_currentName;
-
     HandleScope handle_scope(isolate);
     Local<Context> ctx = isolate->GetCurrentContext();
 
+    // The segments are read directly from the native index
+    _index = UnwrapSegmentIndex(jsIterator->Get(ctx, v8_str("index")).ToLocalChecked());
+
     // Cache the `next` function
     Local<v8::Value> nextFunction = jsIterator->Get(ctx, v8_str("next")).ToLocalChecked();
     _nextFunction.Reset(_isolate, Local<Function>::Cast(nextFunction));
@@ -1235,55 +2106,47 @@ JsFormatIterator::JsFormatIterator(Isolate* isolate, Local<Object> jsIterator)
     _seekFunction.Reset(_isolate, Local<Function>::Cast(seekFunction));
 }
 
-void JsFormatIterator::UnpackJsSegment(Local<Object> seg) {
-    EscapableHandleScope handle_scope(_isolate);
-    Local<Context> ctx = _isolate->GetCurrentContext();
-    
-    // Start unpacking the other properties of the JS object in the native structure
-    String::Utf8Value name(isolate, seg->Get(ctx, v8_str("name")).ToLocalChecked());
-    strncpy((char*) &_currentName, *name, MAX_SEGMENT_NAME_LEN);
-    _currentName[MAX_SEGMENT_NAME_LEN - 1] = '\0';
-    _current.from = (size_t) seg->Get(ctx, v8_str("from")).ToLocalChecked()->IntegerValue(ctx).FromJust();
-    _current.to = (size_t) seg->Get(ctx, v8_str("to")).ToLocalChecked()->IntegerValue(ctx).FromJust();
-    _current.color = (int) seg->Get(ctx, v8_str("color")).ToLocalChecked()->IntegerValue(ctx).FromJust();
-
+FormatSegment* JsFormatIterator::Load(size_t i) {
+    int color;
+    if (!segindex_get(_index, i, &_current.from, &_current.to, &color, &_current.name)) {
+        _done = true;
+        return NULL;
+    }
+    _current.color = color;
+    _pos = i;
     _initialized = true;
+    return &_current;
 }
 
-bool JsFormatIterator::AdvanceIterator() {
-    EscapableHandleScope handle_scope(_isolate);
+bool JsFormatIterator::CallJs(const Persistent<Function>& fn, int argc, Local<v8::Value> argv[]) {
+    HandleScope handle_scope(_isolate);
     Local<Context> ctx = _isolate->GetCurrentContext();
 
-    Local<Object> iterator = _jsIterator.Get(_isolate);
-    Local<Function> nextFunction = _nextFunction.Get(_isolate);
+    // Do not call a format again once it has been terminated by the watchdog
+    if (FindFormatFallback(hedit_buffer_current(_hedit)) != NULL) {
+        return false;
+    }
 
-    // Call the `next()` method of the JS iterator
-    TryCatch tt;
+    // The JS iterator appends the new segments to the index and returns whether it succeeded
+    TraceScope trace("js.format");
+    WatchdogScope watchdog;
+    TryCatch tt(_isolate);
     Local<v8::Value> res;
-    if (!nextFunction->Call(ctx, iterator, 0, {}).ToLocal(&res)) {
+    uint64_t start = metrics_now();
+    bool ok = fn.Get(_isolate)->Call(ctx, _jsIterator.Get(_isolate), argc, argv).ToLocal(&res);
+    metrics_add(metrics.format_calls, 1);
+    metrics_observe(metrics.format_time, metrics_now() - start);
+    if (!ok) {
+        if (tt.HasTerminated()) {
+            FormatTerminated(_hedit);
+            return false;
+        }
         Local<v8::Value> ex = tt.Exception();
         String::Utf8Value str(isolate, ex);
         log_fatal("Invalid iterator: %s", c_str(str));
         return false;
     }
-    if (!res->IsObject()) {
-        log_fatal("Invalid iterator.");
-        return false;
-    }
-
-    // The returned object has two properties: `value` and `done`
-
-    Local<Object> resobj = Local<Object>::Cast(res);
-    bool done = resobj->Get(ctx, v8_str("done")).ToLocalChecked()->BooleanValue(ctx).FromJust();
-    if (done) {
-        _done = true;
-        return false;
-    }
-
-    Local<v8::Value> val = resobj->Get(ctx, v8_str("value")).ToLocalChecked();
-    UnpackJsSegment(Local<Object>::Cast(val));
-    
-    return true;
+    return res->BooleanValue(ctx).FromJust();
 }
 
 FormatSegment* JsFormatIterator::Seek(size_t pos) {
@@ -1293,33 +2156,23 @@ FormatSegment* JsFormatIterator::Seek(size_t pos) {
         return NULL;
     }
 
-    HandleScope handle_scope(_isolate);
-    Local<Context> ctx = _isolate->GetCurrentContext();
-    
-    Local<Object> iterator = _jsIterator.Get(_isolate);
-    Local<Function> seekFunction = _seekFunction.Get(_isolate);
-    Local<v8::Value> args[] = {
-        Integer::NewFromUnsigned(_isolate, (uint32_t) pos)
-    };
-    
-    // Call the `seek()` method of the JS iterator
-    TryCatch tt;
-    Local<v8::Value> res;
-    if (!seekFunction->Call(ctx, iterator, 1, args).ToLocal(&res)) {
-        Local<v8::Value> ex = tt.Exception();
-        String::Utf8Value str(isolate, ex);
-        log_fatal("Invalid iterator: %s", c_str(str));
-        return NULL;
-    }
-
-    // The `seek()` method is expected to return a js segment, or null
-    if (res->IsNull()) {
-        _done = true;
-        return NULL;
+    // Ask the JS side to linearize the format up to `pos` only if the index does not already cover it.
+    // The index might also start after `pos` if the linearization jumped ahead.
+    size_t i = segindex_find(_index, pos);
+    size_t first;
+    if (i == segindex_len(_index) || (i == 0 && segindex_get(_index, 0, &first, NULL, NULL, NULL) && pos < first)) {
+        HandleScope handle_scope(_isolate);
+        Local<v8::Value> args[] = {
+            Number::New(_isolate, (double) pos)
+        };
+        if (!CallJs(_seekFunction, 1, args)) {
+            _done = true;
+            return NULL;
+        }
+        i = segindex_find(_index, pos);
     }
-    UnpackJsSegment(Local<Object>::Cast(res));
 
-    return &_current;
+    return Load(i);
     
 }
 
@@ -1330,8 +2183,21 @@ FormatSegment* JsFormatIterator::Next() {
         return NULL;
     }
 
-    // Advance the JS iterator
-    return this->AdvanceIterator() ? &_current : NULL;
+    // Advance the JS iterator only if the next segment is not in the index yet
+    size_t i = _initialized ? _pos + 1 : 0;
+    if (i >= segindex_len(_index)) {
+        if (!CallJs(_nextFunction, 0, NULL)) {
+            _done = true;
+            return NULL;
+        }
+
+        // The JS side might have evicted the oldest segments, shifting the others
+        if (_initialized) {
+            i = segindex_find(_index, _current.to + 1);
+        }
+    }
+
+    return Load(i);
 
 }
 
@@ -1349,3 +2215,20 @@ FormatSegment* JsFormatIterator::Current() {
 
     return &_current;
 }
+
+const char* JsFormatIterator::Name() {
+
+    // Return NULL if there is no current segment
+    if (_done || !_initialized) {
+        return NULL;
+    }
+
+    // Only the root name exists if no named segment has ever been produced
+    if (segment_names == NULL) {
+        _currentName[0] = '\0';
+    } else {
+        nametree_path(segment_names, _current.name, " > ", _currentName, MAX_SEGMENT_NAME_LEN);
+    }
+    return _currentName;
+
+}
@@ -8,6 +8,8 @@
 #ifdef __cplusplus
 
 #include <map>
+#include <memory>
+#include <string>
 #include <v8.h>
 
 class JsBuiltinModule {
@@ -18,15 +20,21 @@ public:
     const char* GetSource();
     size_t GetSourceLen();
     v8::Persistent<v8::Module>& GetHandle();
+    v8::Local<v8::Object> GetNamespace(v8::Isolate*);
     bool Eval(v8::Isolate*);
 
+    // Marks the module as already evaluated by the startup snapshot.
+    void Restore(v8::Isolate*, v8::Local<v8::Object> ns);
+
     static std::shared_ptr<JsBuiltinModule> FromName(std::string name);
+    static const std::map<std::string, std::shared_ptr<JsBuiltinModule>>& All();
 
 private:
     const std::string _name;
     const char* _source;
     size_t _source_len;
     v8::Persistent<v8::Module> _module;
+    v8::Persistent<v8::Object> _namespace;
 
     // This is the map of all the builtin modules.
     // It is filled at build time by generating another .cc file with the initializer.
@@ -34,6 +42,15 @@ private:
     static std::map<std::string, std::shared_ptr<JsBuiltinModule>> _all_modules;
 };
 
+/**
+ * Startup snapshot with all the builtin modules (but the initializer) already evaluated.
+ * It is generated at build time by `hedit_mksnapshot`, see `tools/mksnapshot.cc`.
+ */
+extern v8::StartupData hedit_js_snapshot;
+
+/** Evaluates the builtin modules and writes the resulting startup snapshot as a C++ source file. */
+bool hedit_js_write_snapshot(const char* path);
+
 #endif
 
 
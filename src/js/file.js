@@ -1,5 +1,9 @@
 /**
  * Functions to operate on the currently open file.
+ *
+ * Offsets and lengths are plain numbers, which represent exactly all the integers up to 2^53:
+ * files larger than 4GiB can be addressed without any loss.
+ *
  * @module hedit/file
  */
 
@@ -113,6 +117,28 @@ export default {
         } else {
             return __hedit.file_read(0 + pos, 0 + len);
         }
+    },
+
+    /**
+     * Returns a portion of the currently open file as a list of buffers, one for each piece of the file,
+     * without building a single contiguous copy of the whole range. Use this instead of {@link module:hedit/file.read}
+     * to scan large regions of a file.
+     *
+     * The buffers are copies: writing to them does not change the file.
+     * They are detached (i.e. their `byteLength` drops to 0) as soon as an edit may change their contents
+     * or the file is closed, so do not keep them around: read them again instead.
+     *
+     * @alias module:hedit/file.chunks
+     * @param {number} pos - Index of the first byte to read.
+     * @param {number} len - How many bytes to read.
+     * @return {ArrayBuffer[]} Consecutive chunks of the file, covering the requested range.
+     */
+    chunks(pos, len) {
+        if (!this.isOpen) {
+            return null;
+        } else {
+            return __hedit.file_chunks(0 + pos, 0 + len);
+        }
     }
 
 };
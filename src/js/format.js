@@ -4,6 +4,10 @@
  */
 
 import formatInternal from 'hedit/private/format';
+import names from 'hedit/private/names';
+
+// Incremented every time any format changes, to invalidate the cached static sizes.
+let formatsVersion = 0;
 
 // Color names to integers map.
 const COLORS = {
@@ -17,15 +21,6 @@ const COLORS = {
     orange: 7
 };
 
-// Helper function to join two optional strings
-function join(a, b) {
-    if (a && b) {
-        return a + ' > ' + b;
-    } else {
-        return a ? a : b;
-    }
-}
-
 /**
  * A `Format` represents the binary structure of a file.
  *
@@ -76,6 +71,32 @@ class Format {
         this._segments = [];
     }
 
+    _push(seg) {
+        this._segments.push(seg);
+        formatsVersion++;
+    }
+
+    /**
+     * Returns the size in bytes of this format if it does not depend on the data of the file, or `null` otherwise.
+     * @private
+     */
+    __staticSize() {
+        if (this._staticSizeVersion !== formatsVersion) {
+            let size = 0;
+            for (let seg of this._segments) {
+                const segSize = seg.child ? seg.child.__staticSize() : seg.length;
+                if (segSize === null) {
+                    size = null;
+                    break;
+                }
+                size += segSize;
+            }
+            this._staticSize = size;
+            this._staticSizeVersion = formatsVersion;
+        }
+        return this._staticSize;
+    }
+
     /**
      * Repeates a child format a fixed number of times.
      *
@@ -107,13 +128,42 @@ class Format {
         if (child instanceof Format) {
 
             // A composite child
-            this._segments.push({
+            this._push({
                 child: {
-                    *__linearize(proxy, absoffset, basename, variables) {
+                    __staticSize() {
+                        if (typeof repeat !== 'number' || !isFinite(repeat)) {
+                            return null;
+                        }
+                        const size = child.__staticSize();
+                        return size === null ? null : Math.max(repeat, 0) * size;
+                    },
+                    *__linearize(proxy, absoffset, parent, variables, trace = null, depth = 0, resume = null, target = null) {
+                        const frame = resume && resume[depth];
+                        const current = { index: 0, offset: 0 };
                         const n = typeof repeat === 'function' ? repeat(variables) : repeat;
-                        let offset = absoffset;
-                        for (let i = 0; i < n; i++) {
-                            for (let childseg of child.__linearize(proxy, offset, join(basename, name), Object.create(variables))) {
+                        const childName = names.child(parent, name);
+                        const size = target ? child.__staticSize() : null;
+                        let offset = frame ? frame.offset : absoffset;
+                        for (let i = frame ? frame.index : 0; i < n; i++) {
+
+                            // If all the repetitions have the same size, jump straight to the one including the target
+                            if (size > 0 && target.pos - offset >= size) {
+                                const skip = Math.min(Math.floor((target.pos - offset) / size), n - i - 1);
+                                if (skip > 0) {
+                                    i += skip;
+                                    offset += skip * size;
+                                    target.jumped = true;
+                                }
+                            }
+
+                            if (trace) {
+                                current.index = i;
+                                current.offset = offset;
+                                trace[depth] = current;
+                                trace.length = depth + 1;
+                            }
+                            const childResume = frame && i === frame.index ? resume : null;
+                            for (let childseg of child.__linearize(proxy, offset, childName, Object.create(variables), trace, depth + 1, childResume, target)) {
                                 yield childseg;
                                 offset = childseg.to + 1;
                             }
@@ -125,13 +175,16 @@ class Format {
         } else if (typeof child === 'string') {
 
             // Shortcut for a simple array of bytes
-            this._segments.push({
+            this._push({
                 child: {
-                    *__linearize(proxy, absoffset, basename, variables) {
+                    __staticSize() {
+                        return typeof repeat === 'number' && isFinite(repeat) ? Math.max(repeat, 0) : null;
+                    },
+                    *__linearize(proxy, absoffset, parent, variables) {
                         const n = typeof repeat === 'function' ? repeat(variables) : repeat;
                         if (n > 0) {
                             yield {
-                                name: join(basename, name),
+                                name: names.child(parent, name),
                                 color: COLORS[child],
                                 from: absoffset,
                                 to: absoffset + n - 1
@@ -243,18 +296,44 @@ class Format {
         return parent;
     }
 
-    *__linearize(proxy, absoffset, basename, variables) {
+    /**
+     * Generates the segments of this format starting at `absoffset`.
+     * The name of each segment is the id of a node of `hedit/private/names` below `parent`.
+     *
+     * If `trace` is given, `trace[depth]` is kept updated with the position of the segment being generated
+     * at this level of nesting, so that the whole array describes where the last yielded segment came from.
+     * A copy of a trace can be passed later as `resume` to restart the linearization from that segment.
+     *
+     * If `target` is given, arrays of formats with a static size skip all the repetitions before
+     * the one including the byte `target.pos`, and set `target.jumped` when they do.
+     * @private
+     */
+    *__linearize(proxy, absoffset, parent, variables, trace = null, depth = 0, resume = null, target = null) {
 
         if (this._parent) {
             throw new Error('Unbalanced group()/endgroup() calls.');
         }
 
+        const frame = resume && resume[depth];
+        const current = { index: 0, offset: 0, variables };
         let offset = absoffset;
+        if (frame) {
+            offset = frame.offset;
+            Object.assign(variables, frame.variables);
+        }
 
         // Iterate over all the segments computing the actual absolute offsets
-        for (let seg of this._segments) {
+        for (let j = frame ? frame.index : 0; j < this._segments.length; j++) {
+            const seg = this._segments[j];
+            if (trace) {
+                current.index = j;
+                current.offset = offset;
+                trace[depth] = current;
+                trace.length = depth + 1;
+            }
             if (seg.child) {
-                for (let childseg of seg.child.__linearize(proxy, offset, join(basename, seg.name), Object.create(variables))) {
+                const childResume = frame && j === frame.index ? resume : null;
+                for (let childseg of seg.child.__linearize(proxy, offset, names.child(parent, seg.name), Object.create(variables), trace, depth + 1, childResume, target)) {
                     yield childseg;
                     offset = childseg.to + 1;
                 }
@@ -263,7 +342,7 @@ class Format {
                     variables[seg.id] = seg.read(proxy, offset);
                 }
                 yield {
-                    name: join(basename, seg.name),
+                    name: names.child(parent, seg.name),
                     color: COLORS[seg.color],
                     from: offset,
                     to: offset + seg.length - 1
@@ -282,15 +361,15 @@ function addCommonMethod(name, length, m, endianess) {
         
         // Generate two methods for the little and big endian version
         Format.prototype[name + 'le'] = function (name, color = 'white', id) {
-            this._segments.push({
+            this._push({
                 name,
                 color,
                 length,
                 id,
                 read(proxy, off) {
-                    const buf = proxy.read(off, length);
-                    if (buf) {
-                        return m.call(new DataView(buf), 0, true /* Little endian */);
+                    const view = proxy.read(off, length);
+                    if (view) {
+                        return m.call(view, 0, true /* Little endian */);
                     } else {
                         return null;
                     }
@@ -299,15 +378,15 @@ function addCommonMethod(name, length, m, endianess) {
             return this;
         };
         Format.prototype[name + 'be'] = function (name, color = 'white', id) {
-            this._segments.push({
+            this._push({
                 name,
                 color,
                 length,
                 id,
                 read(proxy, off) {
-                    const buf = proxy.read(off, length);
-                    if (buf) {
-                        return m.call(new DataView(buf), 0, false /* Big endian */);
+                    const view = proxy.read(off, length);
+                    if (view) {
+                        return m.call(view, 0, false /* Big endian */);
                     } else {
                         return null;
                     }
@@ -323,15 +402,15 @@ function addCommonMethod(name, length, m, endianess) {
 
         // Generate a single method regardless of the endianess
         Format.prototype[name] = function (name, color = 'white', id) {
-            this._segments.push({
+            this._push({
                 name,
                 color,
                 length,
                 id,
                 read(proxy, off) {
-                    const buf = proxy.read(off, length);
-                    if (buf) {
-                        return m.call(new DataView(buf), 0);
+                    const view = proxy.read(off, length);
+                    if (view) {
+                        return m.call(view, 0);
                     } else {
                         return null;
                     }
@@ -331,7 +331,30 @@ class HEdit extends EventEmitter {
      * log.info('Current colwidth:', hedit.get('colwidth'));
      */
     get(name) {
-        return __hedit.get(name);
+        // The values are cached until the next `option-change` event
+        if (optionValues.has(name)) {
+            return optionValues.get(name);
+        }
+        const value = __hedit.get(name);
+        optionValues.set(name, value);
+        return value;
+    }
+
+    /**
+     * Returns a snapshot of the performance metrics collected by the editor, the same shown by `:stats`.
+     *
+     * Counters are plain numbers. Histograms of durations are objects with the number of samples (`count`),
+     * their total (`sum`), the maximum (`max`) and two estimated percentiles (`p50` and `p99`),
+     * all in microseconds.
+     *
+     * @alias module:hedit.stats
+     * @return {Object} Object mapping the name of each metric to its value.
+     *
+     * @example
+     * log.info('Pieces in the open files:', hedit.stats()['file.pieces']);
+     */
+    stats() {
+        return __hedit.stats();
     }
 
     /**
@@ -350,7 +373,13 @@ class HEdit extends EventEmitter {
 
 const hedit = new HEdit();
 
+// Cache of the option values read with `hedit.get`
+const optionValues = new Map();
+
 __hedit.registerEventBroker((name, ...args) => {
+    if (name === 'hedit/option-change') {
+        optionValues.delete(args[0]);
+    }
     hedit.emit(name.substring(6) /* Chop off `hedit/` from the name. */, ...args);
 });
 
@@ -398,4 +427,15 @@ __hedit.registerEventBroker((name, ...args) => {
  * @param {integer} len Length of the change.
  */
 
+/**
+ * Event raised when the user switches to another open buffer.
+ * @event buffer-switch
+ */
+
+/**
+ * Event raised when the value of an option changes.
+ * @event option-change
+ * @param {string} name - Name of the option.
+ */
+
 export default hedit;
@@ -22,4 +22,15 @@ hedit.registerOption('format', '', name => {
     }
     format.setFormat(name);
     return true;
-});
\ No newline at end of file
+});
+
+hedit.registerOption('formatcache', '64M', value => {
+    const match = /^(\d+)([KMG]?)$/i.exec(value);
+    if (!match) {
+        log.error('Invalid size: ' + value + '.');
+        return false;
+    }
+    const multipliers = { '': 1, 'k': 1024, 'm': 1024 * 1024, 'g': 1024 * 1024 * 1024 };
+    format.setCacheBudget(parseInt(match[1]) * multipliers[match[2].toLowerCase()]);
+    return true;
+});
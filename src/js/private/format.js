@@ -1,7 +1,7 @@
 import hedit from 'hedit';
 import file from 'hedit/file';
 import log from 'hedit/log';
-import IntervalTree from 'hedit/private/intervaltree';
+import names from 'hedit/private/names';
 
 /** A reverse lookup to provide fast automatic guesses of file formats. */
 const guessLookup = {
@@ -29,129 +29,440 @@ function storeGuess(name, guess) {
  */
 const allFormats = {};
 
-/** Proxy class that records and aggregates the access to the underlying file data. */
+/** Size of the pages read by `FileProxy`. */
+const PAGE_SIZE = 64 * 1024;
+
+/** Number of pages kept by `FileProxy`, 4MiB in total. */
+const MAX_PAGES = 64;
+
+/**
+ * Proxy class that records and aggregates the access to the underlying file data.
+ * The file is read one page at a time, so that most of the reads do not need to cross into native code,
+ * and the accesses are tracked at the same granularity.
+ * Only the `MAX_PAGES` most recently used pages are kept: the map iterates in insertion order,
+ * so a page is moved to its end every time it is used, and the first one is the least recently used.
+ */
 class FileProxy {
     constructor() {
-        this._accessed = new IntervalTree();
+        this._pages = new Map();
+
+        // Page of the last read, which is most often the page of the next one too
+        this._lastIndex = -1;
+        this._lastPage = null;
+
+        // End of the farthest read done so far
+        this.readEnd = 0;
+    }
+
+    _page(index) {
+        if (index === this._lastIndex) {
+            return this._lastPage;
+        }
+
+        let page = this._pages.get(index);
+        if (page === undefined) {
+            page = file.read(index * PAGE_SIZE, PAGE_SIZE);
+            if (this._pages.size >= MAX_PAGES) {
+                this._pages.delete(this._pages.keys().next().value);
+            }
+        } else {
+            this._pages.delete(index);
+        }
+        this._pages.set(index, page);
+
+        this._lastIndex = index;
+        this._lastPage = page;
+        return page;
     }
 
+    /** Returns a `DataView` over `len` bytes starting at `offset`, or `null` if they go beyond the end of the file. */
     read(offset, len) {
-        this._accessed.insert(offset, offset + len - 1);
-        const buf = file.read(offset, len);
-        return buf.byteLength < len ? null : buf;
+        this.readEnd = Math.max(this.readEnd, offset + len);
+
+        const first = Math.floor(offset / PAGE_SIZE);
+        const last = Math.floor((offset + len - 1) / PAGE_SIZE);
+
+        // Fast path: the whole read is inside a single page
+        if (first === last) {
+            const page = this._page(first);
+            const start = offset - first * PAGE_SIZE;
+            if (!page || start + len > page.byteLength) {
+                return null;
+            }
+            return new DataView(page, start, len);
+        }
+
+        // Stitch together the parts coming from different pages
+        const buf = new Uint8Array(len);
+        for (let i = first; i <= last; i++) {
+            const page = this._page(i);
+            const pageStart = i * PAGE_SIZE;
+            const from = Math.max(offset, pageStart);
+            const to = Math.min(offset + len, pageStart + PAGE_SIZE);
+            if (!page || to - pageStart > page.byteLength) {
+                return null;
+            }
+            buf.set(new Uint8Array(page, from - pageStart, to - from), from - offset);
+        }
+        return new DataView(buf.buffer);
     }
 
-    hasRead(offset, len) {
-        if (len < 0) {
-            return false;
+    /** Drops the pages that may have been changed by an edit at the given offset. */
+    invalidateFrom(offset) {
+        const first = Math.floor(offset / PAGE_SIZE);
+        for (let i of this._pages.keys()) {
+            if (i >= first) {
+                this._pages.delete(i);
+            }
         }
-        return this._accessed.search(offset, offset + len - 1).length > 0;
+        if (this._lastIndex >= first) {
+            this._lastIndex = -1;
+            this._lastPage = null;
+        }
+    }
+}
+
+/** Number of nodes of the name tree already mirrored on the native side. The root is always there. */
+let syncedNames = 1;
+
+/** Mirrors on the native side the nodes added to the name tree since the last call. */
+function syncNames() {
+    for (; syncedNames < names.length; syncedNames++) {
+        __hedit.names_add(names.parents[syncedNames], names.names[syncedNames]);
     }
 }
 
-/** Wrapper class that caches the values of a linearized format. */
-class FormatCache {
+/** Number of segments between two checkpoints of the linearization. */
+const CHECKPOINT_INTERVAL = 1024;
+
+/** Milliseconds a single repaint can spend linearizing the format before deferring to the background. */
+const FOREGROUND_BUDGET = 8;
+
+/** Milliseconds of each slice of background linearization. */
+const BACKGROUND_SLICE = 16;
+
+/**
+ * Minimum distance in bytes from the end of the linearized segments for a seek to jump
+ * over the repetitions of fixed-size arrays, instead of linearizing all of them.
+ */
+const JUMP_DISTANCE = 1024 * 1024;
+
+/** Bytes taken by a segment in the native index. */
+const SEGMENT_SIZE = 21;
+
+/** Rough estimate of the bytes taken by a checkpoint. */
+const CHECKPOINT_SIZE = 512;
+
+/** Minimum number of segments and checkpoints kept, whatever the budget. */
+const MIN_SEGMENTS = 64 * 1024;
+const MIN_CHECKPOINTS = 64;
+
+/** Memory budget in bytes of each format cache, set with `:set formatcache`. */
+let cacheBudget = 64 * 1024 * 1024;
+
+/**
+ * Wrapper class that caches the values of a linearized format.
+ *
+ * The segments are stored in a native index (see `util/segindex.h`), which the native code
+ * searches directly while drawing: the JS side only appends the new segments as they are produced.
+ *
+ * The index always holds a contiguous run of segments, starting at the byte `_start`. When a seek lands far
+ * from the linearized segments, the linearization jumps straight to the target position across arrays
+ * of fixed-size formats: in that case the index is restarted from the segment the linearization jumped to.
+ *
+ * Every `CHECKPOINT_INTERVAL` segments the state of the linearization is saved in a checkpoint,
+ * together with the end of the farthest read done so far. When the file changes, the linearization
+ * restarts from the last checkpoint that did not depend on any of the changed bytes.
+ *
+ * The memory used by the cache is bounded by `cacheBudget`: three quarters go to the segments and
+ * one to the checkpoints. The pages of the file read meanwhile are bounded separately by `FileProxy`. When the index grows too much, the segments before the last seek are dropped,
+ * and seeking back to them resumes the linearization from the closest checkpoint. When the checkpoints
+ * are too many, every other one is dropped.
+ */
+export class FormatCache {
     constructor(format) {
         this._format = format;
+        this._index = __hedit.segindex_new();
+        this._jump = { pos: -1, jumped: false };
+        this._base = 0;
+        this._viewport = 0;
         this.invalidate();
+
+        // Background linearization state: the range of bytes requested while drawing
+        this._targetFrom = -1;
+        this._target = -1;
+        this._scheduled = false;
     }
 
     /** Invalidates all the cached data. */
     invalidate() {
         this._fileProxy = new FileProxy();
-        this._generator = this._format.__linearize(this._fileProxy, 0, '', Object.create(null));
-        this._cachedSegments = [];
-        this._cachedTree = new IntervalTree();
+        this._rewind();
+    }
+
+    /** Restarts the linearization from the beginning of the file. */
+    _rewind() {
+        this._trace = [];
+        this._generator = this._format.__linearize(this._fileProxy, 0, 0, Object.create(null), this._trace, 0, null, this._jump);
+        this._clearCheckpoints();
+        this._ended = false;
+        this._truncate(0, -1);
+    }
+
+    _clearCheckpoints() {
+        this._checkpoints = [];
+        this._checkpointInterval = CHECKPOINT_INTERVAL;
+    }
+
+    /** Drops all the segments after `checkpoint` and resumes the linearization from there. */
+    _resume(checkpoint) {
+        this._truncate(checkpoint.index, checkpoint.lastTo);
+        this._ended = false;
+        this._trace = [];
+        this._generator = this._format.__linearize(this._fileProxy, 0, 0, Object.create(null), this._trace, 0, checkpoint.frames, this._jump);
+    }
+
+    /**
+     * Invalidates only the data depending on the bytes from `offset` onwards.
+     * Returns `true` if any cached segment has been dropped.
+     */
+    invalidateFrom(offset) {
+        const proxy = this._fileProxy;
+        proxy.invalidateFrom(offset);
+
+        // Nothing to do if the linearization has not read that far yet
+        if (proxy.readEnd <= offset) {
+            return false;
+        }
+
+        // Find the last checkpoint not depending on the changed bytes
+        let k = this._checkpoints.length - 1;
+        while (k >= 0 && this._checkpoints[k].readEnd > offset) {
+            k--;
+        }
+        if (k < 0) {
+            this.invalidate();
+            return true;
+        }
+        const checkpoint = this._checkpoints[k];
+        this._checkpoints.length = k + 1;
+
+        // Keep the segments before the checkpoint and resume the linearization from there
+        proxy.readEnd = checkpoint.readEnd;
+        this._resume(checkpoint);
+        return true;
+    }
+
+    /**
+     * Drops all the segments from the `length`-th onwards. `lastTo` is the end of the last segment kept.
+     *
+     * Segments are numbered from the last restart of the index, so that checkpoints keep pointing
+     * to the same segments even after the first ones have been evicted: `_base` is the number
+     * of the first segment still in the native index.
+     */
+    _truncate(length, lastTo) {
+        if (length > this._base) {
+            __hedit.segindex_truncate(this._index, length - this._base);
+        } else {
+            __hedit.segindex_truncate(this._index, 0);
+            this._base = length;
+            this._start = lastTo + 1;
+        }
+        this._length = length;
+        this._lastTo = lastTo;
+    }
+
+    /** Drops the oldest segments when the index exceeds its share of the memory budget. */
+    _evict() {
+        const maxSegments = Math.max(MIN_SEGMENTS, Math.floor(cacheBudget * 3 / 4 / SEGMENT_SIZE));
+        if (this._length - this._base <= maxSegments) {
+            return;
+        }
+
+        // Keep half of the budget, but never drop the segments from the last seek onwards
+        let count = this._length - this._base - Math.floor(maxSegments / 2);
+        if (this._viewport >= this._start) {
+            count = Math.min(count, __hedit.segindex_find(this._index, this._viewport));
+        }
+        if (count <= 0) {
+            return;
+        }
+
+        __hedit.segindex_drop(this._index, count);
+        this._base += count;
+        this._start = __hedit.segindex_get(this._index, 0).from;
+    }
+
+    /** Halves the number of checkpoints when they exceed their share of the memory budget. */
+    _thinCheckpoints() {
+        if (this._checkpoints.length <= Math.max(MIN_CHECKPOINTS, cacheBudget / 4 / CHECKPOINT_SIZE)) {
+            return;
+        }
+
+        this._checkpointInterval *= 2;
+        this._checkpoints = this._checkpoints.filter(c => c.index % this._checkpointInterval === 0);
+    }
+
+    /** Advances the linearization by one segment and caches it. Returns `false` when the linearization is over. */
+    _advance() {
+        const { done, value } = this._generator.next();
+        if (done) {
+            this._ended = true;
+            return false;
+        }
+
+        if (value.name >= syncedNames) {
+            syncNames();
+        }
+
+        // If the linearization jumped ahead, restart the index from here
+        if (this._jump.jumped) {
+            this._jump.jumped = false;
+            this._clearCheckpoints();
+            this._truncate(0, value.from - 1);
+        }
+
+        const index = this._length;
+        const lastTo = this._lastTo;
+        __hedit.segindex_append(this._index, value.from, value.to, value.color, value.name);
+        this._length++;
+        this._lastTo = value.to;
+
+        // The trace describes the position of the segment just yielded: resuming from it yields this segment again
+        const last = this._checkpoints[this._checkpoints.length - 1];
+        if (index % this._checkpointInterval === 0 && !(last && last.index >= index)) {
+            this._checkpoints.push({
+                index,
+                lastTo,
+                readEnd: this._fileProxy.readEnd,
+                frames: this._trace.map(f => ({
+                    index: f.index,
+                    offset: f.offset,
+                    variables: f.variables && Object.assign({}, f.variables)
+                }))
+            });
+            this._thinCheckpoints();
+        }
+
+        this._evict();
+        return true;
+    }
+
+    /**
+     * Linearizes the format so that the index covers all the bytes from `from` to `pos`,
+     * giving up when the time `deadline` is reached.
+     * Returns `false` if the deadline has been reached before `pos`.
+     */
+    _linearizeUpTo(pos, deadline, from = pos) {
+
+        this._viewport = from;
+
+        // Start again from the closest checkpoint if the bytes requested come before the ones in the index
+        if (from < this._start) {
+            let k = this._checkpoints.length - 1;
+            while (k >= 0 && this._checkpoints[k].lastTo >= from) {
+                k--;
+            }
+            if (k >= 0) {
+                this._resume(this._checkpoints[k]);
+            } else {
+                this._rewind();
+            }
+        }
+
+        // Allow jumps only if the bytes requested are far enough
+        this._jump.pos = from - this._lastTo > JUMP_DISTANCE ? from : -1;
+
+        let reached = true;
+        for (let n = 0; !this._ended && this._lastTo < pos; n++) {
+            if (n % 64 === 63 && Date.now() >= deadline) {
+                reached = false;
+                break;
+            }
+            this._advance();
+        }
+
+        this._jump.pos = -1;
+        return reached;
+    }
+
+    /** Continues the linearization up to `pos` in the background, repainting the screen as segments arrive. */
+    _defer(pos) {
+        if (this._scheduled) {
+            this._targetFrom = Math.min(this._targetFrom, pos);
+            this._target = Math.max(this._target, pos);
+            return;
+        }
+        this._targetFrom = pos;
+        this._target = pos;
+        this._schedule();
+    }
+
+    _schedule() {
+        this._scheduled = true;
+        __hedit.later(0, () => {
+            this._scheduled = false;
+
+            // Stop if the format changed in the meantime
+            if (currentFormatCache !== this) {
+                return;
+            }
+
+            const done = this._linearizeUpTo(this._target, Date.now() + BACKGROUND_SLICE, this._targetFrom);
+            __hedit.redraw();
+            if (!done) {
+                this._schedule();
+            }
+        });
     }
 
     /**
      * This method is called from the native code to get an iterator every time the screen needs to be repainted.
-     * The iterator returned must also expose a `seek` method to position the iterator at a given byte offset.
-     * 
-     * The returned iterator iterates over the cached segments and advances the underlying format iterator
-     * only when needed.
+     *
+     * The native code reads the segments directly from `index`, and calls `seek(pos)` or `next()` only when
+     * the segments it needs are not in the index yet. Each iterator advances the format for at most
+     * `FOREGROUND_BUDGET` milliseconds: after that, it reports no more segments and the linearization
+     * continues in the background, so that drawing never blocks on a long linearization.
      */
     [Symbol.iterator]() {
-        let i = 0;
-        let ended = false;
+        let deadline = null;
+        const getDeadline = () => deadline === null ? (deadline = Date.now() + FOREGROUND_BUDGET) : deadline;
 
         return {
-            next: function () {
-
-                // Do nothing if the iterator ended already
-                if (ended) {
-                    return { done: true };
-                }
+            index: this._index,
 
-                // Return a cached segment if available
-                if (i < this._cachedSegments.length) {
-                    i++;
-                    return { value: this._cachedSegments[i], done: false };
+            // Appends at least one more segment to the index. Returns `false` if there are no more.
+            next: function () {
+                if (this._ended) {
+                    return false;
                 }
-                
-                // Otherwise advance the original generator and cache the new segment
-                const { done, value } = this._generator.next();
-                if (done) {
-                    ended = true;
-                    return { done: true };
-                } else {
-                    this._cachedSegments.push(value);
-                    this._cachedTree.insert(value.from, value.to, [ i, value ]);
-                    i++;
-                    return { value, done: false };
+                if (Date.now() >= getDeadline()) {
+                    this._defer(this._lastTo + 1);
+                    return false;
                 }
-                
+                return this._advance();
             }.bind(this),
-            
-            seek: function (pos) {
-            
-                // Do nothing if the iterator ended already
-                if (ended) {
-                    return null;
-                }
-
-                // Search for a cached segment
-                const [ res ] = this._cachedTree.search(pos, pos);
-                if (res) {
-                    const [ newIndex, seg ] = res;
-                    i = newIndex + 1;
-                    return seg;
-                }
 
-                // Advance the iterator until we reach the position `pos`
-                while (true) {
-                    const { done, value } = this._generator.next();
-                    if (done) {
-                        ended = true;
-                        return null;
-                    } else {
-
-                        // Cache the segment
-                        this._cachedSegments.push(value);
-                        this._cachedTree.insert(value.from, value.to, [ i, value ]);
-                        i++;
-
-                        // Stop if we reached the target position
-                        if (pos <= value.to) {
-                            return value;
-                        }
-                        
-                    }
+            // Makes the index cover the byte `pos`.
+            // Returns `false` if the time is up and the segments will be ready later.
+            seek: function (pos) {
+                if (!this._linearizeUpTo(pos, getDeadline())) {
+                    this._defer(pos);
+                    return false;
                 }
-
+                return true;
             }.bind(this)
         };
     }
 }
 
-// When the contents of the file change, check if we need to invalidate the current format cache
+// The caches are invalidated from the native side when their file changes, since it knows which buffer
+// each of them belongs to
 let currentFormatCache = null;
-hedit.on('file/change', (offset, len) => {
-    if (currentFormatCache && currentFormatCache._fileProxy.hasRead(offset, len)) {
-        currentFormatCache.invalidate();
-        log.debug('Format cache invalidated.');
-        __hedit.redraw();
-    }
+
+// Each buffer keeps its own format cache: pick up the one of the buffer we switched to
+hedit.on('buffer-switch', () => {
+    currentFormatCache = __hedit.file_getFormat();
 });
 
 export default {
@@ -224,6 +535,12 @@ export default {
 
         currentFormatCache = new FormatCache(format());
         __hedit.file_setFormat(currentFormatCache);
+    },
+
+    // This function is called every time the `:set` option `formatcache` changes.
+    // The new budget applies to all the format caches, and is enforced as soon as they grow.
+    setCacheBudget(bytes) {
+        cacheBudget = bytes;
     }
 
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+/**
+ * Tree of the hierarchical names of the format segments.
+ *
+ * Each node is identified by an integer id and represents the name made of the names of all its ancestors,
+ * joined by ` > `. The root node has id 0 and an empty name. Nodes are shared by all the formats and never
+ * removed, so segments can carry just the id of their name, and the full name is built only when displayed.
+ *
+ * The native side keeps a mirror of this tree (see `util/nametree.h`) with the same ids.
+ */
+class NameTree {
+    constructor() {
+        this.parents = [ -1 ];
+        this.names = [ '' ];
+        this._children = [ new Map() ];
+    }
+
+    /** Number of nodes in the tree, root included. */
+    get length() {
+        return this.parents.length;
+    }
+
+    /** Returns the id of the node `name` below `parent`. If `name` is empty, returns `parent` itself. */
+    child(parent, name) {
+        if (!name) {
+            return parent;
+        }
+
+        const children = this._children[parent];
+        let id = children.get(name);
+        if (id === undefined) {
+            id = this.parents.length;
+            this.parents.push(parent);
+            this.names.push(name);
+            this._children.push(new Map());
+            children.set(name, id);
+        }
+        return id;
+    }
+
+    /** Builds the full name of the node `id`. */
+    path(id) {
+        let path = '';
+        for (; id > 0; id = this.parents[id]) {
+            path = path ? this.names[id] + ' > ' + path : this.names[id];
+        }
+        return path;
+    }
+}
+
+export default new NameTree();
@@ -11,9 +11,11 @@
 #include "actions.h"
 #include "commands.h"
 #include "options.h"
+#include "server.h"
 #include "js.h"
 #include "util/log.h"
 #include "util/pubsub.h"
+#include "util/trace.h"
 
 static sigjmp_buf sigint_jmpbuf;
 
@@ -99,6 +101,23 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // Start serving the open file to other processes, if requested
+    Server* server = NULL;
+    if (options.listen != NULL) {
+        server = hedit_server_start(hedit, options.listen);
+        if (server == NULL) {
+            hedit_core_teardown(hedit);
+            return 1;
+        }
+    }
+
+    // Record a trace of the session, if requested
+    if (options.trace != NULL && !trace_start(options.trace)) {
+        hedit_server_stop(server);
+        hedit_core_teardown(hedit);
+        return 1;
+    }
+
     // Fire the load event as soon as everything is ready
     tickit_later(tickit, 0, do_register_sigint, hedit);
     tickit_later(tickit, 0, on_tickit_ready, hedit);
@@ -129,8 +148,10 @@ int main(int argc, char** argv) {
 
     // Tear down everything
     int exitcode = hedit->exitcode;
+    hedit_server_stop(server);
     hedit_core_teardown(hedit);
     tickit_unref(tickit);
+    trace_stop();
     log_teardown();
     return exitcode;
 
@@ -17,8 +17,11 @@ static struct option long_options[] = {
     { "debug-fd",           required_argument, NULL, 'D' },
     { "debug-colors",       no_argument,       NULL,  0  },
     { "debug-min-severity", required_argument, NULL,  0  },
+    { "trace",              required_argument, NULL,  0  },
+    { "record-keys",        required_argument, NULL,  0  },
 
     { "command",            required_argument, NULL, 'c' },
+    { "listen",             required_argument, NULL, 'l' },
 
     { "help",               no_argument,       NULL, 'h' },
     { "version",            no_argument,       NULL, 'v' },
@@ -32,12 +35,15 @@ static void print_usage(const char* selfpath) {
         "Usage: %s [filename] [-hv]\n"
         "\n"
         "-c, --command                Execute a command when the editor starts.\n"
+        "-l, --listen                 Serve the open file to other processes on the given UNIX socket.\n"
         "\n"
         "Debug options:\n"
         "-D, --debug-fd               Output debug information to the given file descriptor.\n"
         "    --debug-colors           Enable colors in debug output.\n"
         "    --debug-min-severity     Filter debug messages. Available severities:\n"
-        "                             debug, info, warn, error, fatal."
+        "                             debug, info, warn, error, fatal.\n"
+        "    --trace                  Record a Chrome trace of the session in the given JSON file.\n"
+        "    --record-keys            Record the keys pressed, with their timings, in the given file.\n"
         "\n"
         "Other options:\n"
         "-h, --help                   Display this help text.\n"
@@ -74,18 +80,25 @@ bool options_parse(Options* options, int argc, char** argv) {
     options->show_help = false;
     options->show_version = false;
     options->command = NULL;
+    options->listen = NULL;
+    options->trace = NULL;
+    options->record_keys = NULL;
     options->file = NULL;
 
     // Args parsing
     int opt;
     int longopt_index;
-    while ((opt = getopt_long(argc, argv, "c:D:hv", long_options, &longopt_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "c:l:D:hv", long_options, &longopt_index)) != -1) {
         switch (opt) {
             
             case 'c':
                 options->command = optarg;
                 break;
 
+            case 'l':
+                options->listen = optarg;
+                break;
+
             case 'D': {
                 // Check that the argument is a valid writable file descriptor
                 int fd = -1;
@@ -141,6 +154,14 @@ bool options_parse(Options* options, int argc, char** argv) {
                         log_min_severity(LOG_FATAL);
                         break;
                     }
+
+                } else if (strcmp("trace", opt_name) == 0) {
+                    options->trace = optarg;
+                    break;
+
+                } else if (strcmp("record-keys", opt_name) == 0) {
+                    options->record_keys = optarg;
+                    break;
                 }
 
                 goto error;
@@ -14,6 +14,9 @@ typedef struct {
     bool show_version;
     const char* file;
     const char* command;
+    const char* listen;
+    const char* trace;
+    const char* record_keys;
 } Options;
 
 /**
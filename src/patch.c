@@ -0,0 +1,445 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "patch.h"
+#include "file.h"
+#include "util/log.h"
+#include "util/common.h"
+
+/**
+ * Support for IPS patches.
+ *
+ * An IPS patch is a really simple format:
+ *
+ * +---------+ +----------------------------------------+     +-----+ +--------------+
+ * | "PATCH" | | offset (3) | size (2) | data (size)    | ... | EOF | | truncate (3) |
+ * +---------+ +----------------------------------------+     +-----+ +--------------+
+ *
+ * Each record replaces `size` bytes at `offset` with the given data. A record with a size of 0
+ * is a RLE record, which is followed by the length of the run (2 bytes) and the byte to repeat.
+ * All the numbers are big endian. The truncation length at the end is an optional extension
+ * widely supported by other tools.
+ *
+ * Since 3 bytes can address only 16MiB, we also support the IPS32 extension, which has
+ * "IPS32" as header, "EEOF" as footer, and uses 4 bytes for offsets and truncation length.
+ *
+ * Both the parser and the writer stream the patch in fixed size chunks,
+ * so that patches of any size can be applied or exported with constant memory.
+ */
+
+#define PATCH_BUFFER_SIZE (64 * 1024) /* 64KiB */
+#define PATCH_MAX_RECORD_SIZE 0xFFFF
+#define PATCH_MIN_RLE_SIZE 8
+#define PATCH_MAX_GAP (64 * 1024 * 1024) /* 64MiB */
+
+typedef struct {
+    const char* header;
+    const char* footer;
+    size_t offset_size;
+    size_t max_offset;
+} PatchFormat;
+
+static const PatchFormat ips = { "PATCH", "EOF", 3, 0xFFFFFF };
+static const PatchFormat ips32 = { "IPS32", "EEOF", 4, 0xFFFFFFFF };
+
+typedef struct {
+    int fd;
+    const char* path;
+    size_t pos;
+    size_t len;
+    unsigned char buffer[PATCH_BUFFER_SIZE];
+} PatchStream;
+
+typedef struct {
+    File* file;
+    PatchStream* stream;
+    const PatchFormat* format;
+    const unsigned char* original;
+    size_t original_len;
+    size_t record_offset;
+    size_t record_len;
+    unsigned char record[PATCH_MAX_RECORD_SIZE];
+} PatchExport;
+
+
+static PatchStream* stream_open(const char* path, int flags) {
+
+    PatchStream* stream = malloc(sizeof(PatchStream));
+    if (stream == NULL) {
+        log_fatal("Out of memory.");
+        return NULL;
+    }
+    stream->path = path;
+    stream->pos = 0;
+    stream->len = 0;
+
+    while ((stream->fd = open(path, flags, 0666)) == -1 && errno == EINTR);
+    if (stream->fd < 0) {
+        log_error("Cannot open %s: %s.", path, strerror(errno));
+        free(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+static bool stream_flush(PatchStream* stream) {
+    size_t offset = 0;
+    while (offset < stream->len) {
+        ssize_t written;
+        while ((written = write(stream->fd, stream->buffer + offset, stream->len - offset)) == -1 && errno == EINTR);
+        if (written < 0) {
+            log_error("Cannot write %s: %s.", stream->path, strerror(errno));
+            return false;
+        }
+        offset += written;
+    }
+    stream->len = 0;
+    return true;
+}
+
+static bool stream_close(PatchStream* stream, bool flush) {
+    bool res = !flush || stream_flush(stream);
+    close(stream->fd);
+    free(stream);
+    return res;
+}
+
+/** Reads up to `len` bytes from the stream. Returns the number of bytes read, or -1 on error. */
+static ssize_t stream_read(PatchStream* stream, unsigned char* data, size_t len) {
+    size_t total = 0;
+    while (total < len) {
+
+        // Refill the buffer if we consumed all of it
+        if (stream->pos == stream->len) {
+            ssize_t n;
+            while ((n = read(stream->fd, stream->buffer, PATCH_BUFFER_SIZE)) == -1 && errno == EINTR);
+            if (n < 0) {
+                log_error("Cannot read %s: %s.", stream->path, strerror(errno));
+                return -1;
+            } else if (n == 0) {
+                break;
+            }
+            stream->pos = 0;
+            stream->len = n;
+        }
+
+        size_t chunk = MIN(len - total, stream->len - stream->pos);
+        memcpy(data + total, stream->buffer + stream->pos, chunk);
+        stream->pos += chunk;
+        total += chunk;
+    }
+    return total;
+}
+
+static bool stream_read_exact(PatchStream* stream, unsigned char* data, size_t len) {
+    ssize_t n = stream_read(stream, data, len);
+    if (n >= 0 && (size_t) n != len) {
+        log_error("Malformed patch %s: unexpected end of file.", stream->path);
+    }
+    return n >= 0 && (size_t) n == len;
+}
+
+static bool stream_write(PatchStream* stream, const unsigned char* data, size_t len) {
+    while (len > 0) {
+        if (stream->len == PATCH_BUFFER_SIZE && !stream_flush(stream)) {
+            return false;
+        }
+        size_t chunk = MIN(len, PATCH_BUFFER_SIZE - stream->len);
+        memcpy(stream->buffer + stream->len, data, chunk);
+        stream->len += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return true;
+}
+
+static void encode_number(unsigned char* buf, size_t n, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buf[size - i - 1] = (n >> (i * 8)) & 0xFF;
+    }
+}
+
+static bool stream_write_number(PatchStream* stream, size_t n, size_t size) {
+    unsigned char buf[4];
+    encode_number(buf, n, size);
+    return stream_write(stream, buf, size);
+}
+
+static size_t decode_number(const unsigned char* buf, size_t size) {
+    size_t n = 0;
+    for (size_t i = 0; i < size; i++) {
+        n = (n << 8) | buf[i];
+    }
+    return n;
+}
+
+static bool apply_record(File* file, size_t offset, const unsigned char* data, size_t len) {
+
+    // Records past the end of the file extend it with zeros, up to a limit,
+    // so that a corrupted offset does not make us allocate gigabytes
+    size_t size = hedit_file_size(file);
+    if (offset > size) {
+        if (offset - size > PATCH_MAX_GAP) {
+            log_error("Patch record at offset %zu is too far past the end of the file.", offset);
+            return false;
+        }
+        unsigned char* zeros = calloc(offset - size, 1);
+        if (zeros == NULL) {
+            log_fatal("Out of memory.");
+            return false;
+        }
+        bool ok = hedit_file_insert(file, size, zeros, offset - size);
+        free(zeros);
+        if (!ok) {
+            return false;
+        }
+        size = offset;
+    }
+
+    return hedit_file_delete(file, offset, MIN(len, size - offset))
+        && hedit_file_insert(file, offset, data, len);
+}
+
+static bool apply_stream(File* file, PatchStream* stream, bool* changed) {
+
+    // Detect the format from the header
+    unsigned char header[5];
+    const PatchFormat* format;
+    if (!stream_read_exact(stream, header, 5)) {
+        return false;
+    }
+    if (memcmp(header, ips.header, 5) == 0) {
+        format = &ips;
+    } else if (memcmp(header, ips32.header, 5) == 0) {
+        format = &ips32;
+    } else {
+        log_error("%s is not an IPS patch.", stream->path);
+        return false;
+    }
+
+    unsigned char* data = malloc(PATCH_MAX_RECORD_SIZE);
+    if (data == NULL) {
+        log_fatal("Out of memory.");
+        return false;
+    }
+
+    unsigned char buf[4];
+    while (true) {
+
+        // Either the offset of the next record, or the footer
+        if (!stream_read_exact(stream, buf, format->offset_size)) {
+            goto error;
+        }
+        if (memcmp(buf, format->footer, format->offset_size) == 0) {
+            break;
+        }
+        size_t offset = decode_number(buf, format->offset_size);
+
+        if (!stream_read_exact(stream, buf, 2)) {
+            goto error;
+        }
+        size_t len = decode_number(buf, 2);
+
+        // Zero sized records are RLE records
+        if (len == 0) {
+            if (!stream_read_exact(stream, buf, 3)) {
+                goto error;
+            }
+            len = decode_number(buf, 2);
+            memset(data, buf[2], len);
+        } else if (!stream_read_exact(stream, data, len)) {
+            goto error;
+        }
+
+        *changed = true;
+        if (!apply_record(file, offset, data, len)) {
+            log_error("Cannot apply patch record at offset %zu.", offset);
+            goto error;
+        }
+    }
+
+    // Optional truncation after the footer
+    ssize_t n = stream_read(stream, buf, format->offset_size);
+    if (n < 0) {
+        goto error;
+    } else if ((size_t) n == format->offset_size) {
+        size_t truncate = decode_number(buf, format->offset_size);
+        size_t size = hedit_file_size(file);
+        if (truncate < size) {
+            *changed = true;
+            if (!hedit_file_delete(file, truncate, size - truncate)) {
+                goto error;
+            }
+        }
+    } else if (n != 0) {
+        log_error("Malformed patch %s: invalid truncation length.", stream->path);
+        goto error;
+    }
+
+    free(data);
+    return true;
+
+error:
+    free(data);
+    return false;
+}
+
+bool hedit_patch_apply(File* file, const char* path) {
+
+    PatchStream* stream = stream_open(path, O_RDONLY);
+    if (stream == NULL) {
+        return false;
+    }
+
+    // Isolate the patch in its own revision
+    if (!hedit_file_commit_revision(file)) {
+        stream_close(stream, false);
+        return false;
+    }
+
+    bool changed = false;
+    bool res = apply_stream(file, stream, &changed);
+    stream_close(stream, false);
+
+    hedit_file_commit_revision(file);
+
+    // Roll back a partially applied patch, without leaving it on the redo history
+    if (!res && changed) {
+        hedit_file_rollback(file);
+    }
+
+    if (res) {
+        log_debug("Patch applied: %s.", path);
+    }
+    return res;
+}
+
+static bool export_flush(PatchExport* ex) {
+
+    if (ex->record_len == 0) {
+        return true;
+    }
+
+    PatchStream* stream = ex->stream;
+    size_t len = ex->record_len;
+    ex->record_len = 0;
+
+    if (!stream_write_number(stream, ex->record_offset, ex->format->offset_size)) {
+        return false;
+    }
+
+    // Long runs of the same byte are better encoded as RLE records
+    bool rle = len >= PATCH_MIN_RLE_SIZE;
+    for (size_t i = 1; rle && i < len; i++) {
+        rle = ex->record[i] == ex->record[0];
+    }
+
+    if (rle) {
+        return stream_write_number(stream, 0, 2)
+            && stream_write_number(stream, len, 2)
+            && stream_write(stream, ex->record, 1);
+    } else {
+        return stream_write_number(stream, len, 2)
+            && stream_write(stream, ex->record, len);
+    }
+}
+
+static bool export_byte(PatchExport* ex, size_t offset, unsigned char byte) {
+
+    // Continue the current record if possible
+    if (ex->record_len > 0 && ex->record_offset + ex->record_len == offset && ex->record_len < PATCH_MAX_RECORD_SIZE) {
+        ex->record[ex->record_len++] = byte;
+        return true;
+    }
+
+    if (!export_flush(ex)) {
+        return false;
+    }
+
+    // An offset equal to the footer would be mistaken for the end of the patch,
+    // so start the record one byte earlier.
+    unsigned char footer[4];
+    encode_number(footer, offset, ex->format->offset_size);
+    ex->record_offset = offset;
+    if (memcmp(footer, ex->format->footer, ex->format->offset_size) == 0) {
+        ex->record_offset = offset - 1;
+        hedit_file_read_byte(ex->file, offset - 1, &ex->record[ex->record_len++]);
+    }
+
+    ex->record[ex->record_len++] = byte;
+    return true;
+}
+
+static bool export_visitor(File* file, size_t offset, const unsigned char* data, size_t len, void* user) {
+    PatchExport* ex = user;
+
+    // Pieces still pointing to the original mmapped block at the same offset did not change,
+    // so we can skip them without even looking at their contents
+    if (ex->original != NULL && data == ex->original + offset) {
+        return export_flush(ex);
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        size_t pos = offset + i;
+        if (pos < ex->original_len && data[i] == ex->original[pos]) {
+            if (!export_flush(ex)) {
+                return false;
+            }
+        } else if (!export_byte(ex, pos, data[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool hedit_patch_export(File* file, const char* path) {
+
+    PatchExport* ex = malloc(sizeof(PatchExport));
+    if (ex == NULL) {
+        log_fatal("Out of memory.");
+        return false;
+    }
+    ex->file = file;
+    ex->record_offset = 0;
+    ex->record_len = 0;
+    hedit_file_original(file, &ex->original, &ex->original_len);
+
+    // Plain IPS can address only the first 16MiB
+    size_t size = hedit_file_size(file);
+    ex->format = MAX(size, ex->original_len) > ips.max_offset ? &ips32 : &ips;
+    if (MAX(size, ex->original_len) > ips32.max_offset) {
+        log_error("File too big to be exported as an IPS patch.");
+        free(ex);
+        return false;
+    }
+
+    ex->stream = stream_open(path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (ex->stream == NULL) {
+        free(ex);
+        return false;
+    }
+
+    bool res = stream_write(ex->stream, (const unsigned char*) ex->format->header, 5)
+        && hedit_file_visit(file, 0, size, export_visitor, ex)
+        && export_flush(ex)
+        && stream_write(ex->stream, (const unsigned char*) ex->format->footer, strlen(ex->format->footer));
+
+    // Shrunk files need the truncation extension
+    if (res && size < ex->original_len) {
+        res = stream_write_number(ex->stream, size, ex->format->offset_size);
+    }
+
+    res = stream_close(ex->stream, res) && res;
+    free(ex);
+
+    if (res) {
+        log_debug("Patch exported: %s.", path);
+    }
+    return res;
+}
@@ -0,0 +1,32 @@
+#ifndef __PATCH_H__
+#define __PATCH_H__
+
+#include <stdbool.h>
+
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Applies the IPS (or IPS32) patch at the given path to the file.
+ * All the records are applied as a single revision, so that a single undo reverts the whole patch.
+ * Records past the end of the file extend it with zeros, but not by more than 64MiB at once.
+ * If the patch is malformed, the file is left untouched.
+ */
+bool hedit_patch_apply(File*, const char* path);
+
+/**
+ * Exports the differences between the current contents of the file and the original ones
+ * as an IPS patch. Files larger than 16MiB are exported using the IPS32 extension.
+ */
+bool hedit_patch_export(File*, const char* path);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
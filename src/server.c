@@ -0,0 +1,748 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "core.h"
+#include "file.h"
+#include "util/log.h"
+#include "util/common.h"
+#include "util/list.h"
+#include "util/pubsub.h"
+
+/**
+ * A small server that exposes the files open in the editor over a UNIX socket.
+ *
+ * Local tools can query and modify the file without mmapping and parsing it again:
+ * all the clients share the same piece chain of the editor. The protocol is described in server.h.
+ *
+ * Sockets are non-blocking and are polled from the tickit loop, so that requests are served
+ * between key presses, and no locking is needed to access the editor state.
+ */
+
+#define SERVER_POLL_INTERVAL 20 /* msec */
+#define SERVER_MAX_CLIENTS 16
+#define SERVER_MAX_PAYLOAD (16 * 1024 * 1024) /* 16MiB */
+#define SERVER_HEADER_SIZE 5
+#define SERVER_READ_CHUNK (64 * 1024)
+#define SERVER_MAX_OUTPUT SERVER_MAX_PAYLOAD /* Requests are not served while this much output is queued */
+#define SERVER_SEARCH_BUDGET (4 * 1024 * 1024) /* Bytes scanned per poll by each search */
+
+/** State of a search that is being scanned a slice per poll. */
+typedef struct {
+    unsigned char* pattern;
+    size_t pattern_len;
+    unsigned char* window; // Last `pattern_len - 1` bytes scanned, to find matches crossing chunk boundaries
+    size_t window_len;
+    size_t window_off; // Absolute offset of `window[0]`
+    size_t pos; // Next offset to scan
+    size_t end;
+    bool stale; // The file changed since the search started
+} Search;
+
+typedef struct {
+    unsigned char* data;
+    size_t len;
+    size_t size;
+} ByteBuffer;
+
+typedef struct {
+    int fd;
+    ByteBuffer in;
+    ByteBuffer out;
+    size_t out_pos; // Bytes of `out` already sent
+    Search* search; // Pending search, which holds back the following requests
+    Document* doc; // Document the requests operate on, see `handle_request`
+    bool doc_closed;
+    struct list_head list;
+} Client;
+
+struct Server {
+    HEdit* hedit;
+    char* path;
+    int fd;
+    int poll_timer;
+    size_t nclients;
+    struct list_head clients;
+    Subscription* file_change_subscription;
+    Subscription* file_close_subscription;
+};
+
+
+static bool bb_reserve(ByteBuffer* bb, size_t len) {
+    if (bb->size - bb->len >= len) {
+        return true;
+    }
+    size_t newsize = MAX(bb->size * 2, bb->len + len);
+    unsigned char* data = realloc(bb->data, newsize);
+    if (data == NULL) {
+        log_fatal("Out of memory.");
+        return false;
+    }
+    bb->data = data;
+    bb->size = newsize;
+    return true;
+}
+
+static bool bb_append(ByteBuffer* bb, const void* data, size_t len) {
+    if (!bb_reserve(bb, len)) {
+        return false;
+    }
+    memcpy(bb->data + bb->len, data, len);
+    bb->len += len;
+    return true;
+}
+
+static void bb_consume(ByteBuffer* bb, size_t len) {
+    memmove(bb->data, bb->data + len, bb->len - len);
+    bb->len -= len;
+}
+
+static uint64_t get_le(const unsigned char* buf, size_t size) {
+    uint64_t n = 0;
+    for (size_t i = 0; i < size; i++) {
+        n |= (uint64_t) buf[i] << (i * 8);
+    }
+    return n;
+}
+
+static void put_le(unsigned char* buf, uint64_t n, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (n >> (i * 8)) & 0xFF;
+    }
+}
+
+static bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) >= 0;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Responses
+// ----------------------------------------------------------------------------
+
+
+
+/** Appends the header of a response, and reserves space for its payload. */
+static bool respond_header(Client* c, enum ServerStatus status, size_t len) {
+    unsigned char header[SERVER_HEADER_SIZE];
+    header[0] = status;
+    put_le(header + 1, len, 4);
+    return bb_append(&c->out, header, SERVER_HEADER_SIZE) && bb_reserve(&c->out, len);
+}
+
+static bool respond(Client* c, enum ServerStatus status, const void* data, size_t len) {
+    return respond_header(c, status, len) && bb_append(&c->out, data, len);
+}
+
+static bool respond_error(Client* c, const char* msg) {
+    return respond(c, HEDIT_SERVER_STATUS_ERROR, msg, strlen(msg));
+}
+
+static bool respond_u64(Client* c, uint64_t n) {
+    unsigned char buf[8];
+    put_le(buf, n, 8);
+    return respond(c, HEDIT_SERVER_STATUS_OK, buf, 8);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Request handlers
+// ----------------------------------------------------------------------------
+
+
+
+static bool handle_read(Server* server, Client* c, const unsigned char* payload, size_t len) {
+    File* file = c->doc->file;
+    if (len != 12) {
+        return respond_error(c, "Malformed read request.");
+    }
+    size_t offset = get_le(payload, 8);
+    size_t size = hedit_file_size(file);
+    size_t count = offset >= size ? 0 : MIN((size_t) get_le(payload + 8, 4), size - offset);
+    if (count > SERVER_MAX_PAYLOAD) {
+        return respond_error(c, "Read range too big.");
+    }
+
+    if (!respond_header(c, HEDIT_SERVER_STATUS_OK, count)) {
+        return false;
+    }
+
+    // Copy the data straight from the pieces to the output buffer
+    FileIterator* it = hedit_file_iter(file, offset, count);
+    if (it == NULL) {
+        return false;
+    }
+    bool res = true;
+    const unsigned char* chunk;
+    size_t chunk_len;
+    while (res && hedit_file_iter_next(it, &chunk, &chunk_len)) {
+        res = bb_append(&c->out, chunk, chunk_len);
+    }
+    hedit_file_iter_free(it);
+
+    return res;
+}
+
+static void search_free(Search* search) {
+    free(search->pattern);
+    free(search->window);
+    free(search);
+}
+
+static bool handle_search(Server* server, Client* c, const unsigned char* payload, size_t len) {
+    File* file = c->doc->file;
+    if (len <= 16) {
+        return respond_error(c, "Malformed search request.");
+    }
+    size_t start = get_le(payload, 8);
+    size_t count = get_le(payload + 8, 8);
+    size_t size = hedit_file_size(file);
+    if (count == 0 || count > SIZE_MAX - start) {
+        count = SIZE_MAX - start;
+    }
+
+    // The search is scanned a slice per poll by `search_step`, so that large files do not block the editor
+    Search* search = calloc(1, sizeof(Search));
+    if (search == NULL) {
+        log_fatal("Out of memory.");
+        return false;
+    }
+    search->pattern_len = len - 16;
+    search->pattern = malloc(search->pattern_len);
+    search->window = malloc(2 * search->pattern_len);
+    if (search->pattern == NULL || search->window == NULL) {
+        log_fatal("Out of memory.");
+        search_free(search);
+        return false;
+    }
+    memcpy(search->pattern, payload + 16, search->pattern_len);
+    search->window_off = start;
+    search->pos = start;
+    search->end = MIN(start + count, size);
+
+    c->search = search;
+    return true;
+}
+
+/**
+ * Scans the next slice of the pending search of a client, and responds once it is over.
+ * Returns `false` if the client must be dropped.
+ */
+static bool search_step(Server* server, Client* c) {
+    Search* search = c->search;
+    const unsigned char* pattern = search->pattern;
+    size_t pattern_len = search->pattern_len;
+    unsigned char* window = search->window;
+    if (c->doc == NULL) {
+        search->stale = true;
+    }
+
+    bool found = false;
+    size_t found_off = 0;
+    size_t slice = MIN(SERVER_SEARCH_BUDGET, search->end - MIN(search->pos, search->end));
+    FileIterator* it = search->stale || slice == 0 ? NULL : hedit_file_iter(c->doc->file, search->pos, slice);
+    const unsigned char* chunk;
+    size_t chunk_len;
+    while (!found && it != NULL && hedit_file_iter_next(it, &chunk, &chunk_len)) {
+        size_t chunk_off = search->window_off + search->window_len;
+
+        // Matches that begin in the window and end in the current chunk
+        size_t head = MIN(chunk_len, pattern_len - 1);
+        memcpy(window + search->window_len, chunk, head);
+        for (size_t i = 0; i < search->window_len && i + pattern_len <= search->window_len + head; i++) {
+            if (memcmp(window + i, pattern, pattern_len) == 0) {
+                found = true;
+                found_off = search->window_off + i;
+                break;
+            }
+        }
+
+        // Matches entirely contained in the chunk
+        for (const unsigned char* p = chunk; !found && p + pattern_len <= chunk + chunk_len; p++) {
+            p = memchr(p, pattern[0], chunk + chunk_len - p);
+            if (p == NULL || p + pattern_len > chunk + chunk_len) {
+                break;
+            }
+            if (memcmp(p, pattern, pattern_len) == 0) {
+                found = true;
+                found_off = chunk_off + (p - chunk);
+            }
+        }
+
+        // Keep the tail for the next chunk, which might come in the next slice
+        if (chunk_len >= pattern_len - 1) {
+            search->window_len = pattern_len - 1;
+            memcpy(window, chunk + chunk_len - search->window_len, search->window_len);
+        } else {
+            size_t keep = MIN(search->window_len, pattern_len - 1 - chunk_len);
+            memmove(window, window + search->window_len - keep, keep);
+            memcpy(window + keep, chunk, chunk_len);
+            search->window_len = keep + chunk_len;
+        }
+        search->window_off = chunk_off + chunk_len - search->window_len;
+    }
+    if (it != NULL) {
+        hedit_file_iter_free(it);
+        search->pos += slice;
+    }
+
+    // Not done yet, resume on the next poll
+    if (!found && !search->stale && it != NULL && search->pos < search->end) {
+        return true;
+    }
+
+    bool stale = search->stale;
+    search_free(search);
+    c->search = NULL;
+
+    if (found) {
+        return respond_u64(c, found_off);
+    } else if (stale) {
+        return respond_error(c, "File changed during search.");
+    } else {
+        return respond(c, HEDIT_SERVER_STATUS_NOT_FOUND, NULL, 0);
+    }
+}
+
+static bool handle_apply(Server* server, Client* c, const unsigned char* payload, size_t len) {
+    File* file = c->doc->file;
+
+    // Validate the whole batch before touching the file, tracking how the size changes after each edit
+    // so that none of them can fail halfway and leave the batch partially applied
+    size_t size = hedit_file_size(file);
+    size_t pos = 0;
+    while (pos < len) {
+        if (len - pos < 13) {
+            return respond_error(c, "Malformed edit batch.");
+        }
+        enum ServerEdit kind = payload[pos];
+        size_t offset = get_le(payload + pos + 1, 8);
+        size_t edit_len = get_le(payload + pos + 9, 4);
+        pos += 13;
+        if (kind == HEDIT_SERVER_EDIT_INSERT || kind == HEDIT_SERVER_EDIT_REPLACE) {
+            if (len - pos < edit_len) {
+                return respond_error(c, "Malformed edit batch.");
+            }
+            pos += edit_len;
+        } else if (kind != HEDIT_SERVER_EDIT_DELETE) {
+            return respond_error(c, "Unknown edit kind.");
+        }
+
+        if (offset > size || (kind != HEDIT_SERVER_EDIT_INSERT && edit_len > size - offset)) {
+            return respond_error(c, "Edit out of range.");
+        }
+        if (kind == HEDIT_SERVER_EDIT_INSERT) {
+            size += edit_len;
+        } else if (kind == HEDIT_SERVER_EDIT_DELETE) {
+            size -= edit_len;
+        }
+    }
+
+    pos = 0;
+    while (pos < len) {
+        enum ServerEdit kind = payload[pos];
+        size_t offset = get_le(payload + pos + 1, 8);
+        size_t edit_len = get_le(payload + pos + 9, 4);
+        const unsigned char* data = payload + pos + 13;
+        pos += 13;
+
+        bool res;
+        switch (kind) {
+            case HEDIT_SERVER_EDIT_INSERT:
+                res = hedit_file_insert(file, offset, data, edit_len);
+                pos += edit_len;
+                break;
+            case HEDIT_SERVER_EDIT_DELETE:
+                res = hedit_file_delete(file, offset, edit_len);
+                break;
+            case HEDIT_SERVER_EDIT_REPLACE:
+                res = hedit_file_replace(file, offset, data, edit_len);
+                pos += edit_len;
+                break;
+            default:
+                abort();
+        }
+
+        if (!res) {
+            return respond_error(c, "Cannot apply edit.");
+        }
+    }
+
+    hedit_redraw(server->hedit);
+    return respond(c, HEDIT_SERVER_STATUS_OK, NULL, 0);
+}
+
+static bool handle_commit(Server* server, Client* c, const unsigned char* payload, size_t len) {
+    if (!hedit_file_commit_revision(c->doc->file)) {
+        return respond_error(c, "Cannot commit revision.");
+    }
+    return respond(c, HEDIT_SERVER_STATUS_OK, NULL, 0);
+}
+
+static bool handle_save(Server* server, Client* c, const unsigned char* payload, size_t len) {
+    HEdit* hedit = server->hedit;
+
+    // The payload is the optional path, not NUL-terminated
+    char* path = NULL;
+    if (len > 0) {
+        path = strndup((const char*) payload, len);
+        if (path == NULL) {
+            log_fatal("Out of memory.");
+            return false;
+        }
+    }
+
+    const char* name = path != NULL ? path : hedit_file_name(c->doc->file);
+    bool res = name != NULL && hedit_file_save(c->doc->file, name, SAVE_MODE_AUTO);
+    free(path);
+
+    if (!res) {
+        return respond_error(c, "Cannot save file.");
+    }
+
+    HEditFileEvent ev = {
+        .e = {
+            .hedit = hedit,
+            .type = HEDIT_EVENT_TYPE_FILE_WRITE
+        },
+        .file = c->doc->file
+    };
+    pubsub_publish(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_WRITE, &ev);
+    hedit_redraw(hedit);
+
+    return respond(c, HEDIT_SERVER_STATUS_OK, NULL, 0);
+}
+
+static bool handle_request(Server* server, Client* c, enum ServerOp op, const unsigned char* payload, size_t len) {
+
+    // A client works on the document that was active when it sent its first request,
+    // even if the user switches to another buffer afterwards
+    if (c->doc == NULL && !c->doc_closed) {
+        c->doc = hedit_buffer_current(server->hedit);
+    }
+    if (c->doc_closed) {
+        return respond_error(c, "File closed.");
+    } else if (c->doc == NULL) {
+        return respond_error(c, "No file open.");
+    }
+
+    switch (op) {
+        case HEDIT_SERVER_OP_SIZE:   return respond_u64(c, hedit_file_size(c->doc->file));
+        case HEDIT_SERVER_OP_READ:   return handle_read(server, c, payload, len);
+        case HEDIT_SERVER_OP_SEARCH: return handle_search(server, c, payload, len);
+        case HEDIT_SERVER_OP_APPLY:  return handle_apply(server, c, payload, len);
+        case HEDIT_SERVER_OP_COMMIT: return handle_commit(server, c, payload, len);
+        case HEDIT_SERVER_OP_SAVE:   return handle_save(server, c, payload, len);
+        default:                     return respond_error(c, "Unknown opcode.");
+    }
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Connection management
+// ----------------------------------------------------------------------------
+
+
+
+static void client_free(Server* server, Client* c) {
+    close(c->fd);
+    list_del(&c->list);
+    if (c->search != NULL) {
+        search_free(c->search);
+    }
+    free(c->in.data);
+    free(c->out.data);
+    free(c);
+    server->nclients--;
+    log_debug("Server client disconnected.");
+}
+
+static void accept_clients(Server* server) {
+    while (true) {
+        int fd;
+        while ((fd = accept(server->fd, NULL, NULL)) == -1 && errno == EINTR);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_error("Cannot accept connection: %s.", strerror(errno));
+            }
+            return;
+        }
+
+        if (server->nclients >= SERVER_MAX_CLIENTS || !set_nonblocking(fd)) {
+            log_warn("Rejecting server client.");
+            close(fd);
+            continue;
+        }
+
+        Client* c = calloc(1, sizeof(Client));
+        if (c == NULL) {
+            log_fatal("Out of memory.");
+            close(fd);
+            return;
+        }
+        c->fd = fd;
+        list_add_tail(&server->clients, &c->list);
+        server->nclients++;
+        log_debug("Server client connected.");
+    }
+}
+
+/** Whether the client is waiting for its responses to be sent or computed, and should not be served further. */
+static bool client_busy(Client* c) {
+    return c->search != NULL || c->out.len >= SERVER_MAX_OUTPUT;
+}
+
+/** Whether there is room to buffer more requests from the client. */
+static bool client_can_read(Client* c) {
+    return c->in.len < SERVER_HEADER_SIZE + SERVER_MAX_PAYLOAD;
+}
+
+/** Reads the available data from the client, as long as there is room for it. Returns `false` if the client must be dropped. */
+static bool client_read(Client* c) {
+    while (client_can_read(c)) {
+        if (!bb_reserve(&c->in, SERVER_READ_CHUNK)) {
+            return false;
+        }
+        ssize_t n;
+        while ((n = read(c->fd, c->in.data + c->in.len, SERVER_READ_CHUNK)) == -1 && errno == EINTR);
+        if (n == 0) {
+            return false;
+        } else if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            log_error("Cannot read from server client: %s.", strerror(errno));
+            return false;
+        }
+        c->in.len += n;
+    }
+    return true;
+}
+
+/**
+ * Serves the complete requests of the client, in order, until its output is full or a search is pending.
+ * Returns `false` if the client must be dropped.
+ */
+static bool client_serve(Server* server, Client* c) {
+    if (c->search != NULL && !search_step(server, c)) {
+        return false;
+    }
+
+    size_t consumed = 0;
+    while (!client_busy(c) && c->in.len - consumed >= SERVER_HEADER_SIZE) {
+        const unsigned char* header = c->in.data + consumed;
+        size_t len = get_le(header + 1, 4);
+        if (len > SERVER_MAX_PAYLOAD) {
+            log_error("Server request too big, dropping client.");
+            return false;
+        }
+        if (c->in.len - consumed - SERVER_HEADER_SIZE < len) {
+            break;
+        }
+        if (!handle_request(server, c, header[0], header + SERVER_HEADER_SIZE, len)) {
+            return false;
+        }
+        consumed += SERVER_HEADER_SIZE + len;
+
+        // Start scanning right away, small searches are over before the next poll
+        if (c->search != NULL && !search_step(server, c)) {
+            return false;
+        }
+    }
+    bb_consume(&c->in, consumed);
+
+    return true;
+}
+
+static bool client_write(Client* c) {
+    while (c->out_pos < c->out.len) {
+        ssize_t n;
+        while ((n = write(c->fd, c->out.data + c->out_pos, c->out.len - c->out_pos)) == -1 && errno == EINTR);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            log_error("Cannot write to server client: %s.", strerror(errno));
+            return false;
+        }
+        c->out_pos += n;
+    }
+    c->out.len = 0;
+    c->out_pos = 0;
+    return true;
+}
+
+void hedit_server_poll(Server* server) {
+    struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+    Client* clients[SERVER_MAX_CLIENTS + 1];
+    nfds_t nfds = 0;
+
+    fds[nfds].fd = server->fd;
+    fds[nfds].events = POLLIN;
+    clients[nfds++] = NULL;
+    list_for_each_member(c, &server->clients, Client, list) {
+        fds[nfds].fd = c->fd;
+        fds[nfds].events = (client_can_read(c) ? POLLIN : 0) | (c->out.len > c->out_pos ? POLLOUT : 0);
+        clients[nfds++] = c;
+    }
+
+    // Never block: the tickit loop is the one waiting
+    int res;
+    while ((res = poll(fds, nfds, 0)) == -1 && errno == EINTR);
+    if (res < 0) {
+        log_error("Cannot poll server clients: %s.", strerror(errno));
+        return;
+    }
+
+    // Clients are served on every poll, not only when they send something:
+    // pending searches and requests held back by a full output must make progress too
+    for (nfds_t i = 1; i < nfds; i++) {
+        Client* c = clients[i];
+        bool keep = true;
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+            keep = client_read(c);
+        }
+        if (keep) {
+            keep = client_serve(server, c);
+        }
+        if (keep) {
+            keep = client_write(c);
+        }
+        if (!keep) {
+            client_free(server, c);
+        }
+    }
+    if (fds[0].revents & POLLIN) {
+        accept_clients(server);
+    }
+}
+
+static int server_poll(Tickit* t, TickitEventFlags flags, void* user) {
+    Server* server = user;
+    hedit_server_poll(server);
+    server->poll_timer = tickit_timer_after_msec(t, SERVER_POLL_INTERVAL, 0, server_poll, server);
+    return 1;
+}
+
+/** Invalidates the pending searches when the file changes under them. */
+static void on_file_change(PubSub* pubsub, const char* topic, void* data, void* user) {
+    Server* server = user;
+    HEditFileChangeEvent* ev = data;
+    list_for_each_member(c, &server->clients, Client, list) {
+        if (c->search != NULL && c->doc != NULL && c->doc->file == ev->file) {
+            c->search->stale = true;
+        }
+    }
+}
+
+/** Detaches the clients from a document that is being closed, so that their next requests fail. */
+static void on_file_close(PubSub* pubsub, const char* topic, void* data, void* user) {
+    Server* server = user;
+    HEditFileEvent* ev = data;
+    list_for_each_member(c, &server->clients, Client, list) {
+        if (c->doc != NULL && c->doc->file == ev->file) {
+            c->doc = NULL;
+            c->doc_closed = true;
+        }
+    }
+}
+
+Server* hedit_server_start(HEdit* hedit, const char* path) {
+
+    struct sockaddr_un addr = { 0 };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_error("Socket path too long: %s.", path);
+        return NULL;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    Server* server = calloc(1, sizeof(Server));
+    if (server == NULL) {
+        log_fatal("Out of memory.");
+        return NULL;
+    }
+    server->hedit = hedit;
+    server->fd = -1;
+    list_init(&server->clients);
+
+    if ((server->path = strdup(path)) == NULL) {
+        log_fatal("Out of memory.");
+        goto error;
+    }
+
+    if ((server->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        log_error("Cannot create socket: %s.", strerror(errno));
+        goto error;
+    }
+    if (!set_nonblocking(server->fd)) {
+        log_error("Cannot make socket non-blocking: %s.", strerror(errno));
+        goto error;
+    }
+    if (bind(server->fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        log_error("Cannot bind to %s: %s.", path, strerror(errno));
+        goto error;
+    }
+    if (listen(server->fd, SERVER_MAX_CLIENTS) < 0) {
+        log_error("Cannot listen on %s: %s.", path, strerror(errno));
+        unlink(path);
+        goto error;
+    }
+
+    server->file_change_subscription = pubsub_register(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_CHANGE, on_file_change, server);
+    server->file_close_subscription = pubsub_register(pubsub_default(), HEDIT_EVENT_TOPIC_FILE_CLOSE, on_file_close, server);
+    if (server->file_change_subscription == NULL || server->file_close_subscription == NULL) {
+        log_fatal("Cannot subscribe to file events.");
+        unlink(path);
+        goto error;
+    }
+
+    server->poll_timer = tickit_timer_after_msec(hedit->tickit, SERVER_POLL_INTERVAL, 0, server_poll, server);
+
+    log_info("Listening on %s.", path);
+    return server;
+
+error:
+    if (server->file_change_subscription != NULL) {
+        pubsub_unregister(server->file_change_subscription);
+    }
+    if (server->file_close_subscription != NULL) {
+        pubsub_unregister(server->file_close_subscription);
+    }
+    if (server->fd != -1) {
+        close(server->fd);
+    }
+    free(server->path);
+    free(server);
+    return NULL;
+}
+
+void hedit_server_stop(Server* server) {
+    if (server == NULL) {
+        return;
+    }
+
+    tickit_timer_cancel(server->hedit->tickit, server->poll_timer);
+    pubsub_unregister(server->file_change_subscription);
+    pubsub_unregister(server->file_close_subscription);
+
+    list_for_each_rev_member(c, &server->clients, Client, list) {
+        client_free(server, c);
+    }
+
+    close(server->fd);
+    unlink(server->path);
+    free(server->path);
+    free(server);
+}
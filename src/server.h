@@ -0,0 +1,68 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <stdbool.h>
+
+#include "core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Opcodes of the requests understood by the server.
+ *
+ * Every request is made of a 5 bytes header (opcode + little endian 32 bit payload length)
+ * followed by the payload. Every response is made of a 5 bytes header (status + little endian
+ * 32 bit payload length) followed by the payload. All the integers are little endian.
+ * Requests are served in order, and the ones following a long search wait for it to be over.
+ */
+enum ServerOp {
+    HEDIT_SERVER_OP_SIZE = 1,   // -> u64 size
+    HEDIT_SERVER_OP_READ,       // u64 offset, u32 len -> data
+    HEDIT_SERVER_OP_SEARCH,     // u64 start, u64 len (0 = until EOF), pattern -> u64 offset (fails if the file changes meanwhile)
+    HEDIT_SERVER_OP_APPLY,      // batch of { u8 ServerEdit, u64 offset, u32 len, data (not for deletions) } -> empty
+    HEDIT_SERVER_OP_COMMIT,     // -> empty
+    HEDIT_SERVER_OP_SAVE        // optional path -> empty
+};
+
+/** Kinds of edits in a `HEDIT_SERVER_OP_APPLY` batch. */
+enum ServerEdit {
+    HEDIT_SERVER_EDIT_INSERT = 1,
+    HEDIT_SERVER_EDIT_DELETE,
+    HEDIT_SERVER_EDIT_REPLACE
+};
+
+enum ServerStatus {
+    HEDIT_SERVER_STATUS_OK = 0,
+    HEDIT_SERVER_STATUS_ERROR,      // Payload contains an error message
+    HEDIT_SERVER_STATUS_NOT_FOUND
+};
+
+/** Opaque structure representing a running server. */
+typedef struct Server Server;
+
+/**
+ * Starts listening on a UNIX socket at the given path.
+ * Clients are served from the main loop, so they share the same open files of the editor.
+ * Each client works on the buffer that is active when it sends its first request, even after switching
+ * to another buffer: once that buffer is closed, all its requests fail.
+ */
+Server* hedit_server_start(HEdit* hedit, const char* path);
+
+/**
+ * Accepts new clients and serves the pending requests, without blocking.
+ * The server calls it periodically from the tickit loop, so it is only needed to drive a server without running the loop.
+ */
+void hedit_server_poll(Server*);
+
+/** Disconnects all the clients, stops the server and removes the socket. */
+void hedit_server_stop(Server*);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -76,7 +76,7 @@ static int on_expose(TickitWindow* win, TickitEventFlags flags, void* info, void
         // Open file info on the right
         if (statusbar->hedit->file != NULL) {
             File* f = statusbar->hedit->file;
-            char* format_name = ((Option*) map_get(statusbar->hedit->options, "format"))->value.str;
+            char* format_name = hedit_option_get(statusbar->hedit, "format")->value.str;
             bool format_is_none = strcmp("none", format_name) == 0;
     
             const char* fname = hedit_file_name(f);
@@ -196,17 +196,11 @@ static void on_pubsub(PubSub* pubsub, const char* topic, void* data, void* user)
 
 }
 
-static void on_log_message(void* user, struct log_config* config, const char* file, int line, log_severity severity, const char* format, va_list args) {
-
-    // We want to show messages of severity error and fatal on the statusbar
-    if (severity < LOG_ERROR) {
-        return;
-    }
-
+static void on_log_message(void* user, const struct log_message* message) {
     Statusbar* statusbar = user;
 
-    // Print the message to the internal buffer
-    vsnprintf(statusbar->last_message, MAX_MESSAGE_LEN, format, args);
+    // Copy the message to the internal buffer
+    strncpy(statusbar->last_message, message->text, MAX_MESSAGE_LEN);
     statusbar->last_message[MAX_MESSAGE_LEN - 1] = '\0';
     statusbar->last_message_is_error = true;
     statusbar->last_message_is_sticky = false;
@@ -251,7 +245,9 @@ Statusbar* hedit_statusbar_init(HEdit* hedit) {
         on_pubsub,
         statusbar
     );
-    statusbar->log_sink_registration = log_register_sink(on_log_message, statusbar);
+
+    // We want to show messages of severity error and fatal on the statusbar
+    statusbar->log_sink_registration = log_register_sink(on_log_message, LOG_ERROR, statusbar);
 
     return statusbar;
 }
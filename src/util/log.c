@@ -2,9 +2,14 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include "util/log.h"
 #include "util/list.h"
@@ -13,6 +18,11 @@
 #define BOLD "\x1b[1m"
 #define GRAY "\x1b[90m"
 
+// Messages for the destination wait in a ring, so that the caller never blocks on the I/O.
+// The copy in the ring is truncated to MAX_MESSAGE_LEN, the sinks always get the full text.
+#define RING_SIZE 1024
+#define MAX_MESSAGE_LEN 480
+
 static const char* severity_names[] = {
     "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
 };
@@ -30,6 +40,7 @@ static const char* severity_text_colors[] = {
 // Log sinks are stored as a doubly-linked list
 struct log_sink_node {
     log_sink sink;
+    log_severity min_severity;
     void* user;
     struct list_head list;
 };
@@ -43,20 +54,66 @@ static struct log_config config = {
     .destination = NULL
 };
 
+// Lowest severity wanted by the destination or any of the sinks, see `update_min_severity`
+log_severity __hedit_log_min_severity = LOG_DEBUG;
+
+// A slot of the ring is free for the producer that reserves position `pos` when its `seq` is `pos`,
+// and ready for the writer when its `seq` is `pos + 1` (bounded MPMC queue by D. Vyukov)
+typedef struct {
+    size_t seq;
+    log_severity severity;
+    const char* file;
+    int line;
+    time_t time;
+    char text[MAX_MESSAGE_LEN];
+} RingSlot;
+
+static RingSlot ring[RING_SIZE];
+static size_t ring_head = 0;    // Next position to reserve, shared by the producers
+static size_t ring_tail = 0;    // Next position to write, owned by the writer
+static size_t ring_written = 0; // Position up to which the messages have been written and flushed
+static size_t ring_dropped = 0;
+
+static pthread_t writer;
+static sem_t writer_wakeup;
+static bool writer_running = false;
+static bool writer_stopping = false;
+
 
 
-// Forward declaration of the default destination sink
-static void destination_sink(void*, struct log_config* config, const char* file, int line, log_severity severity, const char* format, va_list args);
+static void* writer_main(void*);
+
+// Recomputes the severity below which nobody wants the messages, so that they are not even formatted.
+// Fatal messages are always written, even when quiet.
+static void update_min_severity() {
+    log_severity min = config.quiet ? LOG_FATAL : config.min_severity;
+    list_for_each_member(sink, &sinks, struct log_sink_node, list) {
+        if (sink->min_severity < min) {
+            min = sink->min_severity;
+        }
+    }
+    __hedit_log_min_severity = min;
+}
 
 void log_init() {
     config.destination = stderr;
-    log_register_sink(destination_sink, NULL);
 
-    // If we failed to register the default sink for any reason (out of memory), just abort
-    if (list_empty(&sinks)) {
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        ring[i].seq = i;
+    }
+    ring_head = ring_tail = ring_written = 0;
+    writer_stopping = false;
+
+    // If we failed to start the writer for any reason, just abort
+    if (sem_init(&writer_wakeup, 0, 0) != 0) {
+        fprintf(config.destination, "Cannot initialize logging framework.\n");
+        abort();
+    }
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
         fprintf(config.destination, "Cannot initialize logging framework.\n");
         abort();
     }
+    __atomic_store_n(&writer_running, true, __ATOMIC_RELEASE);
 }
 
 void log_teardown() {
@@ -66,47 +123,79 @@ void log_teardown() {
         log_unregister_sink((void*) sink);
     }
 
+    // Write the pending messages and stop the writer. From now on, the messages are written synchronously.
+    if (__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&writer_running, false, __ATOMIC_RELEASE);
+        __atomic_store_n(&writer_stopping, true, __ATOMIC_RELEASE);
+        sem_post(&writer_wakeup);
+        pthread_join(writer, NULL);
+        sem_destroy(&writer_wakeup);
+    }
+
     // Close log destination
-    fclose(config.destination);
+    if (config.destination != NULL) {
+        fclose(config.destination);
+        config.destination = NULL;
+    }
 
 }
 
+void log_flush() {
+    if (!__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    // The writer flushes the destination every time it empties the ring
+    size_t target = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    while (__atomic_load_n(&ring_written, __ATOMIC_ACQUIRE) < target) {
+        sched_yield();
+    }
+}
+
 void log_quiet(bool q) {
+    log_flush();
     config.quiet = q;
+    update_min_severity();
 }
 
 void log_colored(bool c) {
+    log_flush();
     config.colored = c;
 }
 
 void log_min_severity(log_severity severity) {
     assert(severity >= LOG_DEBUG && severity <= LOG_FATAL);
+    log_flush();
     config.min_severity = severity;
+    update_min_severity();
 }
 
 void log_destination(FILE* destination) {
+    log_flush();
     config.destination = destination;
 }
 
-void* log_register_sink(log_sink sink, void* user) {
+void* log_register_sink(log_sink sink, log_severity min_severity, void* user) {
 
     if (sink == NULL) {
-        log_error(NULL, "Cannot register NULL log sink.");
+        log_error("Cannot register NULL log sink.");
         return NULL;
     }
 
     // Create a new sink node
     struct log_sink_node* node = malloc(sizeof(struct log_sink_node));
     if (node == NULL) {
-        log_error(NULL, "Cannot register new log sink: out of memory.");
+        log_error("Cannot register new log sink: out of memory.");
         return NULL;
     }
     node->sink = sink;
+    node->min_severity = min_severity;
     node->user = user;
     list_init(&node->list);
 
     // Append the sink at the end of the list
     list_add_tail(&sinks, &node->list);
+    update_min_severity();
 
     return (void*) node;
 
@@ -118,82 +207,205 @@ void log_unregister_sink(void* token) {
     struct log_sink_node* node = token;
 
     if (node == NULL) {
-        log_error(NULL, "Cannot unregister NULL log sink.");
+        log_error("Cannot unregister NULL log sink.");
         return;
     }
 
     // Remove the node from the list
     list_del(&node->list);
     free(node);
+    update_min_severity();
 
 }
 
-void __hedit_log(const char* file, int line, log_severity severity, const char* format, ...) {
+static void write_message(const struct log_message* message, const char* formatted_time) {
 
-    // Assert the validity of the severity
-    assert(severity >= LOG_DEBUG && severity <= LOG_FATAL);
+    bool colored = config.colored;
+    FILE* destination = config.destination;
+    log_severity severity = message->severity;
 
-    // Iterate all the sinks and pass all the parameters
-    list_for_each_member(sink, &sinks, struct log_sink_node, list) {
-        va_list args;
-        va_start(args, format);
-        sink->sink(sink->user, &config, file, line, severity, format, args);
-        va_end(args);
+    // As an exception to the rules, if we receive a fatal message, the program is likely to terminate
+    // due to an unrecoverable error, so, even if logging is disabled, print the message to stderr.
+    if (config.quiet && severity >= LOG_FATAL) {
+        colored = isatty(STDERR_FILENO);
+        destination = stderr;
     }
 
-}
-
-static void destination_sink(void* unused, struct log_config* config, const char* file, int line, log_severity severity, const char* format, va_list args) {
-
-    // Exit if the destination is null
-    if (config->destination == NULL) {
+    // Exit immediately if we have to stay quiet, the message is ignored by the minimum severity or there is nowhere to write
+    else if (config.quiet || severity < config.min_severity || destination == NULL) {
         return;
     }
 
-    bool colored = config->colored;
-    FILE* destination = config->destination;
+    // Output time and severity to destination
+    if (colored) {
+        fprintf(destination, "%s %s" BOLD "%-5s" RESET " " GRAY "%s:%d:" RESET "%s %s" RESET "\n",
+                formatted_time, severity_colors[severity], severity_names[severity], message->file, message->line,
+                severity_text_colors[severity], message->text);
 
-    // As an exception to the rules, if we receive a fatal message, the program is likely to terminate
-    // due to an unrecoverable error, so, even if logging is disabled, print the message to stderr.
-    if (config->quiet && severity >= LOG_FATAL) {
-        colored = isatty(STDERR_FILENO);
-        destination = stderr;
+    } else {
+        fprintf(destination, "%s %-5s %s:%d: %s\n",
+                formatted_time, severity_names[severity], message->file, message->line, message->text);
     }
 
-    // Exit immediately if we have to stay quiet or the event is ignored by the minimum severity
-    else if (config->quiet || severity < config->min_severity) {
-        return;
+}
+
+static void format_time(time_t t, char formatted_time[32]) {
+    struct tm tm_info;
+    if (localtime_r(&t, &tm_info) == NULL || strftime(formatted_time, 32, "%Y-%m-%d %H:%M:%S", &tm_info) == 0) {
+        // Error formatting the time: do not output the time
+        formatted_time[0] = '\0';
     }
+}
 
-    // Format current time
-    time_t t;
-    struct tm* tm_info;
+static void* writer_main(void* unused) {
+    time_t last_time = (time_t) -1;
     char formatted_time[32];
-    time(&t);
-    tm_info = localtime(&t);
-    if (strftime(formatted_time, 32, "%Y-%m-%d %H:%M:%S", tm_info) == 0) {
-        // Error formatting the time: do not output the time
-        formatted_time[0] = '\0'; 
+
+    bool stopping = false;
+    while (!stopping) {
+        sem_wait(&writer_wakeup);
+        stopping = __atomic_load_n(&writer_stopping, __ATOMIC_ACQUIRE);
+
+        // Write everything that is ready, then flush once. The configuration is only read
+        // for a message, which is published after any change the producer made to it.
+        bool wrote = false;
+        for (;;) {
+            RingSlot* slot = &ring[ring_tail % RING_SIZE];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring_tail + 1) {
+                break;
+            }
+            struct log_message message = {
+                .severity = slot->severity,
+                .file = slot->file,
+                .line = slot->line,
+                .time = slot->time,
+                .text = slot->text
+            };
+
+            // The messages come in bursts, so most of them share the formatted time
+            if (message.time != last_time) {
+                format_time(message.time, formatted_time);
+                last_time = message.time;
+            }
+            write_message(&message, formatted_time);
+            __atomic_store_n(&slot->seq, ring_tail + RING_SIZE, __ATOMIC_RELEASE);
+            ring_tail++;
+            wrote = true;
+        }
+
+        if (wrote) {
+            size_t dropped = __atomic_exchange_n(&ring_dropped, 0, __ATOMIC_RELAXED);
+            if (dropped > 0 && config.destination != NULL && !config.quiet) {
+                fprintf(config.destination, "%zu log messages dropped: the writer could not keep up.\n", dropped);
+            }
+            if (config.destination != NULL) {
+                fflush(config.destination);
+            }
+            fflush(stderr);
+        }
+        __atomic_store_n(&ring_written, ring_tail, __ATOMIC_RELEASE);
     }
+    return NULL;
+}
 
-    // Output time and severity to destination
-    if (colored) {
-        fprintf(destination, "%s %s" BOLD "%-5s" RESET " " GRAY "%s:%d:" RESET "%s ",
-                formatted_time, severity_colors[severity], severity_names[severity], file, line, severity_text_colors[severity]);
+// Returns false if the ring is full
+static bool ring_push(const struct log_message* message) {
+    size_t pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    RingSlot* slot;
+    for (;;) {
+        slot = &ring[pos % RING_SIZE];
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
 
-    } else {
-        fprintf(destination, "%s %-5s %s:%d: ", formatted_time, severity_names[severity], file, line);
+    slot->severity = message->severity;
+    slot->file = message->file;
+    slot->line = message->line;
+    slot->time = message->time;
+    size_t len = strlen(message->text);
+    if (len >= MAX_MESSAGE_LEN) {
+        len = MAX_MESSAGE_LEN - 1;
     }
+    memcpy(slot->text, message->text, len);
+    slot->text[len] = '\0';
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    sem_post(&writer_wakeup);
+    return true;
+}
+
+void __hedit_log(const char* file, int line, log_severity severity, const char* format, ...) {
 
-    // Now write the actual message
-    vfprintf(destination, format, args);
+    // Assert the validity of the severity
+    assert(severity >= LOG_DEBUG && severity <= LOG_FATAL);
 
-    // Restore the normal colors if we wrote the whole message colored
-    if (colored) {
-        fprintf(destination, RESET);
+    // Format the message once for everybody. Most messages fit on the stack, the longer ones
+    // are formatted again on the heap. If that fails, they are passed on truncated.
+    char stack_text[MAX_MESSAGE_LEN];
+    char* text = stack_text;
+    va_list args;
+    va_start(args, format);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int len = vsnprintf(stack_text, MAX_MESSAGE_LEN, format, args);
+    if (len >= MAX_MESSAGE_LEN) {
+        char* heap_text = malloc((size_t) len + 1);
+        if (heap_text != NULL) {
+            vsnprintf(heap_text, (size_t) len + 1, format, args_copy);
+            text = heap_text;
+        }
+    }
+    va_end(args_copy);
+    va_end(args);
+
+    struct log_message message = {
+        .severity = severity,
+        .file = file,
+        .line = line,
+        .time = time(NULL),
+        .text = text
+    };
+
+    // Iterate all the sinks and pass the message
+    list_for_each_member(sink, &sinks, struct log_sink_node, list) {
+        if (severity >= sink->min_severity) {
+            sink->sink(sink->user, &message);
+        }
+    }
+
+    // Hand the message to the writer. Without it, write it here.
+    if (!__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE)) {
+        char formatted_time[32];
+        format_time(message.time, formatted_time);
+        write_message(&message, formatted_time);
+        if (config.destination != NULL) {
+            fflush(config.destination);
+        }
+        goto done;
     }
 
-    fprintf(destination, "\n");
-    fflush(destination);
+    // A fatal message is likely the last one before the program terminates,
+    // so wait until it is on the destination instead of dropping it
+    if (severity >= LOG_FATAL) {
+        while (!ring_push(&message)) {
+            sched_yield();
+        }
+        log_flush();
+    } else if (!ring_push(&message)) {
+        __atomic_fetch_add(&ring_dropped, 1, __ATOMIC_RELAXED);
+    }
+
+done:
+    if (text != stack_text) {
+        free(text);
+    }
 
-}
\ No newline at end of file
+}
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,23 +20,52 @@ struct log_config {
     FILE* destination;
 };
 
-typedef void (*log_sink)(void* user, struct log_config* config, const char* file, int line, log_severity severity, const char* format, va_list args);
+/** A log message, formatted once and passed as it is to all the sinks. */
+struct log_message {
+    log_severity severity;
+    const char* file;
+    int line;
+    time_t time;
+    const char* text;
+};
+
+typedef void (*log_sink)(void* user, const struct log_message* message);
+
+// Messages below this severity are discarded before their arguments are even formatted.
+// It is the lowest of the minimum severities of the destination and of all the sinks.
+extern log_severity __hedit_log_min_severity;
 
-#define log_debug(...) __hedit_log(__FILE__, __LINE__, LOG_DEBUG, __VA_ARGS__)
-#define log_info(...)  __hedit_log(__FILE__, __LINE__, LOG_INFO,  __VA_ARGS__)
-#define log_warn(...)  __hedit_log(__FILE__, __LINE__, LOG_WARN,  __VA_ARGS__)
-#define log_error(...) __hedit_log(__FILE__, __LINE__, LOG_ERROR, __VA_ARGS__)
-#define log_fatal(...) __hedit_log(__FILE__, __LINE__, LOG_FATAL, __VA_ARGS__)
+#define __hedit_log_at(severity, ...) \
+    ((severity) >= __hedit_log_min_severity ? __hedit_log(__FILE__, __LINE__, (severity), __VA_ARGS__) : (void) 0)
 
+#define log_debug(...) __hedit_log_at(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...)  __hedit_log_at(LOG_INFO,  __VA_ARGS__)
+#define log_warn(...)  __hedit_log_at(LOG_WARN,  __VA_ARGS__)
+#define log_error(...) __hedit_log_at(LOG_ERROR, __VA_ARGS__)
+#define log_fatal(...) __hedit_log_at(LOG_FATAL, __VA_ARGS__)
+
+/**
+ *    Starts the thread that writes the messages to the destination.
+ *    Until then, and after `log_teardown`, the messages are written synchronously.
+ */
 void log_init();
 void log_teardown();
 
+/** Waits until all the messages logged so far have been written to the destination. */
+void log_flush();
+
 void log_quiet(bool quiet);
 void log_colored(bool colored);
 void log_min_severity(log_severity severity);
 void log_destination(FILE* destination);
 
-void* log_register_sink(log_sink sink, void* user);
+/**
+ *    Registers a sink that receives all the messages of at least `min_severity`,
+ *    independently of the minimum severity and the quietness of the destination.
+ *
+ *    @return An opaque token to unregister the sink, or NULL on error.
+ */
+void* log_register_sink(log_sink sink, log_severity min_severity, void* user);
 void log_unregister_sink(void* token);
 
 void __hedit_log(const char* file, int line, log_severity severity, const char* format, ...);
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "util/metrics.h"
+#include "util/map.h"
+
+// All the metrics by name
+static Map* metrics;
+
+
+static bool free_metric(const char* key, void* value, void* data) {
+    Metric* m = value;
+    free(m->name);
+    free(m);
+    return true;
+}
+
+static void on_program_exit() {
+    map_iterate(metrics, free_metric, NULL);
+    map_free(metrics);
+}
+
+static Metric* get_metric(const char* name, enum MetricType type) {
+    if (metrics == NULL) {
+        metrics = map_new();
+        if (metrics == NULL) {
+            return NULL;
+        }
+        atexit(on_program_exit);
+    }
+
+    Metric* m = map_get(metrics, name);
+    if (m != NULL) {
+        return m->type == type ? m : NULL;
+    }
+
+    m = calloc(1, sizeof(Metric));
+    if (m == NULL) {
+        return NULL;
+    }
+    m->type = type;
+    m->name = strdup(name);
+    if (m->name == NULL || !map_put(metrics, name, m)) {
+        free(m->name);
+        free(m);
+        return NULL;
+    }
+    return m;
+}
+
+Metric* metrics_counter(const char* name) {
+    return get_metric(name, METRIC_COUNTER);
+}
+
+Metric* metrics_histogram(const char* name) {
+    return get_metric(name, METRIC_HISTOGRAM);
+}
+
+void metrics_add(Metric* m, int64_t delta) {
+    if (m != NULL) {
+        m->value += delta;
+    }
+}
+
+void metrics_observe(Metric* m, uint64_t usec) {
+    if (m == NULL) {
+        return;
+    }
+
+    size_t bucket = 0;
+    while (bucket < METRICS_BUCKETS - 1 && usec >= ((uint64_t) 1 << bucket)) {
+        bucket++;
+    }
+
+    m->count++;
+    m->sum += usec;
+    if (usec > m->max) {
+        m->max = usec;
+    }
+    m->buckets[bucket]++;
+}
+
+uint64_t metrics_quantile(Metric* m, double q) {
+    if (m == NULL || m->count == 0) {
+        return 0;
+    }
+
+    // Find the bucket containing the quantile and report its upper bound,
+    // which is never more than the maximum actually recorded
+    uint64_t rank = (uint64_t) (q * m->count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < METRICS_BUCKETS; i++) {
+        seen += m->buckets[i];
+        if (seen > rank) {
+            uint64_t bound = ((uint64_t) 1 << i) - 1;
+            return bound < m->max ? bound : m->max;
+        }
+    }
+    return m->max;
+}
+
+uint64_t metrics_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct IterateParams {
+    bool (*cb)(Metric*, void*);
+    void* user;
+};
+
+static bool iterate_visitor(const char* key, void* value, void* data) {
+    struct IterateParams* params = data;
+    return params->cb(value, params->user);
+}
+
+void metrics_iterate(bool (*cb)(Metric*, void* user), void* user) {
+    if (metrics == NULL) {
+        return;
+    }
+
+    struct IterateParams params = {
+        .cb = cb,
+        .user = user
+    };
+    map_iterate(metrics, iterate_visitor, &params);
+}
@@ -0,0 +1,73 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * Process-wide performance metrics.
+ *
+ * Each metric is identified by a dotted name (like `file.pieces`) and is either a counter,
+ * which can go both up and down, or a histogram of durations in microseconds.
+ * Looking up a metric by name costs a map lookup, so the hot paths should look it up once
+ * and keep the returned handle: updating a metric is then just an addition.
+ *
+ * All the functions accept a NULL metric and do nothing, so that a failed allocation
+ * of a metric never gets in the way of the code being measured.
+ */
+
+/** Number of buckets of a histogram: the i-th one counts the durations shorter than 2^i microseconds. */
+#define METRICS_BUCKETS 40
+
+enum MetricType {
+    METRIC_COUNTER = 1,
+    METRIC_HISTOGRAM
+};
+
+typedef struct {
+    char* name;
+    enum MetricType type;
+
+    // Counters
+    int64_t value;
+
+    // Histograms
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[METRICS_BUCKETS];
+} Metric;
+
+/** Returns the counter with the given name, creating it if it does not exist. */
+Metric* metrics_counter(const char* name);
+
+/** Returns the histogram with the given name, creating it if it does not exist. */
+Metric* metrics_histogram(const char* name);
+
+/** Adds `delta` to a counter. */
+void metrics_add(Metric*, int64_t delta);
+
+/** Records a duration in microseconds in a histogram. */
+void metrics_observe(Metric*, uint64_t usec);
+
+/** Returns an estimate of the `q`-th quantile (between 0 and 1) of the durations recorded in a histogram. */
+uint64_t metrics_quantile(Metric*, double q);
+
+/** Returns the time in microseconds from an arbitrary point in the past, to measure durations. */
+uint64_t metrics_now();
+
+/** Calls `cb` for each metric, in name order. The iteration stops if `cb` returns false. */
+void metrics_iterate(bool (*cb)(Metric*, void* user), void* user);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util/nametree.h"
+
+typedef struct {
+    int parent;
+    char* name;
+} Node;
+
+struct NameTree {
+    Node* nodes;
+    size_t len;
+    size_t capacity;
+    size_t names_memory;
+};
+
+#define DEFAULT_CAPACITY 64
+
+
+NameTree* nametree_new() {
+
+    NameTree* tree = calloc(1, sizeof(NameTree));
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    // Add the root node
+    if (nametree_add(tree, -1, "") != 0) {
+        free(tree);
+        return NULL;
+    }
+
+    return tree;
+
+}
+
+void nametree_free(NameTree* tree) {
+    if (tree == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < tree->len; i++) {
+        free(tree->nodes[i].name);
+    }
+    free(tree->nodes);
+    free(tree);
+}
+
+size_t nametree_len(NameTree* tree) {
+    return tree->len;
+}
+
+size_t nametree_get_memory(NameTree* tree) {
+    return sizeof(NameTree) + tree->capacity * sizeof(Node) + tree->names_memory;
+}
+
+int nametree_add(NameTree* tree, int parent, const char* name) {
+    assert(tree->len == 0 || (parent >= 0 && (size_t) parent < tree->len));
+
+    if (tree->len == tree->capacity) {
+        size_t capacity = tree->capacity == 0 ? DEFAULT_CAPACITY : tree->capacity * 2;
+        Node* nodes = realloc(tree->nodes, capacity * sizeof(Node));
+        if (nodes == NULL) {
+            return -1;
+        }
+        tree->nodes = nodes;
+        tree->capacity = capacity;
+    }
+
+    char* copy = strdup(name);
+    if (copy == NULL) {
+        return -1;
+    }
+
+    tree->nodes[tree->len].parent = parent;
+    tree->nodes[tree->len].name = copy;
+    tree->names_memory += strlen(name) + 1;
+    return (int) tree->len++;
+}
+
+// Appends the full name of the node `id` to `buf`, and returns the new length of the string in `buf`.
+// The root node is skipped, so that it does not leave a leading separator.
+static size_t write_path(NameTree* tree, int id, const char* sep, char* buf, size_t off, size_t len) {
+    if (id <= 0) {
+        return off;
+    }
+
+    Node* node = &tree->nodes[id];
+    off = write_path(tree, node->parent, sep, buf, off, len);
+    if (off > 0) {
+        size_t n = strnlen(sep, len - 1 - off);
+        memcpy(buf + off, sep, n);
+        off += n;
+    }
+    size_t n = strnlen(node->name, len - 1 - off);
+    memcpy(buf + off, node->name, n);
+    return off + n;
+}
+
+void nametree_path(NameTree* tree, int id, const char* sep, char* buf, size_t len) {
+    assert(id >= 0 && (size_t) id < tree->len);
+
+    if (len == 0) {
+        return;
+    }
+    buf[write_path(tree, id, sep, buf, 0, len)] = '\0';
+}
@@ -0,0 +1,50 @@
+#ifndef __NAMETREE_H__
+#define __NAMETREE_H__
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Opaque data type for a tree of hierarchical names.
+ *
+ * Each node is identified by an integer id and stores only its own name and the id of its parent:
+ * the full name of a node is made of the names of all its ancestors, and it is built only when needed.
+ * The root node has id 0 and an empty name.
+ */
+typedef struct NameTree NameTree;
+
+/** Creates a new tree with only the root node. */
+NameTree* nametree_new();
+
+/** Releases all the resources held by a tree. */
+void nametree_free(NameTree*);
+
+/** Returns the number of nodes in the tree, root included. */
+size_t nametree_len(NameTree*);
+
+/** Returns the total memory allocated by the tree. */
+size_t nametree_get_memory(NameTree*);
+
+/**
+ * Adds a new node with the given name below `parent`, and returns its id.
+ * Ids are assigned sequentially. Returns -1 if we run out of memory.
+ */
+int nametree_add(NameTree*, int parent, const char* name);
+
+/**
+ * Writes in `buf` the full name of the node `id`, made of the names of all its ancestors separated by `sep`.
+ * The name is truncated to fit in `len` bytes, NULL terminator included.
+ */
+void nametree_path(NameTree*, int id, const char* sep, char* buf, size_t len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,28 +1,60 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 
 #include "util/pubsub.h"
 #include "util/list.h"
 #include "util/map.h"
+#include "util/metrics.h"
 
 
+typedef struct HandlerNode HandlerNode;
+
+// Handler of an interned topic, copied from the HandlerNode of a matching filter
+typedef struct {
+    PubSubHandler handler;
+    void* user;
+    HandlerNode* node;        // Checked before the call, in case an earlier handler unregistered it
+} TopicHandler;
+
+typedef struct {
+    int id;
+    char* name;
+    Metric* publications;
+    TopicHandler* handlers;   // Handlers of all the filters matching this topic, in the order of the filters
+    size_t handlers_len;
+    unsigned long generation; // Value of PubSub.generation when the handlers were collected
+    unsigned publishing;      // Number of publications of this topic in progress, which are calling `handlers`
+} Topic;
+
 struct PubSub {
     Map* topics;                           // Topic filter => list of HandlerNodes
     struct list_head active_subscriptions; // List of active subscriptions
+    Map* interned_topics;                  // Topic name => Topic
+    Topic** interned;                      // Interned topics, by id
+    size_t interned_len;
+    size_t interned_capacity;
+    unsigned long generation;              // Incremented every time the subscriptions change
+    unsigned publishing;                   // Number of publications in progress
+    struct list_head removed;              // HandlerNodes unregistered during a publication, freed after it
 };
 
-typedef struct HandlerNode {
+struct HandlerNode {
     PubSubHandler handler;
     void* user;
+    bool removed;                       // Unregistered, but still in PubSub.topics until the publications end
     struct list_head list;              // Pointers for PubSub.topics
-    struct list_head subscription_list; // Pointers for Subscription.nodes
-} HandlerNode;
+    struct list_head subscription_list; // Pointers for Subscription.nodes, or for PubSub.removed once removed
+};
 
 struct Subscription {
+    PubSub* pubsub;
     struct list_head nodes; // list of the HandlerNodes registered with this subscription
     struct list_head list;  // Pointers for PubSub.active_subscriptions
 };
 
+#define MAX_METRIC_NAME_LEN 128
+
 // Thread-local default pubsub context
 static __thread PubSub* def_pubsub;
 
@@ -34,13 +66,27 @@ PubSub* pubsub_new() {
     }
 
     Map* topics = map_new();
-    if (topics == NULL) {
+    Map* interned_topics = map_new();
+    if (topics == NULL || interned_topics == NULL) {
+        if (topics != NULL) {
+            map_free(topics);
+        }
+        if (interned_topics != NULL) {
+            map_free(interned_topics);
+        }
         free(pubsub);
         return NULL;
     }
 
     pubsub->topics = topics;
     list_init(&pubsub->active_subscriptions);
+    pubsub->interned_topics = interned_topics;
+    pubsub->interned = NULL;
+    pubsub->interned_len = 0;
+    pubsub->interned_capacity = 0;
+    pubsub->generation = 1;
+    pubsub->publishing = 0;
+    list_init(&pubsub->removed);
 
     return pubsub;
 }
@@ -60,6 +106,13 @@ void pubsub_free(PubSub* pubsub) {
         pubsub_unregister(sub);
     }
     map_free_full(pubsub->topics);
+    for (size_t i = 0; i < pubsub->interned_len; i++) {
+        free(pubsub->interned[i]->name);
+        free(pubsub->interned[i]->handlers);
+        free(pubsub->interned[i]);
+    }
+    free(pubsub->interned);
+    map_free(pubsub->interned_topics);
     free(pubsub);
 }
 
@@ -93,8 +146,10 @@ Subscription* pubsub_register(PubSub* pubsub, const char* topic, PubSubHandler h
     if (sub == NULL) {
         return NULL;
     }
+    sub->pubsub = pubsub;
     list_init(&sub->nodes);
     list_add_tail(&pubsub->active_subscriptions, &sub->list);    
+    pubsub->generation++;
 
     // Duplicate the topic string
     char* topicdup = strdup(topic);
@@ -130,6 +185,7 @@ Subscription* pubsub_register(PubSub* pubsub, const char* topic, PubSubHandler h
         }
         node->handler = handler;
         node->user = user;
+        node->removed = false;
         list_add_tail(head, &node->list);
         list_add_tail(&sub->nodes, &node->subscription_list);
 
@@ -153,19 +209,68 @@ error:
 }
 
 void pubsub_unregister(Subscription* sub) {
+    PubSub* pubsub = sub->pubsub;
 
-    // Delete all the HandlerNodes associated with this subscription
+    // Delete all the HandlerNodes associated with this subscription.
+    // During a publication they might be the next ones to call: just mark them, and free them after it.
     list_for_each_member(node, &sub->nodes, HandlerNode, subscription_list) {
-        list_del(&node->list); // Remove the node from the list of the topic handlers
-        free(node);
+        if (pubsub->publishing > 0) {
+            node->removed = true;
+            list_del(&node->subscription_list);
+            list_add_tail(&pubsub->removed, &node->subscription_list);
+        } else {
+            list_del(&node->list); // Remove the node from the list of the topic handlers
+            free(node);
+        }
     }
 
     // Delete the subscription from the list of the active ones
     list_del(&sub->list);
+    pubsub->generation++;
     free(sub);
     
 }
 
+int pubsub_topic_intern(PubSub* pubsub, const char* name) {
+
+    // Return the id if already interned
+    Topic* topic = map_get(pubsub->interned_topics, name);
+    if (topic != NULL) {
+        return topic->id;
+    }
+
+    if (pubsub->interned_len == pubsub->interned_capacity) {
+        size_t capacity = pubsub->interned_capacity == 0 ? 16 : pubsub->interned_capacity * 2;
+        Topic** interned = realloc(pubsub->interned, capacity * sizeof(Topic*));
+        if (interned == NULL) {
+            return -1;
+        }
+        pubsub->interned = interned;
+        pubsub->interned_capacity = capacity;
+    }
+
+    topic = calloc(1, sizeof(Topic));
+    if (topic == NULL) {
+        return -1;
+    }
+    topic->name = strdup(name);
+    if (topic->name == NULL || !map_put(pubsub->interned_topics, topic->name, topic)) {
+        free(topic->name);
+        free(topic);
+        return -1;
+    }
+
+    // Count the publications of each topic
+    char metric_name[MAX_METRIC_NAME_LEN];
+    snprintf(metric_name, MAX_METRIC_NAME_LEN, "pubsub.%s", name);
+    topic->publications = metrics_counter(metric_name);
+
+    // The generation of the subscriptions is never 0, so the handlers are collected on the first publish
+    topic->id = pubsub->interned_len;
+    pubsub->interned[pubsub->interned_len++] = topic;
+    return topic->id;
+}
+
 struct PublishVisitorData {
     PubSub* pubsub;
     const char* topic;
@@ -201,7 +306,9 @@ bool publish_visitor(const char* key, void* value, void* user) {
     if (filter_match(key, data->topic)) {
         struct list_head* head = value;
         list_for_each_member(node, head, HandlerNode, list) {
-            node->handler(data->pubsub, data->topic, data->data, node->user);
+            if (!node->removed) {
+                node->handler(data->pubsub, data->topic, data->data, node->user);
+            }
         }
     }
 
@@ -209,7 +316,65 @@ bool publish_visitor(const char* key, void* value, void* user) {
     
 }
 
-void pubsub_publish(PubSub* pubsub, const char* topic, void* data) {
+struct CollectVisitorData {
+    Topic* topic;
+    TopicHandler* handlers;
+    size_t len;
+    size_t capacity;
+    bool failed;
+};
+
+static bool collect_visitor(const char* key, void* value, void* user) {
+    struct CollectVisitorData* data = user;
+
+    // Copy the handlers if the topic filter matches, in the same order as `publish_visitor` would call them
+    if (filter_match(key, data->topic->name)) {
+        struct list_head* head = value;
+        list_for_each_member(node, head, HandlerNode, list) {
+            if (node->removed) {
+                continue;
+            }
+            if (data->len == data->capacity) {
+                size_t capacity = data->capacity == 0 ? 4 : data->capacity * 2;
+                TopicHandler* handlers = realloc(data->handlers, capacity * sizeof(TopicHandler));
+                if (handlers == NULL) {
+                    data->failed = true;
+                    return false;
+                }
+                data->handlers = handlers;
+                data->capacity = capacity;
+            }
+            data->handlers[data->len++] = (TopicHandler) {
+                .handler = node->handler,
+                .user = node->user,
+                .node = node
+            };
+        }
+    }
+
+    return true;
+}
+
+// Collects the handlers of all the filters matching the topic
+static bool collect_handlers(PubSub* pubsub, Topic* topic) {
+    struct CollectVisitorData collect_visitor_data = {
+        .topic = topic
+    };
+    map_iterate(pubsub->topics, collect_visitor, &collect_visitor_data);
+    if (collect_visitor_data.failed) {
+        free(collect_visitor_data.handlers);
+        return false;
+    }
+
+    free(topic->handlers);
+    topic->handlers = collect_visitor_data.handlers;
+    topic->handlers_len = collect_visitor_data.len;
+    topic->generation = pubsub->generation;
+    return true;
+}
+
+// Calls the handlers looking them up in the filters, as for a topic that is not interned
+static void publish_filters(PubSub* pubsub, const char* topic, void* data) {
     struct PublishVisitorData publish_visitor_data = {
         .pubsub = pubsub,
         .topic = topic,
@@ -217,3 +382,61 @@ void pubsub_publish(PubSub* pubsub, const char* topic, void* data) {
     };
     map_iterate(pubsub->topics, publish_visitor, &publish_visitor_data);
 }
+
+// Frees the HandlerNodes unregistered during the publications, once the last of them is over
+static void publish_end(PubSub* pubsub) {
+    if (--pubsub->publishing > 0) {
+        return;
+    }
+    list_for_each_member(node, &pubsub->removed, HandlerNode, subscription_list) {
+        list_del(&node->list);
+        list_del(&node->subscription_list);
+        free(node);
+    }
+}
+
+void pubsub_publish_interned(PubSub* pubsub, int id, void* data) {
+    if (id < 0 || id >= pubsub->interned_len) {
+        return;
+    }
+    Topic* topic = pubsub->interned[id];
+    metrics_add(topic->publications, 1);
+    pubsub->publishing++;
+
+    // Collect the handlers again if the subscriptions changed since the last time.
+    // If a handler publishes this topic again after changing the subscriptions, the array it is called from
+    // cannot be replaced, so look the handlers up in the filters instead.
+    // The same goes if we run out of memory.
+    if (topic->generation != pubsub->generation && (topic->publishing > 0 || !collect_handlers(pubsub, topic))) {
+        publish_filters(pubsub, topic->name, data);
+        publish_end(pubsub);
+        return;
+    }
+
+    // The handlers subscribed from now on are called from the next publication,
+    // while the ones unregistered meanwhile are not called anymore
+    TopicHandler* handlers = topic->handlers;
+    size_t handlers_len = topic->handlers_len;
+    topic->publishing++;
+    for (size_t i = 0; i < handlers_len; i++) {
+        if (!handlers[i].node->removed) {
+            handlers[i].handler(pubsub, topic->name, data, handlers[i].user);
+        }
+    }
+    topic->publishing--;
+    publish_end(pubsub);
+}
+
+void pubsub_publish(PubSub* pubsub, const char* topic, void* data) {
+
+    // Only the topics interned explicitly have their handlers collected in advance
+    Topic* interned = map_get(pubsub->interned_topics, topic);
+    if (interned != NULL) {
+        pubsub_publish_interned(pubsub, interned->id, data);
+        return;
+    }
+
+    pubsub->publishing++;
+    publish_filters(pubsub, topic, data);
+    publish_end(pubsub);
+}
@@ -59,12 +59,29 @@ Subscription* pubsub_register(PubSub*, const char* topic, PubSubHandler handler,
 /** Cancels a subscription registered with `pubsub_register`. */
 void pubsub_unregister(Subscription*);
 
+/**
+ * Returns an integer handle for a topic, to publish within it with `pubsub_publish_interned`.
+ * Intern only the topics published often: each of them is kept, with a metric counting its publications,
+ * until the context is freed.
+ * The handle stays valid until the context is freed, and interning the same topic again returns it.
+ * Returns -1 if we run out of memory.
+ */
+int pubsub_topic_intern(PubSub*, const char* topic);
+
 /**
  * Publishes a new message within a topic.
+ * If the topic has been interned, this is the same as `pubsub_publish_interned`.
  * Note that `topic` must be a specific topic, not a filter (i.e. it cannot contain `*` or `,`).
  */
 void pubsub_publish(PubSub*, const char* topic, void* data);
 
+/**
+ * Publishes a new message within a topic interned with `pubsub_topic_intern`.
+ * The handlers of each topic are collected from the matching filters only when the subscriptions change,
+ * so this does not look up anything by name.
+ */
+void pubsub_publish_interned(PubSub*, int topic, void* data);
+
 
 #ifdef __cplusplus
 }
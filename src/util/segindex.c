@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util/segindex.h"
+
+struct SegmentIndex {
+
+    // Segments, one array per field
+    size_t* from;
+    size_t* to;
+    uint8_t* color;
+    uint32_t* name;
+    size_t len;
+    size_t capacity;
+
+};
+
+#define DEFAULT_CAPACITY 1024
+
+
+SegmentIndex* segindex_new() {
+    return calloc(1, sizeof(SegmentIndex));
+}
+
+void segindex_free(SegmentIndex* idx) {
+    if (idx == NULL) {
+        return;
+    }
+
+    free(idx->from);
+    free(idx->to);
+    free(idx->color);
+    free(idx->name);
+    free(idx);
+}
+
+size_t segindex_len(SegmentIndex* idx) {
+    return idx->len;
+}
+
+size_t segindex_get_memory(SegmentIndex* idx) {
+    return sizeof(SegmentIndex) + idx->capacity * (2 * sizeof(size_t) + sizeof(uint8_t) + sizeof(uint32_t));
+}
+
+static bool grow(SegmentIndex* idx) {
+    size_t capacity = idx->capacity == 0 ? DEFAULT_CAPACITY : idx->capacity * 2;
+
+    // Each array is reallocated separately: if one of the reallocations fails,
+    // the ones already done just leave some unused space
+    size_t* from = realloc(idx->from, capacity * sizeof(size_t));
+    if (from == NULL) {
+        return false;
+    }
+    idx->from = from;
+    size_t* to = realloc(idx->to, capacity * sizeof(size_t));
+    if (to == NULL) {
+        return false;
+    }
+    idx->to = to;
+    uint8_t* color = realloc(idx->color, capacity * sizeof(uint8_t));
+    if (color == NULL) {
+        return false;
+    }
+    idx->color = color;
+    uint32_t* name = realloc(idx->name, capacity * sizeof(uint32_t));
+    if (name == NULL) {
+        return false;
+    }
+    idx->name = name;
+
+    idx->capacity = capacity;
+    return true;
+}
+
+bool segindex_append(SegmentIndex* idx, size_t from, size_t to, int color, int name) {
+    assert(from <= to);
+    assert(idx->len == 0 || from > idx->to[idx->len - 1]);
+    assert(name >= 0);
+
+    if (idx->len == idx->capacity && !grow(idx)) {
+        return false;
+    }
+
+    idx->from[idx->len] = from;
+    idx->to[idx->len] = to;
+    idx->color[idx->len] = (uint8_t) color;
+    idx->name[idx->len] = (uint32_t) name;
+    idx->len++;
+    return true;
+}
+
+void segindex_truncate(SegmentIndex* idx, size_t len) {
+    if (len < idx->len) {
+        idx->len = len;
+    }
+}
+
+void segindex_drop(SegmentIndex* idx, size_t count) {
+    if (count >= idx->len) {
+        idx->len = 0;
+        return;
+    }
+
+    size_t len = idx->len - count;
+    memmove(idx->from, idx->from + count, len * sizeof(size_t));
+    memmove(idx->to, idx->to + count, len * sizeof(size_t));
+    memmove(idx->color, idx->color + count, len * sizeof(uint8_t));
+    memmove(idx->name, idx->name + count, len * sizeof(uint32_t));
+    idx->len = len;
+}
+
+size_t segindex_find(SegmentIndex* idx, size_t pos) {
+    size_t lo = 0;
+    size_t hi = idx->len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->to[mid] < pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool segindex_get(SegmentIndex* idx, size_t i, size_t* from, size_t* to, int* color, int* name) {
+    if (i >= idx->len) {
+        return false;
+    }
+
+    if (from != NULL) {
+        *from = idx->from[i];
+    }
+    if (to != NULL) {
+        *to = idx->to[i];
+    }
+    if (color != NULL) {
+        *color = idx->color[i];
+    }
+    if (name != NULL) {
+        *name = idx->name[i];
+    }
+    return true;
+}
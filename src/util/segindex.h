@@ -0,0 +1,63 @@
+#ifndef __SEGINDEX_H__
+#define __SEGINDEX_H__
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * Opaque data type for an index of format segments.
+ *
+ * The segments produced by the linearization of a format are sorted and do not overlap,
+ * so they can be stored in plain arrays (one for each field) that are only ever appended to
+ * or truncated, and searched with a binary search.
+ * Segments do not store their names, but only an id in a shared `NameTree`.
+ */
+typedef struct SegmentIndex SegmentIndex;
+
+/** Creates a new empty index. */
+SegmentIndex* segindex_new();
+
+/** Releases all the resources held by an index. */
+void segindex_free(SegmentIndex*);
+
+/** Returns the number of segments in the index. */
+size_t segindex_len(SegmentIndex*);
+
+/** Returns the total memory allocated by the index. */
+size_t segindex_get_memory(SegmentIndex*);
+
+/**
+ * Appends a new segment at the end of the index.
+ * Segments must be appended in order, and must not overlap with the ones already in the index.
+ */
+bool segindex_append(SegmentIndex*, size_t from, size_t to, int color, int name);
+
+/** Drops all the segments from the `len`-th onwards. */
+void segindex_truncate(SegmentIndex*, size_t len);
+
+/**
+ * Drops the first `count` segments, shifting the others to the beginning of the index.
+ * The memory is not released, but reused by the next appends.
+ */
+void segindex_drop(SegmentIndex*, size_t count);
+
+/**
+ * Returns the position of the first segment ending at or after the byte `pos`,
+ * or the number of segments in the index if there are none.
+ */
+size_t segindex_find(SegmentIndex*, size_t pos);
+
+/** Reads the fields of the `i`-th segment. Returns false if `i` is out of bounds. */
+bool segindex_get(SegmentIndex*, size_t i, size_t* from, size_t* to, int* color, int* name);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "util/trace.h"
+#include "util/log.h"
+
+// The events are stored in chunks allocated on demand, so that a short trace stays small
+// and the events never move once recorded
+#define CHUNK_EVENTS 16384
+#define MAX_CHUNKS 256
+#define MAX_DETAIL_LEN 32
+
+typedef struct {
+    uint64_t ts;
+    const char* name;
+    char detail[MAX_DETAIL_LEN];
+    char phase; // Written last: 0 means that the event is not complete yet
+} TraceEvent;
+
+bool trace_enabled = false;
+
+static FILE* trace_file = NULL;
+static TraceEvent* chunks[MAX_CHUNKS];
+static size_t next_event = 0;
+static size_t dropped_events = 0;
+
+
+
+static uint64_t now_usec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static TraceEvent* reserve_event() {
+
+    // Reserve a slot: concurrent writers always get different ones
+    size_t index = __atomic_fetch_add(&next_event, 1, __ATOMIC_RELAXED);
+    size_t chunk = index / CHUNK_EVENTS;
+    if (chunk >= MAX_CHUNKS) {
+        __atomic_fetch_add(&dropped_events, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    // Allocate the chunk if this is the first event in it. If another thread
+    // installs its own chunk first, use that one and throw ours away.
+    TraceEvent* events = __atomic_load_n(&chunks[chunk], __ATOMIC_ACQUIRE);
+    if (events == NULL) {
+        TraceEvent* fresh = calloc(CHUNK_EVENTS, sizeof(TraceEvent));
+        if (fresh == NULL) {
+            __atomic_fetch_add(&dropped_events, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        if (__atomic_compare_exchange_n(&chunks[chunk], &events, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            events = fresh;
+        } else {
+            free(fresh);
+        }
+    }
+
+    return &events[index % CHUNK_EVENTS];
+}
+
+void trace_event(char phase, const char* name, const char* detail) {
+    uint64_t ts = now_usec();
+    TraceEvent* ev = reserve_event();
+    if (ev == NULL) {
+        return;
+    }
+
+    ev->ts = ts;
+    ev->name = name;
+    if (detail != NULL) {
+        strncpy(ev->detail, detail, MAX_DETAIL_LEN);
+        ev->detail[MAX_DETAIL_LEN - 1] = '\0';
+    } else {
+        ev->detail[0] = '\0';
+    }
+    __atomic_store_n(&ev->phase, phase, __ATOMIC_RELEASE);
+}
+
+bool trace_start(const char* path) {
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL) {
+        log_fatal("Cannot open trace file %s: %s.", path, strerror(errno));
+        return false;
+    }
+    trace_enabled = true;
+    return true;
+}
+
+static void write_json_string(FILE* f, const char* str) {
+    fputc('"', f);
+    for (const char* c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(f, "\\%c", *c);
+        } else if ((unsigned char) *c < 0x20) {
+            fprintf(f, "\\u%04x", (unsigned char) *c);
+        } else {
+            fputc(*c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+void trace_stop() {
+    if (!trace_enabled) {
+        return;
+    }
+    trace_enabled = false;
+
+    size_t count = __atomic_load_n(&next_event, __ATOMIC_ACQUIRE);
+    if (count > CHUNK_EVENTS * MAX_CHUNKS) {
+        count = CHUNK_EVENTS * MAX_CHUNKS;
+    }
+
+    // Write all the complete events, with timestamps relative to the first one
+    fputs("{\"traceEvents\":[\n", trace_file);
+    bool first = true;
+    uint64_t origin = 0;
+    for (size_t i = 0; i < count; i++) {
+        TraceEvent* events = chunks[i / CHUNK_EVENTS];
+        if (events == NULL) {
+            continue;
+        }
+        TraceEvent* ev = &events[i % CHUNK_EVENTS];
+        if (__atomic_load_n(&ev->phase, __ATOMIC_ACQUIRE) == 0) {
+            continue;
+        }
+
+        if (first) {
+            origin = ev->ts;
+        }
+        fprintf(trace_file, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"name\":",
+            first ? "" : ",\n", ev->phase, (unsigned long long) (ev->ts - origin));
+        write_json_string(trace_file, ev->name);
+        if (ev->detail[0] != '\0') {
+            fputs(",\"args\":{\"detail\":", trace_file);
+            write_json_string(trace_file, ev->detail);
+            fputc('}', trace_file);
+        }
+        fputc('}', trace_file);
+        first = false;
+    }
+    fputs("\n]}\n", trace_file);
+
+    if (fclose(trace_file) != 0) {
+        log_error("Cannot write the trace file: %s.", strerror(errno));
+    }
+    trace_file = NULL;
+    if (dropped_events > 0) {
+        log_warn("The trace buffer was full: %zu events were dropped.", dropped_events);
+    }
+
+    // Release the events
+    for (size_t i = 0; i < MAX_CHUNKS; i++) {
+        free(chunks[i]);
+        chunks[i] = NULL;
+    }
+    next_event = 0;
+    dropped_events = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * Opt-in tracer producing Chrome trace-event JSON (the format understood by `chrome://tracing`
+ * and Perfetto), to see where the time of a slow keystroke goes.
+ *
+ * The spans are opened and closed with `TRACE_BEGIN` and `TRACE_END`, which cost a single branch
+ * when tracing is disabled. The events are appended to a buffer without taking any lock and are
+ * written to the file only by `trace_stop`, so that tracing does not add I/O to the measured paths.
+ * The span names must be string literals, since only the pointer is stored.
+ */
+
+/** Whether a trace is being recorded. Read it through the macros below. */
+extern bool trace_enabled;
+
+#define TRACE_BEGIN(name)             do { if (trace_enabled) trace_event('B', name, NULL); } while (0)
+#define TRACE_BEGIN_ARG(name, detail) do { if (trace_enabled) trace_event('B', name, detail); } while (0)
+#define TRACE_END(name)               do { if (trace_enabled) trace_event('E', name, NULL); } while (0)
+
+/**
+ *    Starts recording a trace, which will be written to `path` by `trace_stop`.
+ *    The file is created immediately, so that an invalid path is reported right away.
+ *
+ *    @return `true` on success, `false` if the file cannot be opened.
+ */
+bool trace_start(const char* path);
+
+/** Writes all the events recorded so far to the trace file and stops tracing. */
+void trace_stop();
+
+/**
+ *    Records an event with the given Chrome phase ('B' for begin, 'E' for end).
+ *    `detail`, if not NULL, is copied (and truncated if too long) and shown as an argument of the event.
+ */
+void trace_event(char phase, const char* name, const char* detail);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
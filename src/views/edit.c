@@ -22,19 +22,24 @@ typedef struct {
 static bool on_enter(HEdit* hedit, View* old) {
     assert(hedit->file != NULL);
 
-    ViewState* s = calloc(1, sizeof(ViewState));
-    if (s == NULL) {
-        log_fatal("Out of memory");
-        return false;
+    // The state is owned by the document, so that each buffer remembers its own cursor
+    Document* doc = hedit_buffer_current(hedit);
+    if (doc->view_state == NULL) {
+        ViewState* s = calloc(1, sizeof(ViewState));
+        if (s == NULL) {
+            log_fatal("Out of memory");
+            return false;
+        }
+        s->left = true;
+        doc->view_state = s;
     }
-    s->left = true;
-    hedit->viewdata = s;
+    hedit->viewdata = doc->view_state;
 
     return true;
 }
 
 static bool on_exit(HEdit* hedit, View* new) {
-    free(hedit->viewdata);
+    hedit->viewdata = NULL;
     return true;
 }
 
@@ -98,7 +103,7 @@ static void draw_bytes(HEdit* hedit, TickitRenderBuffer* rb, size_t padding, siz
 
             // Show on the statusbar the name of the segment the cursor is on
             if (seg != NULL && cursor_pos >= seg->from && cursor_pos <= seg->to) {
-                hedit_statusbar_show_message(hedit->statusbar, true, seg->name);
+                hedit_statusbar_show_message(hedit->statusbar, true, hedit_format_iter_name(format_it));
             }
 
         }
@@ -115,7 +120,7 @@ static void draw_bytes(HEdit* hedit, TickitRenderBuffer* rb, size_t padding, siz
         // Show on the statusbar the name of the segment the cursor is on
         seg = hedit_format_iter_seek(format_it, cursor_pos);
         if (seg != NULL && cursor_pos >= seg->from && cursor_pos <= seg->to) {
-            hedit_statusbar_show_message(hedit->statusbar, true, seg->name);
+            hedit_statusbar_show_message(hedit->statusbar, true, hedit_format_iter_name(format_it));
         }
     }
 
@@ -126,8 +131,8 @@ static void on_draw(HEdit* hedit, TickitWindow* win, TickitExposeEventInfo* e) {
     ViewState* state = hedit->viewdata;
 
     // Extract all the options needed for rendering
-    size_t colwidth = ((Option*) map_get(hedit->options, "colwidth"))->value.i;
-    bool lineoffset = ((Option*) map_get(hedit->options, "lineoffset"))->value.b;
+    size_t colwidth = hedit->builtin_options.colwidth->value.i;
+    bool lineoffset = hedit->builtin_options.lineoffset->value.b;
 
     // Precompute the format for the line offset
     char lineoffset_format[10];
@@ -202,7 +207,7 @@ static void on_draw(HEdit* hedit, TickitWindow* win, TickitExposeEventInfo* e) {
 
 static void on_movement(HEdit* hedit, enum Movement m, size_t arg) {
     ViewState* state = hedit->viewdata;
-    size_t colwidth = ((Option*) map_get(hedit->options, "colwidth"))->value.i;
+    size_t colwidth = hedit->builtin_options.colwidth->value.i;
     size_t pagesize = colwidth * tickit_window_lines(hedit->viewwin);
 
     size_t old_cursor_pos = state->cursor_pos;
@@ -1,3 +1,5 @@
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 #include <assert.h>
@@ -5,94 +7,163 @@
 
 #include "core.h"
 #include "actions.h"
-#include "util/list.h"
+#include "util/common.h"
 #include "util/log.h"
+#include "util/map.h"
 
-#define MAX_LOG_ENTRIES 100
 #define MAX_TIMESTAMP_LEN 24
-#define MAX_FILE_LEN 64
 #define MAX_MESSAGE_LEN 512
 
+// The arena for the messages is sized for messages of this length on average.
+// With longer ones, the oldest entries are dropped before the ring is full.
+#define AVERAGE_MESSAGE_LEN 96
+
 static const char* severity_names[] = {
     "DEBUG", "INFO ", "WARN ", "ERROR", "FATAL"
 };
 
 typedef struct {
-    char timestamp[MAX_TIMESTAMP_LEN];
-    log_severity severity;
-    char file[MAX_FILE_LEN];
+    time_t time;
+    const char* file; // Interned
     int line;
-    char message[MAX_MESSAGE_LEN];
-
-    struct list_head list;
-} LogMessage;
+    log_severity severity;
+    size_t text;      // Position of the message in the arena, which only grows and wraps around it
+    size_t len;
+} LogEntry;
 
 typedef struct {
     View* oldview;
     size_t scroll;
+    size_t page;
     bool can_scroll_down;
 } ViewState;
 
 
 
-static struct list_head messages = LIST_HEAD_INIT(messages);
-static size_t messages_count = 0;
+// Ring of the most recent messages, allocated once
+static LogEntry* entries = NULL;
+static size_t capacity = 0;
+static size_t first = 0;
+static size_t count = 0;
 
+// The text of the messages lives in a ring too, so that adding one never allocates
+static char* arena = NULL;
+static size_t arena_size = 0;
+static size_t arena_end = 0;
 
+// Map of the file names, each one copied once
+static Map* files = NULL;
+static const char* last_file = NULL;
 
-static void on_log(void* user, struct log_config* cfg, const char* file, int line, log_severity severity, const char* format, va_list args) {
-    
-    LogMessage* msg = calloc(1, sizeof(LogMessage));
-    if (msg == NULL) {
-        return;
+
+
+static const char* intern_file(const char* file) {
+
+    // Most messages in a row come from the same file
+    if (last_file != NULL && strcmp(last_file, file) == 0) {
+        return last_file;
     }
-    msg->severity = severity;
-    msg->line = line;
-    list_init(&msg->list);
-
-    // Store the formatted timestamp
-    time_t t;
-    struct tm* tm_info;
-    time(&t);
-    tm_info = localtime(&t);
-    if (strftime((char*) &msg->timestamp, MAX_TIMESTAMP_LEN, "%Y-%m-%d %H:%M:%S", tm_info) == 0) {
-        // Error formatting the time: do not output the time
-        msg->timestamp[0] = '\0'; 
+
+    char* interned = map_get(files, file);
+    if (interned == NULL) {
+        interned = strdup(file);
+        if (interned == NULL || !map_put(files, interned, interned)) {
+            free(interned);
+            return "?";
+        }
     }
+    last_file = interned;
+    return interned;
+}
+
+static void drop_oldest() {
+    first = (first + 1) % capacity;
+    count--;
+}
+
+static void push(time_t time, const char* file, int line, log_severity severity, const char* text, size_t len) {
 
-    // Copy the file name
-    strncpy(msg->file, file, MAX_FILE_LEN);
-    msg->file[MAX_FILE_LEN - 1] = '\0';
+    // Make room for the entry
+    if (count == capacity) {
+        drop_oldest();
+    }
 
-    // Preformat the message
-    if (vsnprintf(msg->message, MAX_MESSAGE_LEN, format, args) < 0) {
-        goto error;
+    // Keep the text contiguous: if it does not fit before the end of the arena, restart from its beginning.
+    // Then drop the oldest messages whose text is going to be overwritten.
+    len = MIN(len, MAX_MESSAGE_LEN);
+    size_t at = arena_end;
+    if (at % arena_size + len > arena_size) {
+        at += arena_size - at % arena_size;
     }
-    msg->message[MAX_MESSAGE_LEN - 1] = '\0';
-
-    // Add the message to the global queue
-    list_add_tail(&messages, &msg->list);
-    if (messages_count < MAX_LOG_ENTRIES) {
-        messages_count++;
-    } else {
-        LogMessage* first = list_first(&messages, LogMessage, list);
-        list_del(&first->list);
-        free(first);
+    while (count > 0 && entries[first].text + arena_size < at + len) {
+        drop_oldest();
     }
 
-    return;
+    memcpy(&arena[at % arena_size], text, len);
+    arena_end = at + len;
+    entries[(first + count) % capacity] = (LogEntry) {
+        .time = time,
+        .file = file,
+        .line = line,
+        .severity = severity,
+        .text = at,
+        .len = len
+    };
+    count++;
+}
+
+static LogEntry* entry_at(size_t index) {
+    return &entries[(first + index) % capacity];
+}
+
+bool hedit_log_view_resize(size_t size) {
+    assert(size > 0);
+
+    // Allocate the new rings and move there the most recent messages that fit
+    size_t new_arena_size = MAX(size * AVERAGE_MESSAGE_LEN, MAX_MESSAGE_LEN);
+    LogEntry* new_entries = malloc(size * sizeof(LogEntry));
+    char* new_arena = malloc(new_arena_size);
+    if (new_entries == NULL || new_arena == NULL) {
+        free(new_entries);
+        free(new_arena);
+        log_error("Cannot keep %zu log messages: out of memory.", size);
+        return false;
+    }
 
-error:
-    if (msg != NULL) {
-        free(msg);
+    LogEntry* old_entries = entries;
+    char* old_arena = arena;
+    size_t old_capacity = capacity;
+    size_t old_arena_size = arena_size;
+    size_t old_first = first;
+    size_t old_count = count;
+
+    entries = new_entries;
+    capacity = size;
+    arena = new_arena;
+    arena_size = new_arena_size;
+    first = 0;
+    count = 0;
+    arena_end = 0;
+
+    for (size_t i = old_count - MIN(old_count, size); i < old_count; i++) {
+        LogEntry* e = &old_entries[(old_first + i) % old_capacity];
+        push(e->time, e->file, e->line, e->severity, &old_arena[e->text % old_arena_size], e->len);
     }
+
+    free(old_entries);
+    free(old_arena);
+    return true;
+}
+
+static void on_log(void* user, const struct log_message* message) {
+    push(message->time, intern_file(message->file), message->line, message->severity, message->text, strlen(message->text));
 }
 
 static void on_program_exit() {
     // Free all the stored messages
-    list_for_each_member(m, &messages, LogMessage, list) {
-        free(m);
-    }
+    free(entries);
+    free(arena);
+    map_free_full(files);
 }
 
 static bool on_enter(HEdit* hedit, View* prev) {
@@ -128,25 +199,27 @@ static void on_draw(HEdit* hedit, TickitWindow* win, TickitExposeEventInfo* e) {
 
     int win_lines = tickit_window_lines(win);
     size_t line = 0;
-    size_t skip = 0;
+    char timestamp[MAX_TIMESTAMP_LEN];
 
-    list_for_each_member(m, &messages, LogMessage, list) {
-        if (skip < state->scroll) {
-            skip++;
-            continue;
-        }
+    // The messages may have been dropped while we were scrolled down
+    state->scroll = MIN(state->scroll, count);
+    state->page = win_lines;
 
-        tickit_renderbuffer_setpen(e->rb, severity_pen[m->severity]);
-        tickit_renderbuffer_textf_at(e->rb, line, 0, "%s %s %s:%d %s",
-            m->timestamp, severity_names[m->severity], m->file, m->line, m->message);
-        line++;
+    for (size_t i = state->scroll; i < count && line < win_lines; i++, line++) {
+        LogEntry* m = entry_at(i);
 
-        if (line == win_lines) {
-            break;
+        struct tm tm_info;
+        if (localtime_r(&m->time, &tm_info) == NULL || strftime(timestamp, MAX_TIMESTAMP_LEN, "%Y-%m-%d %H:%M:%S", &tm_info) == 0) {
+            // Error formatting the time: do not output the time
+            timestamp[0] = '\0';
         }
+
+        tickit_renderbuffer_setpen(e->rb, severity_pen[m->severity]);
+        tickit_renderbuffer_textf_at(e->rb, line, 0, "%s %s %s:%d %.*s",
+            timestamp, severity_names[m->severity], m->file, m->line, (int) m->len, &arena[m->text % arena_size]);
     }
     
-    state->can_scroll_down = messages_count > state->scroll + line;
+    state->can_scroll_down = count > state->scroll + line;
 
     // Fill the remaining lines with `~`
     if (win_lines > line) {
@@ -173,6 +246,17 @@ static void on_movement(HEdit* hedit, enum Movement m, size_t arg) {
                 state->scroll++;
             }
             break;
+        case HEDIT_MOVEMENT_PAGE_UP:
+            state->scroll -= MIN(state->scroll, state->page);
+            break;
+        case HEDIT_MOVEMENT_PAGE_DOWN:
+            if (state->can_scroll_down) {
+                state->scroll = MIN(state->scroll + state->page, count - 1);
+            }
+            break;
+        case HEDIT_MOVEMENT_ABSOLUTE:
+            state->scroll = MIN(arg, count > 0 ? count - 1 : 0);
+            break;
         default:
             return;
     }
@@ -213,9 +297,16 @@ REGISTER_VIEW2(HEDIT_VIEW_LOG, definition, {
     }
     definition.binding_overrides[HEDIT_MODE_NORMAL] = map;
 
+    // Allocate the ring for the messages
+    files = map_new();
+    if (files == NULL || !hedit_log_view_resize(HEDIT_LOG_VIEW_DEFAULT_SIZE)) {
+        log_fatal("Out of memory.");
+        return;
+    }
+
     // Register a log sink at initialization time,
     // since we have to collect log messages even if the view is not active
-    void* token = log_register_sink(on_log, NULL);
+    void* token = log_register_sink(on_log, LOG_DEBUG, NULL);
     if (token == NULL) {
         log_fatal("Out of memory.");
         return;
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <tickit.h>
+
+#include "core.h"
+#include "actions.h"
+#include "util/log.h"
+#include "util/metrics.h"
+
+// Milliseconds between two refreshes of the view
+#define REFRESH_INTERVAL 1000
+
+#define MAX_LINE_LEN 256
+
+/** Value of a metric at the last refresh, used to compute its rate of change. */
+typedef struct {
+    Metric* metric;
+    int64_t last;
+    double rate;
+} Sample;
+
+typedef struct {
+    HEdit* hedit;
+    View* oldview;
+    size_t scroll;
+    bool can_scroll_down;
+    int timer;
+
+    Sample* samples;
+    size_t samples_len;
+    size_t samples_capacity;
+    uint64_t last_refresh;
+    double elapsed; // Seconds between the last two refreshes
+} ViewState;
+
+
+
+// For histograms the rate is the one of the samples recorded, for counters the one of the value
+static int64_t metric_value(Metric* m) {
+    return m->type == METRIC_HISTOGRAM ? (int64_t) m->count : m->value;
+}
+
+static bool take_sample(Metric* m, void* user) {
+    ViewState* state = user;
+
+    // Look for the previous sample of this metric
+    Sample* s = NULL;
+    for (size_t i = 0; i < state->samples_len; i++) {
+        if (state->samples[i].metric == m) {
+            s = &state->samples[i];
+            break;
+        }
+    }
+
+    // Start tracking the new metrics
+    if (s == NULL) {
+        if (state->samples_len == state->samples_capacity) {
+            size_t capacity = state->samples_capacity == 0 ? 64 : state->samples_capacity * 2;
+            Sample* samples = realloc(state->samples, capacity * sizeof(Sample));
+            if (samples == NULL) {
+                log_fatal("Out of memory.");
+                return false;
+            }
+            state->samples = samples;
+            state->samples_capacity = capacity;
+        }
+        s = &state->samples[state->samples_len++];
+        s->metric = m;
+        s->last = metric_value(m);
+        s->rate = 0;
+        return true;
+    }
+
+    int64_t value = metric_value(m);
+    s->rate = state->elapsed > 0 ? (value - s->last) / state->elapsed : 0;
+    s->last = value;
+    return true;
+}
+
+static void refresh(ViewState* state) {
+    uint64_t now = metrics_now();
+    state->elapsed = state->last_refresh == 0 ? 0 : (now - state->last_refresh) / 1e6;
+    state->last_refresh = now;
+    metrics_iterate(take_sample, state);
+}
+
+static int on_refresh_timer(Tickit* t, TickitEventFlags flags, void* user) {
+    ViewState* state = user;
+
+    refresh(state);
+    hedit_redraw_view(state->hedit);
+    state->timer = tickit_timer_after_msec(t, REFRESH_INTERVAL, 0, on_refresh_timer, state);
+
+    return 1;
+}
+
+static bool on_enter(HEdit* hedit, View* prev) {
+    // Store the previous view so that we can return to it when we exit
+    ViewState* state = calloc(1, sizeof(ViewState));
+    if (state == NULL) {
+        log_fatal("Out of memory.");
+        return false;
+    }
+    state->hedit = hedit;
+    state->oldview = prev;
+    hedit->viewdata = state;
+
+    // Refresh the view periodically to show the rates
+    refresh(state);
+    state->timer = tickit_timer_after_msec(hedit->tickit, REFRESH_INTERVAL, 0, on_refresh_timer, state);
+
+    return true;
+}
+
+static bool on_exit(HEdit* hedit, View* next) {
+    ViewState* state = hedit->viewdata;
+    tickit_timer_cancel(hedit->tickit, state->timer);
+    free(state->samples);
+    free(state);
+    return true;
+}
+
+static void format_sample(Sample* s, char* buf, size_t len) {
+    Metric* m = s->metric;
+
+    if (m->type == METRIC_COUNTER) {
+        snprintf(buf, len, "%-32s %14lld %12.1f/s", m->name, (long long) m->value, s->rate);
+    } else {
+        snprintf(buf, len, "%-32s %14llu %12.1f/s   avg %9.3fms   p50 %9.3fms   p99 %9.3fms   max %9.3fms",
+            m->name, (unsigned long long) m->count, s->rate,
+            m->count > 0 ? (double) m->sum / m->count / 1000 : 0,
+            metrics_quantile(m, 0.5) / 1000.0, metrics_quantile(m, 0.99) / 1000.0, m->max / 1000.0);
+    }
+}
+
+static void on_draw(HEdit* hedit, TickitWindow* win, TickitExposeEventInfo* e) {
+    ViewState* state = hedit->viewdata;
+
+    // Clear the window
+    tickit_renderbuffer_eraserect(e->rb, &e->rect);
+
+    int win_lines = tickit_window_lines(win);
+    size_t line = 0;
+    char buf[MAX_LINE_LEN];
+
+    // Header
+    tickit_renderbuffer_setpen(e->rb, hedit->theme->linenos);
+    snprintf(buf, MAX_LINE_LEN, "%-32s %14s %14s", "Metric", "Value", "Rate");
+    tickit_renderbuffer_text_at(e->rb, line++, 0, buf);
+
+    tickit_renderbuffer_setpen(e->rb, hedit->theme->text);
+    for (size_t i = state->scroll; i < state->samples_len && line < win_lines; i++) {
+        format_sample(&state->samples[i], buf, MAX_LINE_LEN);
+        tickit_renderbuffer_text_at(e->rb, line++, 0, buf);
+    }
+
+    state->can_scroll_down = state->samples_len > state->scroll + line - 1;
+
+    // Fill the remaining lines with `~`
+    if (win_lines > line) {
+        tickit_renderbuffer_setpen(e->rb, hedit->theme->linenos);
+        while (line < win_lines) {
+            tickit_renderbuffer_text_at(e->rb, line, 0, "~");
+            line++;
+        }
+    }
+
+}
+
+static void on_movement(HEdit* hedit, enum Movement m, size_t arg) {
+    ViewState* state = hedit->viewdata;
+
+    switch (m) {
+        case HEDIT_MOVEMENT_UP:
+            if (state->scroll > 0) {
+                state->scroll--;
+            }
+            break;
+        case HEDIT_MOVEMENT_DOWN:
+            if (state->can_scroll_down) {
+                state->scroll++;
+            }
+            break;
+        default:
+            return;
+    }
+
+    hedit_redraw_view(hedit);
+}
+
+static void do_quit(HEdit* hedit, const Value* arg) {
+    ViewState* state = hedit->viewdata;
+    hedit_switch_view(hedit, state->oldview->id);
+}
+
+static Action action_quit = {
+    .cb = do_quit
+};
+
+static View definition = {
+    .id = HEDIT_VIEW_STATS,
+    .name = "stats",
+    .on_enter = on_enter,
+    .on_exit = on_exit,
+    .on_draw = on_draw,
+    .on_movement = on_movement
+};
+
+REGISTER_VIEW2(HEDIT_VIEW_STATS, definition, {
+
+    // Prepare a map for the binding overrides
+    Map* map = map_new();
+    if (map == NULL) {
+        log_fatal("Out of memory.");
+        return;
+    }
+    if (!map_put(map, "q", &action_quit)) {
+        log_fatal("Out of memory.");
+        map_free(map);
+        return;
+    }
+    definition.binding_overrides[HEDIT_MODE_NORMAL] = map;
+
+})
@@ -0,0 +1,90 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <tickit.h>
+
+#include "core.h"
+
+
+/*
+ * Minimal harness for the benchmarks.
+ *
+ * Each suite is a function that runs its measurements and reports them with `bench_report`,
+ * and returns false if any of them failed.
+ * When all the suites have run, the results are printed as a single JSON document,
+ * so that they can be compared between two builds by a script.
+ */
+
+/** Parameters of a benchmark run, from the command line. */
+typedef struct {
+    size_t file_size;   // Size of the synthetic files for the editing and scanning benchmarks
+    size_t save_size;   // Size of the synthetic files for the saving benchmarks, which write them fully
+    size_t ops;         // Number of operations in each measurement (the slowest ones use less)
+    const char* tmpdir; // Directory for the temporary files
+    int term_cols;      // Size of the virtual terminal for the rendering benchmarks
+    int term_lines;
+    const char* keys;   // Recording of keys to replay, made with `hedit --record-keys`
+    const char* input;  // File to replay the keys against, instead of a synthetic one
+    const char* format; // Format to replay the keys with, instead of the guessed one
+} BenchConfig;
+
+/** Signature of a suite of benchmarks. */
+typedef bool (*BenchSuite)(const BenchConfig*);
+
+/** Returns the time in nanoseconds from an arbitrary point in the past. */
+uint64_t bench_now();
+
+/**
+ *    Records the result of a measurement.
+ *
+ *    @param suite Name of the suite, like `file`.
+ *    @param name  Name of the measurement, which is copied.
+ *    @param ops   Number of operations performed.
+ *    @param bytes Number of bytes processed, or 0 if it is not meaningful.
+ *    @param nsec  Total time taken by the operations.
+ */
+void bench_report(const char* suite, const char* name, uint64_t ops, uint64_t bytes, uint64_t nsec);
+
+/**
+ *    Records the latency distribution of `n` operations, given their single durations in nanoseconds.
+ *    The samples are sorted in place.
+ */
+void bench_report_latency(const char* suite, const char* name, uint64_t* samples, size_t n);
+
+/**
+ *    Creates a sparse file of the given size in the temporary directory.
+ *    Sparse files take no space on disk, so they can be as large as needed.
+ *
+ *    @return The path of the new file, to be freed and unlinked by the caller, or NULL on error.
+ */
+char* bench_sparse_file(const BenchConfig*, size_t size);
+
+/**
+ *    Creates a Tickit instance on a virtual terminal of the configured size.
+ *    Everything is rendered and encoded as usual, but the output is discarded.
+ */
+Tickit* bench_tickit(const BenchConfig*);
+
+/**
+ *    Returns an editor on a virtual terminal of the configured size, with no buffer open.
+ *    The editor is created on first use and shared by all the suites, because it cannot be initialized twice:
+ *    the buffers left open by the previous suite are closed every time.
+ *
+ *    @return The editor, or NULL if it cannot be created.
+ */
+HEdit* bench_editor(const BenchConfig*);
+
+/** Returns a pseudo-random number from a fixed seed, so that all the runs do the same operations. */
+uint64_t bench_random();
+
+
+// Suites
+bool bench_file(const BenchConfig*);
+bool bench_render(const BenchConfig*);
+bool bench_replay(const BenchConfig*);
+
+
+#endif
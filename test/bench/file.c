@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "file.h"
+
+#define SUITE "file"
+#define CHUNK_LEN 16
+
+static const unsigned char chunk[CHUNK_LEN] = "0123456789abcdef";
+
+enum Access {
+    SEQUENTIAL,
+    RANDOM
+};
+
+
+
+static File* open_sparse(const BenchConfig* cfg, size_t size, char** path) {
+    *path = bench_sparse_file(cfg, size);
+    if (*path == NULL) {
+        return NULL;
+    }
+    File* file = hedit_file_open(*path);
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open %s.\n", *path);
+        unlink(*path);
+        free(*path);
+    }
+    return file;
+}
+
+static void close_sparse(File* file, char* path) {
+    hedit_file_close(file);
+    unlink(path);
+    free(path);
+}
+
+// Spreads small edits over the whole file, so that the piece chain is not trivial
+static void fragment(File* file, size_t edits) {
+    for (size_t i = 0; i < edits; i++) {
+        hedit_file_insert(file, bench_random() % (hedit_file_size(file) + 1), chunk, CHUNK_LEN);
+        if (i % 100 == 99) {
+            hedit_file_commit_revision(file);
+        }
+    }
+    hedit_file_commit_revision(file);
+}
+
+// The sequential edits start from the middle of the file and then move forward by `advance`
+// bytes at a time, like typing (`advance` is 0 for the deletions, which pull the data back)
+static bool bench_edit(const BenchConfig* cfg, const char* name, enum Access access, size_t advance,
+                       bool (*edit)(File*, size_t offset)) {
+    char* path;
+    File* file = open_sparse(cfg, cfg->file_size, &path);
+    if (file == NULL) {
+        return false;
+    }
+
+    // The random edits are much slower, since each of them has to find its piece from the start of the chain
+    size_t ops = access == RANDOM ? cfg->ops / 10 : cfg->ops;
+    size_t offset = cfg->file_size / 2;
+    size_t i;
+    uint64_t start = bench_now();
+    for (i = 0; i < ops; i++) {
+        if (access == RANDOM) {
+            offset = bench_random() % (hedit_file_size(file) - CHUNK_LEN);
+        }
+        if (!edit(file, offset)) {
+            fprintf(stderr, "%s failed at offset %zu.\n", name, offset);
+            break;
+        }
+        offset += advance;
+    }
+
+    // Only the edits that succeeded count
+    bench_report(SUITE, name, i, 0, bench_now() - start);
+
+    close_sparse(file, path);
+    return i == ops;
+}
+
+static bool do_insert(File* file, size_t offset) {
+    return hedit_file_insert(file, offset, chunk, CHUNK_LEN);
+}
+
+static bool do_delete(File* file, size_t offset) {
+    return hedit_file_delete(file, offset, CHUNK_LEN);
+}
+
+static bool do_replace(File* file, size_t offset) {
+    return hedit_file_replace(file, offset, chunk, CHUNK_LEN);
+}
+
+static bool bench_undo_redo(const BenchConfig* cfg) {
+    char* path;
+    File* file = open_sparse(cfg, cfg->file_size, &path);
+    if (file == NULL) {
+        return false;
+    }
+
+    // Build a deep history, one revision per edit
+    size_t depth = cfg->ops;
+    for (size_t i = 0; i < depth; i++) {
+        hedit_file_insert(file, bench_random() % (hedit_file_size(file) + 1), chunk, CHUNK_LEN);
+        hedit_file_commit_revision(file);
+    }
+
+    size_t pos;
+    size_t undone = 0;
+    uint64_t start = bench_now();
+    while (hedit_file_undo(file, &pos)) {
+        undone++;
+    }
+    bench_report(SUITE, "undo", undone, 0, bench_now() - start);
+
+    size_t redone = 0;
+    start = bench_now();
+    while (hedit_file_redo(file, &pos)) {
+        redone++;
+    }
+    bench_report(SUITE, "redo", redone, 0, bench_now() - start);
+
+    bool ok = undone == depth && redone == depth;
+    if (!ok) {
+        fprintf(stderr, "Expected %zu revisions, undone %zu and redone %zu.\n", depth, undone, redone);
+    }
+
+    close_sparse(file, path);
+    return ok;
+}
+
+// Reads every byte, otherwise the scan would only measure the walk of the piece chain
+static unsigned char checksum(const unsigned char* data, size_t len) {
+    unsigned char sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum ^= data[i];
+    }
+    return sum;
+}
+
+static bool checksum_visitor(File* file, size_t offset, const unsigned char* data, size_t len, void* user) {
+    unsigned char* sum = user;
+    *sum ^= checksum(data, len);
+    return true;
+}
+
+static bool bench_scan(const BenchConfig* cfg) {
+    char* path;
+    File* file = open_sparse(cfg, cfg->file_size, &path);
+    if (file == NULL) {
+        return false;
+    }
+    fragment(file, cfg->ops / 10);
+    size_t size = hedit_file_size(file);
+
+    // Fault all the pages in first, otherwise the first scan would pay for it and the second one not
+    unsigned char sum0 = 0;
+    hedit_file_visit(file, 0, size, checksum_visitor, &sum0);
+
+    // Iterator
+    unsigned char sum1 = 0;
+    const unsigned char* data;
+    size_t len;
+    uint64_t start = bench_now();
+    FileIterator* it = hedit_file_iter(file, 0, size);
+    while (hedit_file_iter_next(it, &data, &len)) {
+        sum1 ^= checksum(data, len);
+    }
+    hedit_file_iter_free(it);
+    bench_report(SUITE, "iter_scan", 1, size, bench_now() - start);
+
+    // Visitor
+    unsigned char sum2 = 0;
+    start = bench_now();
+    hedit_file_visit(file, 0, size, checksum_visitor, &sum2);
+    bench_report(SUITE, "visit_scan", 1, size, bench_now() - start);
+
+    bool ok = sum1 == sum0 && sum2 == sum0;
+    if (!ok) {
+        fprintf(stderr, "The iterator and the visitor read different contents.\n");
+    }
+
+    close_sparse(file, path);
+    return ok;
+}
+
+static bool bench_save_mode(const BenchConfig* cfg, const char* name, enum FileSaveMode mode) {
+    char* path;
+    File* file = open_sparse(cfg, cfg->save_size, &path);
+    if (file == NULL) {
+        return false;
+    }
+    fragment(file, cfg->ops / 10);
+
+    // Save to a different file, since the original one is mapped in memory
+    char* target = bench_sparse_file(cfg, 0);
+    if (target == NULL) {
+        close_sparse(file, path);
+        return false;
+    }
+
+    size_t size = hedit_file_size(file);
+    uint64_t start = bench_now();
+    bool ok = hedit_file_save(file, target, mode);
+    if (ok) {
+        bench_report(SUITE, name, 1, size, bench_now() - start);
+    } else {
+        fprintf(stderr, "Cannot save to %s.\n", target);
+    }
+
+    unlink(target);
+    free(target);
+    close_sparse(file, path);
+    return ok;
+}
+
+bool bench_file(const BenchConfig* cfg) {
+    // Keep going after a failure, so that the other measurements are still reported
+    bool ok = true;
+    ok &= bench_edit(cfg, "insert_sequential", SEQUENTIAL, CHUNK_LEN, do_insert);
+    ok &= bench_edit(cfg, "insert_random", RANDOM, 0, do_insert);
+    ok &= bench_edit(cfg, "delete_sequential", SEQUENTIAL, 0, do_delete);
+    ok &= bench_edit(cfg, "delete_random", RANDOM, 0, do_delete);
+    ok &= bench_edit(cfg, "replace_sequential", SEQUENTIAL, CHUNK_LEN, do_replace);
+    ok &= bench_edit(cfg, "replace_random", RANDOM, 0, do_replace);
+    ok &= bench_undo_redo(cfg);
+    ok &= bench_scan(cfg);
+    ok &= bench_save_mode(cfg, "save_atomic", SAVE_MODE_ATOMIC);
+    ok &= bench_save_mode(cfg, "save_inplace", SAVE_MODE_INPLACE);
+    return ok;
+}
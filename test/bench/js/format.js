@@ -0,0 +1,116 @@
+
+import Format from 'hedit/format';
+import luks from 'hedit/format/luks';
+import mifare from 'hedit/format/mifare';
+import string from 'hedit/format/string';
+import { FormatCache } from 'hedit/private/format';
+
+// Each exported function is a benchmark: it linearizes a format over a generated buffer
+// and returns the number of segments produced, so that the runner can compute the throughput.
+
+const BUFFER_SIZE = 1024 * 1024;
+
+// Pseudo-random contents from a fixed seed, so that the data-dependent formats do the same work on every run
+const buffer = (() => {
+    const bytes = new Uint8Array(BUFFER_SIZE);
+    let x = 0x12345678;
+    for (let i = 0; i < bytes.length; i++) {
+        x ^= x << 13;
+        x ^= x >>> 17;
+        x ^= x << 5;
+        bytes[i] = x & 0xFF;
+    }
+    return bytes.buffer;
+})();
+
+// Same contract as the proxy used by the format cache: `null` past the end of the file
+const proxy = {
+    read(pos, length) {
+        if (pos + length > buffer.byteLength) {
+            return null;
+        }
+        return new DataView(buffer, pos, length);
+    }
+};
+
+// The format cache reads the generated buffer as the open file, and stores the segments
+// in the native index provided by the runner
+__hedit.file_isOpen = () => true;
+__hedit.file_read = (pos, len) => buffer.slice(pos, pos + len);
+
+function linearize(format) {
+    let count = 0;
+    for (const seg of format.__linearize(proxy, 0, 0, Object.create(null))) {
+        if (seg.from >= buffer.byteLength) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+function nestedGroups(depth) {
+    let f = new Format();
+    for (let i = 0; i < depth; i++) {
+        f = f.group('Level #' + i).uint8('Tag', 'red');
+    }
+    f = f.uint32le('Value', 'green');
+    for (let i = 0; i < depth; i++) {
+        f = f.endgroup();
+    }
+    return f;
+}
+
+
+
+export const BuiltinLuks = () => linearize(new Format().sequence(luks));
+
+export const BuiltinMifare = () => linearize(new Format().sequence(mifare));
+
+export const BuiltinString = () => linearize(string);
+
+export const DeeplyNestedGroups = () => linearize(new Format().sequence(nestedGroups(32)));
+
+export const LargeArrays = () => linearize(
+    new Format().sequence(
+        new Format()
+            .array('Items', 100000, new Format().uint16le('Id', 'blue').array('Payload', 6, 'gray'))
+    )
+);
+
+export const DataDependentStrings = () => linearize(
+    new Format().sequence(
+        new Format()
+            .uint8('Kind', 'red', 'kind')
+            .uint8('Length', 'blue', 'len')
+            .array('Text', vars => vars.kind & 1 ? vars.len : vars.len >> 4, 'green')
+    )
+);
+
+const cachedArrays = () => new Format().sequence(
+    new Format()
+        .uint8('Kind', 'red', 'kind')
+        .array('Items', 64, new Format().uint16le('Id', 'blue').array('Payload', 6, 'gray'))
+);
+
+// Linearizations through the format cache, with the segments in the native index as in the editor.
+// The whole buffer is requested from its start, so that nothing is jumped over.
+export const CachedLinearization = () => {
+    const cache = new FormatCache(cachedArrays());
+    cache._linearizeUpTo(BUFFER_SIZE, Infinity, 0);
+    return cache._length;
+};
+
+// Edits farther and farther from the end: each one resumes the linearization from the last checkpoint before it
+export const CachedLinearizationAfterEdits = () => {
+    const cache = new FormatCache(cachedArrays());
+    cache._linearizeUpTo(BUFFER_SIZE, Infinity, 0);
+    let count = cache._length;
+    for (let distance = 1; distance < BUFFER_SIZE; distance *= 2) {
+        cache.invalidateFrom(BUFFER_SIZE - distance);
+        const resumed = cache._length;
+        cache._linearizeUpTo(BUFFER_SIZE, Infinity, 0);
+        count += cache._length - resumed;
+    }
+    return count;
+};
@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "actions.h"
+#include "options.h"
+#include "util/common.h"
+
+#define MB (1024ULL * 1024)
+#define GB (1024ULL * MB)
+
+typedef struct {
+    const char* suite;
+    char* name;
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t nsec;
+
+    // Latency distribution, only for the results of `bench_report_latency`
+    bool latency;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+} BenchResult;
+
+static BenchResult* results = NULL;
+static size_t results_len = 0;
+static size_t results_capacity = 0;
+static uint64_t random_state = 0x9E3779B97F4A7C15ULL;
+
+// Editor shared by the suites, see `bench_editor`
+static Options options = { 0 };
+static Tickit* tickit = NULL;
+static HEdit* editor = NULL;
+static bool editor_failed = false;
+
+static const struct {
+    const char* name;
+    BenchSuite run;
+} suites[] = {
+    { "file", bench_file },
+    { "render", bench_render },
+    { "replay", bench_replay },
+};
+
+
+
+uint64_t bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static BenchResult* add_result(const char* suite, const char* name) {
+    if (results_len == results_capacity) {
+        size_t capacity = results_capacity == 0 ? 32 : results_capacity * 2;
+        BenchResult* r = realloc(results, capacity * sizeof(BenchResult));
+        if (r == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+        results = r;
+        results_capacity = capacity;
+    }
+    char* namedup = strdup(name);
+    if (namedup == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    results[results_len] = (BenchResult) {
+        .suite = suite,
+        .name = namedup
+    };
+    return &results[results_len++];
+}
+
+void bench_report(const char* suite, const char* name, uint64_t ops, uint64_t bytes, uint64_t nsec) {
+    BenchResult* r = add_result(suite, name);
+    r->ops = ops;
+    r->bytes = bytes;
+    r->nsec = nsec;
+
+    // Progress goes to stderr, so that stdout only contains the JSON
+    fprintf(stderr, "%-8s %-28s %12.1f ops/s", suite, name, nsec > 0 ? ops * 1e9 / nsec : 0);
+    if (bytes > 0) {
+        fprintf(stderr, " %10.1f MB/s", nsec > 0 ? bytes * 1e9 / nsec / MB : 0);
+    }
+    fprintf(stderr, "\n");
+}
+
+static int compare_samples(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+void bench_report_latency(const char* suite, const char* name, uint64_t* samples, size_t n) {
+    BenchResult* r = add_result(suite, name);
+    r->ops = n;
+    r->latency = true;
+    for (size_t i = 0; i < n; i++) {
+        r->nsec += samples[i];
+    }
+    if (n > 0) {
+        qsort(samples, n, sizeof(uint64_t), compare_samples);
+        r->p50 = samples[n / 2];
+        r->p99 = samples[MIN(n * 99 / 100, n - 1)];
+        r->max = samples[n - 1];
+    }
+
+    fprintf(stderr, "%-8s %-28s %12zu ops    p50 %9.3fms    p99 %9.3fms    max %9.3fms\n",
+        suite, name, n, r->p50 / 1e6, r->p99 / 1e6, r->max / 1e6);
+}
+
+char* bench_sparse_file(const BenchConfig* cfg, size_t size) {
+    size_t len = strlen(cfg->tmpdir) + 32;
+    char* path = malloc(len);
+    if (path == NULL) {
+        return NULL;
+    }
+    snprintf(path, len, "%s/hedit-bench-XXXXXX", cfg->tmpdir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create a temporary file in %s: %s.\n", cfg->tmpdir, strerror(errno));
+        free(path);
+        return NULL;
+    }
+
+    // Write a byte at the end too, so that the whole file is not a single hole
+    if (ftruncate(fd, size) < 0 || (size > 0 && pwrite(fd, "\n", 1, size - 1) != 1)) {
+        fprintf(stderr, "Cannot grow %s to %zu bytes: %s.\n", path, size, strerror(errno));
+        close(fd);
+        unlink(path);
+        free(path);
+        return NULL;
+    }
+
+    close(fd);
+    return path;
+}
+
+// The virtual terminal does not go anywhere: rendering still builds and encodes
+// all the output, which is then thrown away here
+static void discard_output(TickitTerm* tt, const char* bytes, size_t len, void* user) {
+}
+
+Tickit* bench_tickit(const BenchConfig* cfg) {
+    TickitTerm* tt = tickit_term_new_for_termtype("xterm");
+    if (tt == NULL) {
+        fprintf(stderr, "Cannot create a virtual terminal.\n");
+        return NULL;
+    }
+    tickit_term_set_output_func(tt, discard_output, NULL);
+    tickit_term_set_size(tt, cfg->term_lines, cfg->term_cols);
+    return tickit_new_for_term(tt);
+}
+
+HEdit* bench_editor(const BenchConfig* cfg) {
+    if (editor == NULL) {
+
+        // Do not try again after a failure: the actions and V8 would be initialized twice
+        if (editor_failed) {
+            fprintf(stderr, "The editor could not be created.\n");
+            return NULL;
+        }
+        editor_failed = true;
+
+        tickit = bench_tickit(cfg);
+        if (tickit == NULL) {
+            fprintf(stderr, "Cannot create the terminal of the editor.\n");
+            return NULL;
+        }
+        if (!hedit_init_actions()) {
+            fprintf(stderr, "Cannot initialize the editor actions.\n");
+            return NULL;
+        }
+        editor = hedit_core_init(&options, tickit);
+        if (editor == NULL) {
+            fprintf(stderr, "Cannot initialize the editor.\n");
+            return NULL;
+        }
+        editor_failed = false;
+    }
+
+    // A replay might have quit the editor
+    while (hedit_buffer_current(editor) != NULL) {
+        hedit_buffer_close(editor);
+    }
+    editor->exit = false;
+    return editor;
+}
+
+uint64_t bench_random() {
+    // xorshift64*
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void print_json(FILE* out, const BenchConfig* cfg) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": { \"file_size\": %zu, \"save_size\": %zu, \"ops\": %zu, \"term_cols\": %d, \"term_lines\": %d },\n",
+        cfg->file_size, cfg->save_size, cfg->ops, cfg->term_cols, cfg->term_lines);
+    fprintf(out, "  \"results\": [");
+    for (size_t i = 0; i < results_len; i++) {
+        BenchResult* r = &results[i];
+        double seconds = r->nsec / 1e9;
+        fprintf(out, "%s\n    { \"suite\": \"%s\", \"name\": \"%s\", \"ops\": %llu, \"bytes\": %llu, "
+                     "\"seconds\": %.6f, \"ops_per_sec\": %.1f, \"bytes_per_sec\": %.1f",
+            i == 0 ? "" : ",", r->suite, r->name, (unsigned long long) r->ops, (unsigned long long) r->bytes,
+            seconds, seconds > 0 ? r->ops / seconds : 0, seconds > 0 ? r->bytes / seconds : 0);
+        if (r->latency) {
+            fprintf(out, ",\n      \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f }",
+                r->p50 / 1e3, r->p99 / 1e3, r->max / 1e3);
+        } else {
+            fprintf(out, " }");
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+static void print_usage(const char* selfpath) {
+    fprintf(stderr,
+        "Usage: %s [-o output.json] [-s GiB] [-S MiB] [-n ops] [-d tmpdir] [-t COLSxLINES]\n"
+        "          [-k keys [-i input] [-f format]] [suite...]\n"
+        "\n"
+        "-o    Write the JSON results to a file instead of stdout.\n"
+        "-s    Size of the files to edit and scan, in GiB (default 4).\n"
+        "-S    Size of the files to save, in MiB (default 256).\n"
+        "-n    Number of operations in each measurement (default 100000, a tenth for the random edits).\n"
+        "-d    Directory for the temporary files (default $TMPDIR or /tmp).\n"
+        "-t    Size of the virtual terminal for the rendering benchmarks (default 120x50).\n"
+        "-k    Keys to replay, recorded with `hedit --record-keys`. The replay suite runs only if given.\n"
+        "-i    File to replay the keys against (default: a synthetic one). Recorded writes modify it!\n"
+        "-f    Format to replay the keys with (default: the guessed one).\n",
+        selfpath
+    );
+}
+
+int main(int argc, char** argv) {
+
+    const char* tmpdir = getenv("TMPDIR");
+    BenchConfig cfg = {
+        .file_size = 4 * GB,
+        .save_size = 256 * MB,
+        .ops = 100000,
+        .tmpdir = tmpdir != NULL ? tmpdir : "/tmp",
+        .term_lines = 50,
+        .term_cols = 120
+    };
+    const char* output = NULL;
+
+    int opt;
+    int n;
+    while ((opt = getopt(argc, argv, "o:s:S:n:d:t:k:i:f:h")) != -1) {
+        switch (opt) {
+            case 'o':
+                output = optarg;
+                break;
+            case 's':
+                if (!str2int(optarg, 10, &n) || n <= 0) {
+                    goto error;
+                }
+                cfg.file_size = n * GB;
+                break;
+            case 'S':
+                if (!str2int(optarg, 10, &n) || n <= 0) {
+                    goto error;
+                }
+                cfg.save_size = n * MB;
+                break;
+            case 'n':
+                if (!str2int(optarg, 10, &n) || n <= 0) {
+                    goto error;
+                }
+                cfg.ops = n;
+                break;
+            case 'd':
+                cfg.tmpdir = optarg;
+                break;
+            case 't':
+                if (sscanf(optarg, "%dx%d", &cfg.term_cols, &cfg.term_lines) != 2 || cfg.term_cols <= 0 || cfg.term_lines <= 2) {
+                    goto error;
+                }
+                break;
+            case 'k':
+                cfg.keys = optarg;
+                break;
+            case 'i':
+                cfg.input = optarg;
+                break;
+            case 'f':
+                cfg.format = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                goto error;
+        }
+    }
+
+    // Run the suites given on the command line, or all of them
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+        bool selected = optind == argc;
+        for (int j = optind; j < argc; j++) {
+            selected |= strcmp(argv[j], suites[i].name) == 0;
+        }
+        if (selected && !suites[i].run(&cfg)) {
+            fprintf(stderr, "The %s suite failed.\n", suites[i].name);
+            ok = false;
+        }
+    }
+
+    // Tear down the editor shared by the suites
+    if (editor != NULL) {
+        hedit_core_teardown(editor);
+    }
+    if (tickit != NULL) {
+        tickit_unref(tickit);
+    }
+
+    FILE* out = stdout;
+    if (output != NULL) {
+        out = fopen(output, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Cannot open %s: %s.\n", output, strerror(errno));
+            return 1;
+        }
+    }
+    print_json(out, &cfg);
+    if (out != stdout) {
+        fclose(out);
+    }
+    for (size_t i = 0; i < results_len; i++) {
+        free(results[i].name);
+    }
+    free(results);
+    return ok ? 0 : 1;
+
+error:
+    print_usage(argv[0]);
+    return 1;
+
+}
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <tickit.h>
+
+#include "bench.h"
+#include "build-config.h"
+#include "core.h"
+#include "util/metrics.h"
+
+#define SUITE "render"
+
+// The formats need the JS integration, without it they would all render like `none`
+static const char* formats[] = {
+    "none",
+#ifdef WITH_V8
+    "luks",
+    "mifare",
+    "string",
+#endif
+    NULL
+};
+
+
+
+static uint64_t histogram_sum(const char* name) {
+    Metric* m = metrics_histogram(name);
+    return m != NULL ? m->sum : 0;
+}
+
+static bool bench_format(const BenchConfig* cfg, HEdit* hedit, const char* format) {
+    if (!hedit_option_set(hedit, "format", format)) {
+        fprintf(stderr, "Cannot switch to format %s.\n", format);
+        return false;
+    }
+
+    // Start from the top of the file, and draw once so that the first frame is not an outlier
+    hedit->view->on_movement(hedit, HEDIT_MOVEMENT_ABSOLUTE, 0);
+    hedit_redraw(hedit);
+    tickit_window_flush(hedit->rootwin);
+
+    // Scroll down one line per frame, and draw the whole view each time
+    size_t frames = cfg->ops / 10;
+    uint64_t js_before = histogram_sum("js.format.time");
+    uint64_t start = bench_now();
+    for (size_t i = 0; i < frames; i++) {
+        hedit_emit_keys(hedit, "<Down>");
+        hedit_redraw_view(hedit);
+        tickit_window_flush(hedit->rootwin);
+    }
+    uint64_t total = bench_now() - start;
+
+    // The time spent in JS is tracked in microseconds by the format metrics
+    uint64_t js = (histogram_sum("js.format.time") - js_before) * 1000;
+    if (js > total) {
+        js = total;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s.frame", format);
+    bench_report(SUITE, name, frames, 0, total);
+    snprintf(name, sizeof(name), "%s.native", format);
+    bench_report(SUITE, name, frames, 0, total - js);
+    snprintf(name, sizeof(name), "%s.js", format);
+    bench_report(SUITE, name, frames, 0, js);
+    return true;
+}
+
+bool bench_render(const BenchConfig* cfg) {
+    HEdit* hedit = bench_editor(cfg);
+    if (hedit == NULL) {
+        return false;
+    }
+    char* path = bench_sparse_file(cfg, cfg->file_size);
+    if (path == NULL) {
+        return false;
+    }
+
+    bool ok = false;
+    File* file = hedit_file_open(path);
+    if (file == NULL || !hedit_buffer_open(hedit, file)) {
+        fprintf(stderr, "Cannot open %s.\n", path);
+        hedit_file_close(file);
+        goto cleanup;
+    }
+
+    ok = true;
+    for (const char** format = formats; *format != NULL; format++) {
+        ok &= bench_format(cfg, hedit, *format);
+    }
+    hedit_buffer_close(hedit);
+
+cleanup:
+    unlink(path);
+    free(path);
+    return ok;
+}
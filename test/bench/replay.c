@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <tickit.h>
+
+#include "bench.h"
+#include "core.h"
+
+#define SUITE "replay"
+
+typedef struct {
+    char** keys;
+    size_t len;
+    size_t capacity;
+} Recording;
+
+
+
+static void free_recording(Recording* rec) {
+    for (size_t i = 0; i < rec->len; i++) {
+        free(rec->keys[i]);
+    }
+    free(rec->keys);
+}
+
+// Each line of a recording is `<usec since start>\t<key>`, as written by `hedit --record-keys`.
+// Only the keys are kept: they are replayed back to back, so that the latency is not
+// hidden by the time the user took between two keys.
+static bool read_recording(const char* path, Recording* rec) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot open %s.\n", path);
+        return false;
+    }
+
+    char* line = NULL;
+    size_t n = 0;
+    ssize_t len;
+    size_t lineno = 0;
+    while ((len = getline(&line, &n, in)) != -1) {
+        lineno++;
+        if (len > 0 && line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        char* key = strchr(line, '\t');
+        if (key == NULL || key[1] == '\0') {
+            fprintf(stderr, "%s:%zu: Expected a timestamp and a key.\n", path, lineno);
+            goto error;
+        }
+
+        if (rec->len == rec->capacity) {
+            size_t capacity = rec->capacity == 0 ? 256 : rec->capacity * 2;
+            char** keys = realloc(rec->keys, capacity * sizeof(char*));
+            if (keys == NULL) {
+                fprintf(stderr, "Out of memory.\n");
+                goto error;
+            }
+            rec->keys = keys;
+            rec->capacity = capacity;
+        }
+        rec->keys[rec->len] = strdup(key + 1);
+        if (rec->keys[rec->len] == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            goto error;
+        }
+        rec->len++;
+    }
+
+    free(line);
+    fclose(in);
+    if (rec->len == 0) {
+        fprintf(stderr, "%s: No keys to replay.\n", path);
+        free_recording(rec);
+        return false;
+    }
+    return true;
+
+error:
+    free(line);
+    fclose(in);
+    free_recording(rec);
+    return false;
+}
+
+bool bench_replay(const BenchConfig* cfg) {
+    // There is nothing sensible to replay by default
+    if (cfg->keys == NULL) {
+        return true;
+    }
+
+    Recording rec = { 0 };
+    if (!read_recording(cfg->keys, &rec)) {
+        return false;
+    }
+
+    char* path = NULL;
+    if (cfg->input == NULL) {
+        path = bench_sparse_file(cfg, cfg->file_size);
+        if (path == NULL) {
+            free_recording(&rec);
+            return false;
+        }
+    }
+
+    bool ok = false;
+    uint64_t* samples = NULL;
+    HEdit* hedit = bench_editor(cfg);
+    if (hedit == NULL) {
+        goto cleanup;
+    }
+
+    const char* input = path != NULL ? path : cfg->input;
+    File* file = hedit_file_open(input);
+    if (file == NULL || !hedit_buffer_open(hedit, file)) {
+        fprintf(stderr, "Cannot open %s.\n", input);
+        hedit_file_close(file);
+        goto cleanup;
+    }
+    if (cfg->format != NULL && !hedit_option_set(hedit, "format", cfg->format)) {
+        fprintf(stderr, "Cannot switch to format %s.\n", cfg->format);
+        goto close;
+    }
+
+    samples = malloc(rec.len * sizeof(uint64_t));
+    if (samples == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        goto close;
+    }
+
+    // Draw once, so that the first key does not pay for the first frame
+    hedit_redraw(hedit);
+    tickit_window_flush(hedit->rootwin);
+
+    // A key is done once the frame it caused has been rendered, like in `on_keypress` followed
+    // by the expose of the next main loop iteration. Timers and `later` callbacks do not run.
+    size_t replayed = 0;
+    for (; replayed < rec.len && !hedit->exit; replayed++) {
+        uint64_t start = bench_now();
+        hedit_emit_keys(hedit, rec.keys[replayed]);
+        tickit_window_flush(hedit->rootwin);
+        samples[replayed] = bench_now() - start;
+    }
+    ok = true;
+    if (replayed < rec.len) {
+        fprintf(stderr, "The replay quit after %zu of %zu keys.\n", replayed, rec.len);
+    }
+
+    // Report under the name of the recording, so that several of them can be compared
+    char* keys = strdup(cfg->keys);
+    if (keys != NULL) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s.key", basename(keys));
+        bench_report_latency(SUITE, name, samples, replayed);
+        free(keys);
+    }
+
+close:
+    hedit_buffer_close(hedit);
+
+cleanup:
+    if (path != NULL) {
+        unlink(path);
+        free(path);
+    }
+    free(samples);
+    free_recording(&rec);
+    return ok;
+}
@@ -1,4 +1,5 @@
 import Format from 'hedit/format';
+import names from 'hedit/private/names';
 
 // Additional assertion for formats
 should.Assertion.add('linearizeTo', function (expected) {
@@ -9,16 +10,16 @@ should.Assertion.add('linearizeTo', function (expected) {
     const g = this.obj.__linearize(
         {
             read(pos, length) {
-                return new Int8Array(Array.from({ length }, (_, i) => i)).buffer;
+                return new DataView(new Int8Array(Array.from({ length }, (_, i) => i)).buffer);
             }
         },
         0,
-        '',
+        0,
         Object.create(null)
     );
     let i = 0;
     for (let curr = g.next(); !curr.done; curr = g.next()) {
-        curr.value.should.deepEqual(expected[i]);
+        withFullName(curr.value).should.deepEqual(expected[i]);
         i++;
     }
 
@@ -29,6 +30,11 @@ function span(name, from, to) {
     return { name, from, to, color: 0 };
 }
 
+// Segments carry the id of their name: replace it with the full name
+function withFullName(seg) {
+    return Object.assign({}, seg, { name: names.path(seg.name) });
+}
+
 
 
 export const EmptyFormatIsValid = () => {
@@ -198,11 +204,11 @@ export const SequenceRepeatsAChildIndefinitely = () => {
     let f = new Format().sequence(c);
 
     // Expand manually the first 100 spans
-    let g = f.__linearize(null, 0, '', Object.create(null));
+    let g = f.__linearize(null, 0, 0, Object.create(null));
     for (let i = 0; i < 100; i++) {
         const curr = g.next();
         curr.done.should.be.false();
-        curr.value.should.deepEqual(span('X', i, i));
+        withFullName(curr.value).should.deepEqual(span('X', i, i));
     }
 };
 
@@ -272,3 +278,98 @@ export const NestedFormatsHaveTheirOwnVariableScope = () => {
         span('Child array', 9, 9 + 0x00010203 - 1)
     ]);
 };
+
+export const LinearizationCanBeResumedFromATrace = () => {
+    const proxy = {
+        read(pos, length) {
+            return new DataView(new Uint8Array(length).fill(2).buffer);
+        }
+    };
+    const string = new Format().uint8('Length', 'white', 'len').array('String', 'len');
+    const f = new Format().uint8('Count', 'white', 'n').array('Strings', 'n', string);
+
+    // Linearize the whole format, saving a copy of the trace after each segment
+    const spans = [];
+    const traces = [];
+    const trace = [];
+    for (let s of f.__linearize(proxy, 0, 0, Object.create(null), trace)) {
+        spans.push(s);
+        traces.push(trace.map(frame => Object.assign({}, frame, { variables: Object.assign({}, frame.variables) })));
+    }
+    spans.should.have.length(5);
+
+    // Resuming from any trace must yield again the same segment and all the following ones
+    traces.forEach((t, i) => {
+        Array.from(f.__linearize(proxy, 0, 0, Object.create(null), null, 0, t))
+            .should.deepEqual(spans.slice(i));
+    });
+};
+
+export const SegmentNamesAreSharedNodes = () => {
+    const c = new Format().uint8('A').uint8('B');
+    const f = new Format().array('Items', 2, c);
+
+    const segs = Array.from(f.__linearize(null, 0, 0, Object.create(null)));
+    segs.should.have.length(4);
+
+    // Repeated segments share the same name node
+    segs[0].name.should.equal(segs[2].name);
+    segs[1].name.should.equal(segs[3].name);
+    segs[0].name.should.not.equal(segs[1].name);
+    names.path(segs[0].name).should.equal('Items > A');
+    names.path(names.parents[segs[0].name]).should.equal('Items');
+};
+
+export const StaticSizeIsKnownOnlyWithoutDataDependentLengths = () => {
+    const block = new Format().uint8('A').uint32('B').array('C', 3);
+    block.__staticSize().should.equal(8);
+    new Format().array('Blocks', 10, block).__staticSize().should.equal(80);
+    (new Format().sequence(block).__staticSize() === null).should.be.true();
+    (new Format().uint8('Length', 'white', 'len').array('Data', 'len').__staticSize() === null).should.be.true();
+};
+
+export const ArraysOfStaticSizeJumpToTheTarget = () => {
+    const block = new Format().uint8('A').uint8('B');
+    const f = new Format().uint8('Header').array('Blocks', 1000, block).uint8('Footer');
+
+    const target = { pos: 1001, jumped: false };
+    const segs = Array.from(f.__linearize(null, 0, 0, Object.create(null), null, 0, null, target));
+    target.jumped.should.be.true();
+
+    // Only the header, the repetition including the target and the following ones are produced
+    segs.map(withFullName).slice(0, 3).should.deepEqual([
+        span('Header', 0, 0),
+        span('Blocks > A', 1001, 1001),
+        span('Blocks > B', 1002, 1002)
+    ]);
+    segs.should.have.length(1 + 2 * 500 + 1);
+    withFullName(segs[segs.length - 1]).should.deepEqual(span('Footer', 2001, 2001));
+};
+
+export const OffsetsAbove4GiBAreExact = () => {
+    const GiB = 1024 * 1024 * 1024;
+    const block = new Format().uint8('A').uint8('B').uint16('C');
+    const f = new Format().uint8('Header').array('Blocks', 2 * GiB, block).uint8('Footer');
+    f.__staticSize().should.equal(8 * GiB + 2);
+
+    // Jump to a repetition past 4GiB and read only its first segments
+    const pos = 5 * GiB + 3;
+    const target = { pos, jumped: false };
+    const g = f.__linearize(null, 0, 0, Object.create(null), null, 0, null, target);
+    const segs = [ g.next().value, g.next().value, g.next().value, g.next().value ].map(withFullName);
+    target.jumped.should.be.true();
+    segs.should.deepEqual([
+        span('Header', 0, 0),
+        span('Blocks > A', pos - 2, pos - 2),
+        span('Blocks > B', pos - 1, pos - 1),
+        span('Blocks > C', pos, pos + 1)
+    ]);
+
+    // Formats can also start past 4GiB
+    const start = 4 * GiB + 7;
+    Array.from(block.__linearize(null, start, 0, Object.create(null))).map(withFullName).should.deepEqual([
+        span('A', start, start),
+        span('B', start + 1, start + 1),
+        span('C', start + 2, start + 3)
+    ]);
+};
@@ -1,6 +1,8 @@
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <regex>
+#include <fstream>
 #include <string.h>
 #include <iostream>
 #include <sstream>
@@ -13,6 +15,8 @@
 #include <v8.h>
 
 #include "js.h"
+#include "util/segindex.h"
+#include "util/nametree.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -237,9 +241,341 @@ static void RunTests(string suite, Local<Module> m) {
 static void EmptyCallback(const FunctionCallbackInfo<v8::Value>& args) {
 }
 
+
+
+// Benchmark mode: each exported function of the benchmark files linearizes some data
+// and returns the number of segments it produced.
+
+struct BenchResult {
+    string suite;
+    string name;
+    double segments;
+    double seconds;
+    double heap_growth;   // Bytes of heap in use after the run, garbage included
+    double heap_retained; // Bytes still in use after a full GC
+    unsigned int gc_count;
+    double gc_pause_ms;
+};
+
+static vector<BenchResult> _bench_results;
+
+// The segment index and the name tree of the editor, for the benchmarks of the format cache.
+// They live until the end of the run.
+static vector<SegmentIndex*> _bench_indexes;
+static NameTree* _bench_names = NULL;
+
+static inline SegmentIndex* UnwrapSegmentIndex(Local<v8::Value> obj) {
+    return (SegmentIndex*) Local<Object>::Cast(obj)->GetAlignedPointerFromInternalField(0);
+}
+
+static inline size_t SizeArg(const FunctionCallbackInfo<v8::Value>& args, int i) {
+    return args[i]->IntegerValue(args.GetIsolate()->GetCurrentContext()).FromJust();
+}
+
+static inline int IntArg(const FunctionCallbackInfo<v8::Value>& args, int i) {
+    return args[i]->Int32Value(args.GetIsolate()->GetCurrentContext()).FromJust();
+}
+
+static void SegindexNew(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<ObjectTemplate> tpl = ObjectTemplate::New(isolate);
+    tpl->SetInternalFieldCount(1);
+    Local<Object> obj = tpl->NewInstance(isolate->GetCurrentContext()).ToLocalChecked();
+    SegmentIndex* index = segindex_new();
+    if (index == NULL) {
+        fatal("Out of memory.\n");
+    }
+    _bench_indexes.push_back(index);
+    obj->SetAlignedPointerInInternalField(0, index);
+    args.GetReturnValue().Set(obj);
+}
+
+static void SegindexAppend(const FunctionCallbackInfo<v8::Value>& args) {
+    if (!segindex_append(UnwrapSegmentIndex(args[0]), SizeArg(args, 1), SizeArg(args, 2), IntArg(args, 3), IntArg(args, 4))) {
+        fatal("Out of memory.\n");
+    }
+}
+
+static void SegindexTruncate(const FunctionCallbackInfo<v8::Value>& args) {
+    segindex_truncate(UnwrapSegmentIndex(args[0]), SizeArg(args, 1));
+}
+
+static void SegindexDrop(const FunctionCallbackInfo<v8::Value>& args) {
+    segindex_drop(UnwrapSegmentIndex(args[0]), SizeArg(args, 1));
+}
+
+static void SegindexFind(const FunctionCallbackInfo<v8::Value>& args) {
+    size_t i = segindex_find(UnwrapSegmentIndex(args[0]), SizeArg(args, 1));
+    args.GetReturnValue().Set(Number::New(args.GetIsolate(), i));
+}
+
+static void SegindexGet(const FunctionCallbackInfo<v8::Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> ctx = isolate->GetCurrentContext();
+    size_t from, to;
+    int color, name;
+    if (!segindex_get(UnwrapSegmentIndex(args[0]), SizeArg(args, 1), &from, &to, &color, &name)) {
+        return;
+    }
+    Local<Object> segment = Object::New(isolate);
+    segment->Set(ctx, v8_str("from"), Number::New(isolate, from)).FromJust();
+    segment->Set(ctx, v8_str("to"), Number::New(isolate, to)).FromJust();
+    segment->Set(ctx, v8_str("color"), Integer::New(isolate, color)).FromJust();
+    segment->Set(ctx, v8_str("name"), Integer::New(isolate, name)).FromJust();
+    args.GetReturnValue().Set(segment);
+}
+
+static void NamesAdd(const FunctionCallbackInfo<v8::Value>& args) {
+    if (_bench_names == NULL && (_bench_names = nametree_new()) == NULL) {
+        fatal("Out of memory.\n");
+    }
+    String::Utf8Value name(args.GetIsolate(), args[1]);
+    if (nametree_add(_bench_names, IntArg(args, 0), c_str(name)) < 0) {
+        fatal("Out of memory.\n");
+    }
+}
+
+// Adds to the fake `__hedit` the native functions behind the format cache, as the editor does.
+// The benchmarks provide the file themselves.
+static void SetupBenchNatives(Local<Context> context, Local<Object> hedit) {
+    hedit->Set(v8_str("segindex_new"), Function::New(context, SegindexNew).ToLocalChecked());
+    hedit->Set(v8_str("segindex_append"), Function::New(context, SegindexAppend).ToLocalChecked());
+    hedit->Set(v8_str("segindex_truncate"), Function::New(context, SegindexTruncate).ToLocalChecked());
+    hedit->Set(v8_str("segindex_drop"), Function::New(context, SegindexDrop).ToLocalChecked());
+    hedit->Set(v8_str("segindex_find"), Function::New(context, SegindexFind).ToLocalChecked());
+    hedit->Set(v8_str("segindex_get"), Function::New(context, SegindexGet).ToLocalChecked());
+    hedit->Set(v8_str("names_add"), Function::New(context, NamesAdd).ToLocalChecked());
+}
+
+static void TeardownBenchNatives() {
+    for (SegmentIndex* index : _bench_indexes) {
+        segindex_free(index);
+    }
+    _bench_indexes.clear();
+    if (_bench_names != NULL) {
+        nametree_free(_bench_names);
+        _bench_names = NULL;
+    }
+}
+static high_resolution_clock::time_point _gc_start;
+static unsigned int _gc_count = 0;
+static double _gc_pause_ms = 0;
+
+static void OnGCPrologue(Isolate* isolate, GCType type, GCCallbackFlags flags) {
+    _gc_start = high_resolution_clock::now();
+}
+
+static void OnGCEpilogue(Isolate* isolate, GCType type, GCCallbackFlags flags) {
+    _gc_count++;
+    _gc_pause_ms += (duration_cast<duration<double, milli>>(high_resolution_clock::now() - _gc_start)).count();
+}
+
+static size_t UsedHeapSize(Isolate* isolate) {
+    HeapStatistics stats;
+    isolate->GetHeapStatistics(&stats);
+    return stats.used_heap_size();
+}
+
+static void RunBenchmarks(string suite, Local<Module> m) {
+    Isolate* isolate = Isolate::GetCurrent();
+    HandleScope handle_scope(isolate);
+    Local<Context> ctx = isolate->GetCurrentContext();
+
+    ReportSuiteBegin(suite);
+
+    Local<Object> obj = Local<Object>::Cast(m->GetModuleNamespace());
+    Local<Array> names = obj->GetOwnPropertyNames(ctx).ToLocalChecked();
+    for (unsigned int i = 0; i < names->Length(); i++) {
+        Local<v8::Value> key = names->Get(ctx, i).ToLocalChecked();
+        String::Utf8Value key_str(isolate, key);
+        Local<Function> bench = Local<Function>::Cast(obj->Get(ctx, key).ToLocalChecked());
+
+        // Start every benchmark from a clean heap, and do not count the GC we just forced
+        isolate->LowMemoryNotification();
+        size_t heap_before = UsedHeapSize(isolate);
+        _gc_count = 0;
+        _gc_pause_ms = 0;
+
+        TryCatch tt;
+        auto start_time = high_resolution_clock::now();
+        Local<v8::Value> ret;
+        bool ok = bench->Call(ctx, Null(isolate), 0, {}).ToLocal(&ret);
+        auto end_time = high_resolution_clock::now();
+        if (!ok) {
+            String::Utf8Value str(isolate, tt.Exception());
+            ReportFailure(c_str(key_str), c_str(str));
+            continue;
+        }
+
+        BenchResult r;
+        r.suite = suite;
+        r.name = c_str(key_str);
+        r.segments = ret->NumberValue(ctx).FromMaybe(0);
+        r.seconds = (duration_cast<duration<double>>(end_time - start_time)).count();
+        r.gc_count = _gc_count;
+        r.gc_pause_ms = _gc_pause_ms;
+        r.heap_growth = (double) UsedHeapSize(isolate) - heap_before;
+        isolate->LowMemoryNotification();
+        r.heap_retained = (double) UsedHeapSize(isolate) - heap_before;
+        _bench_results.push_back(r);
+
+        cout << "    " << PrettifyName(r.name) << " " << TColor(Bold) << TColor(Green)
+             << (r.seconds > 0 ? r.segments / r.seconds : 0) << " segments/s" << TColor(Reset) << TColor(Gray)
+             << " [" << r.segments << " segments in " << r.seconds * 1000 << "ms, heap +" << r.heap_growth / 1024 << "KiB, "
+             << r.gc_count << " GCs in " << r.gc_pause_ms << "ms]" << TColor(Reset) << endl;
+        _total++;
+    }
+
+    ReportSuiteEnd(suite);
+}
+
+static void WriteBenchResults(ostream& out) {
+    out << "{\n  \"results\": [";
+    for (size_t i = 0; i < _bench_results.size(); i++) {
+        BenchResult& r = _bench_results[i];
+        out << (i == 0 ? "" : ",") << "\n    { \"suite\": \"" << r.suite << "\", \"name\": \"" << r.name << "\", "
+            << "\"segments\": " << r.segments << ", \"seconds\": " << r.seconds << ", "
+            << "\"segments_per_sec\": " << (r.seconds > 0 ? r.segments / r.seconds : 0) << ", "
+            << "\"heap_growth\": " << r.heap_growth << ", \"heap_retained\": " << r.heap_retained << ", "
+            << "\"gc_count\": " << r.gc_count << ", \"gc_pause_ms\": " << r.gc_pause_ms << " }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+
+
+// Builtin modules compiled while measuring the startup time from source
+static map<string, Global<Module>> startup_modules;
+
+static MaybeLocal<Module> CompileBuiltinModule(Isolate* isolate, string name) {
+    auto it = startup_modules.find(name);
+    if (it != startup_modules.end()) {
+        return MaybeLocal<Module>(it->second.Get(isolate));
+    }
+
+    shared_ptr<JsBuiltinModule> builtin = JsBuiltinModule::FromName(name);
+    if (builtin == nullptr) {
+        isolate->ThrowException(v8_str(("Cannot resolve module " + name).c_str()));
+        return MaybeLocal<Module>();
+    }
+
+    ScriptOrigin origin = ScriptOrigin(v8_str(("builtin:" + name).c_str()), Local<v8::Integer>(), Local<v8::Integer>(),
+                                       Local<v8::Boolean>(), Local<v8::Integer>(),
+                                       Local<v8::Value>(), Local<v8::Boolean>(),
+                                       Local<v8::Boolean>(), True(isolate));
+    ScriptCompiler::Source source(v8_str(builtin->GetSource(), builtin->GetSourceLen()), origin);
+    Local<Module> m;
+    if (!ScriptCompiler::CompileModule(isolate, &source).ToLocal(&m)) {
+        return MaybeLocal<Module>();
+    }
+    startup_modules[name].Reset(isolate, m);
+    return MaybeLocal<Module>(m);
+}
+
+static MaybeLocal<Module> StartupResolveCallback(Local<Context> ctx, Local<String> specifier, Local<Module> referrer) {
+    Isolate* isolate = Isolate::GetCurrent();
+    String::Utf8Value s(isolate, specifier);
+    return CompileBuiltinModule(isolate, c_str(s));
+}
+
+static double MeasureStartupFromSource(Isolate::CreateParams& create_params) {
+    auto start_time = high_resolution_clock::now();
+
+    Isolate* isolate = Isolate::New(create_params);
+    {
+        Isolate::Scope isolate_scope(isolate);
+        HandleScope handle_scope(isolate);
+        Local<Context> context = Context::New(isolate);
+        Context::Scope context_scope(context);
+
+        // Same fake `__hedit` used for the tests
+        Local<Object> hedit = Object::New(isolate);
+        hedit->Set(v8_str("registerEventBroker"), Function::New(context, EmptyCallback).ToLocalChecked());
+        context->Global()->Set(v8_str("__hedit"), hedit);
+
+        // Evaluate the same modules that end up in the snapshot
+        for (auto& it : JsBuiltinModule::All()) {
+            if (it.first == "hedit/private/__init") {
+                continue;
+            }
+            TryCatch tt;
+            Local<Module> m;
+            if (!CompileBuiltinModule(isolate, it.first).ToLocal(&m) ||
+                m->InstantiateModule(context, StartupResolveCallback).IsNothing() ||
+                m->Evaluate(context).IsEmpty()) {
+                String::Utf8Value str(isolate, tt.Exception());
+                fatal("Exception while evaluating module " + it.first + ": " + c_str(str));
+            }
+        }
+
+        startup_modules.clear();
+    }
+    isolate->Dispose();
+
+    return (duration_cast<duration<double, milli>>(high_resolution_clock::now() - start_time)).count();
+}
+
+static double MeasureStartupFromSnapshot(Isolate::CreateParams& create_params) {
+    auto start_time = high_resolution_clock::now();
+
+    create_params.snapshot_blob = &hedit_js_snapshot;
+    Isolate* isolate = Isolate::New(create_params);
+    {
+        Isolate::Scope isolate_scope(isolate);
+        HandleScope handle_scope(isolate);
+        Context::New(isolate);
+        Context::FromSnapshot(isolate, 0).ToLocalChecked();
+    }
+    isolate->Dispose();
+    create_params.snapshot_blob = nullptr;
+
+    return (duration_cast<duration<double, milli>>(high_resolution_clock::now() - start_time)).count();
+}
+
+// Reports how long it takes to have V8 ready with all the builtin modules evaluated,
+// both from source and from the startup snapshot, so that regressions are noticed.
+static void ReportStartupTime() {
+    Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator = ArrayBuffer::Allocator::NewDefaultAllocator();
+
+    double from_source = MeasureStartupFromSource(create_params);
+    double from_snapshot = MeasureStartupFromSnapshot(create_params);
+
+    cout << TColor(Bold) << "Startup: " << TColor(Reset)
+         << from_source << "ms from source, " << from_snapshot << "ms from snapshot ("
+         << hedit_js_snapshot.raw_size << " bytes)" << endl;
+
+    delete create_params.array_buffer_allocator;
+}
+
+// Evaluates all the files in a directory, and passes the resulting modules to `run`
+static void RunDirectory(string dir_path, void (*run)(string, Local<Module>)) {
+    DIR* dir = opendir(dir_path.c_str());
+    if (dir == NULL) {
+        fatal("Cannot open directory " + dir_path + "\n");
+    }
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_type == DT_REG) {
+            string path = dir_path + "/" + de->d_name;
+            string contents = readwhole(path);
+            Local<Module> m = EvalModule(path.c_str(), contents.c_str(), contents.size()).ToLocalChecked();
+            run(de->d_name, m);
+        }
+    }
+    closedir(dir);
+}
+
 int main(int argc, const char* argv[]) {
 
-    // Grab the paths to should.js and the test folder from the arguments
+    // Usage: hedit_test_js <should.js> <test_dir>
+    //        hedit_test_js --bench <bench_dir> <output.json>
+    bool bench_mode = argc > 1 && string(argv[1]) == "--bench";
+    if (argc < (bench_mode ? 4 : 3)) {
+        cerr << "Usage: " << argv[0] << " <should.js> <test_dir>" << endl
+             << "       " << argv[0] << " --bench <bench_dir> <output.json>" << endl;
+        return 1;
+    }
     string should_js_path = argv[1];
     string test_dir = argv[2];
 
@@ -249,6 +585,10 @@ int main(int argc, const char* argv[]) {
     V8::InitializePlatform(platform);
     V8::Initialize();
 
+    if (!bench_mode) {
+        ReportStartupTime();
+    }
+
     // Create a new Isolate and make it the current one
     Isolate::CreateParams create_params;
     create_params.array_buffer_allocator = ArrayBuffer::Allocator::NewDefaultAllocator();
@@ -268,26 +608,33 @@ int main(int argc, const char* argv[]) {
         hedit->Set(v8_str("registerEventBroker"), Function::New(context, EmptyCallback).ToLocalChecked());
         context->Global()->Set(v8_str("__hedit"), hedit);
 
-        // Parse should.js
-        string should_js_contents = readwhole(should_js_path);
-        EvalModule(should_js_path.c_str(), should_js_contents.c_str(), should_js_contents.size()).ToLocalChecked();
+        if (bench_mode) {
 
-        auto start_time = high_resolution_clock::now();
+            // Track the time spent in GC during each benchmark
+            isolate->AddGCPrologueCallback(OnGCPrologue);
+            isolate->AddGCEpilogueCallback(OnGCEpilogue);
 
-        // Cycle all the test files
-        DIR* dir = opendir(test_dir.c_str());
-        struct dirent* de;
-        while ((de = readdir(dir)) != NULL) {
-            if (de->d_type == DT_REG) {
-                string path = test_dir + "/" + de->d_name;
-                string contents = readwhole(path);
-                Local<Module> m = EvalModule(path.c_str(), contents.c_str(), contents.size()).ToLocalChecked();
-                RunTests(de->d_name, m);
-            }
-        }
-        closedir(dir);
+            SetupBenchNatives(context, hedit);
+            RunDirectory(test_dir, RunBenchmarks);
+            TeardownBenchNatives();
+
+            ofstream out(argv[3]);
+            WriteBenchResults(out);
+
+        } else {
+
+            // Parse should.js
+            string should_js_contents = readwhole(should_js_path);
+            EvalModule(should_js_path.c_str(), should_js_contents.c_str(), should_js_contents.size()).ToLocalChecked();
 
-        ReportFinalResults(start_time, high_resolution_clock::now());
+            auto start_time = high_resolution_clock::now();
+
+            // Cycle all the test files
+            RunDirectory(test_dir, RunTests);
+
+            ReportFinalResults(start_time, high_resolution_clock::now());
+
+        }
     }
  
     // Dispose the isolate and tear down V8.
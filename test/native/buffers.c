@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "core.h"
+#include "file.h"
+#include "editor.h"
+#include "ctest.h"
+
+
+static const char* format_option(HEdit* hedit) {
+    return hedit_option_get(hedit, "format")->value.str;
+}
+
+
+
+CTEST(buffers, open_activates_the_new_buffer) {
+    HEdit* hedit = test_editor();
+    ASSERT_NULL(hedit_buffer_current(hedit));
+    ASSERT_NULL(hedit->file);
+
+    File* a = test_editor_open(hedit, "a", 1);
+    ASSERT_EQUAL(1, hedit->buffers_len);
+    ASSERT_TRUE(hedit->file == a);
+
+    File* b = test_editor_open(hedit, "bb", 2);
+    ASSERT_EQUAL(2, hedit->buffers_len);
+    ASSERT_EQUAL(1, hedit->current_buffer);
+    ASSERT_TRUE(hedit->file == b);
+    ASSERT_TRUE(hedit_buffer_current(hedit)->file == b);
+    ASSERT_TRUE(hedit->buffers[0]->file == a);
+    ASSERT_EQUAL(HEDIT_VIEW_EDIT, hedit->view->id);
+}
+
+CTEST(buffers, switch_activates_the_buffer) {
+    HEdit* hedit = test_editor();
+    File* a = test_editor_open(hedit, "a", 1);
+    File* b = test_editor_open(hedit, "bb", 2);
+
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    ASSERT_EQUAL(0, hedit->current_buffer);
+    ASSERT_TRUE(hedit->file == a);
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    ASSERT_TRUE(hedit->file == a);
+
+    ASSERT_FALSE(hedit_buffer_switch(hedit, 2));
+    ASSERT_TRUE(hedit->file == a);
+
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 1));
+    ASSERT_TRUE(hedit->file == b);
+}
+
+CTEST(buffers, switch_stashes_and_restores_the_document_state) {
+    HEdit* hedit = test_editor();
+
+    // The first one is guessed as `string` from its magic
+    test_editor_open(hedit, "\x0a" "0123456789", 11);
+    Document* a = hedit->buffers[0];
+    Format* format = hedit->format;
+    ASSERT_STR("string", format_option(hedit));
+    ASSERT_NOT_NULL(format);
+    ASSERT_NULL(a->format);
+    ASSERT_NULL(a->format_name);
+
+    // The state of the document in background moves into it
+    test_editor_open(hedit, "hello", 5);
+    Document* b = hedit->buffers[1];
+    ASSERT_STR("none", format_option(hedit));
+    ASSERT_TRUE(hedit->format != format);
+    ASSERT_TRUE(a->format == format);
+    ASSERT_STR("string", a->format_name);
+
+    // And back when it is active again
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    ASSERT_STR("string", format_option(hedit));
+    ASSERT_TRUE(hedit->format == format);
+    ASSERT_NULL(a->format);
+    ASSERT_NULL(a->format_name);
+    ASSERT_NOT_NULL(b->format);
+    ASSERT_STR("none", b->format_name);
+
+    // Each document keeps its own format
+    ASSERT_TRUE(hedit_option_set(hedit, "format", "none"));
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 1));
+    ASSERT_TRUE(hedit_option_set(hedit, "format", "string"));
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    ASSERT_STR("none", format_option(hedit));
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 1));
+    ASSERT_STR("string", format_option(hedit));
+}
+
+CTEST(buffers, close_activates_the_next_buffer) {
+    HEdit* hedit = test_editor();
+    File* a = test_editor_open(hedit, "a", 1);
+    test_editor_open(hedit, "bb", 2);
+    File* c = test_editor_open(hedit, "ccc", 3);
+
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 1));
+    hedit_buffer_close(hedit);
+    ASSERT_EQUAL(2, hedit->buffers_len);
+    ASSERT_EQUAL(1, hedit->current_buffer);
+    ASSERT_TRUE(hedit->file == c);
+
+    // Closing the last one goes back to the previous
+    hedit_buffer_close(hedit);
+    ASSERT_EQUAL(1, hedit->buffers_len);
+    ASSERT_EQUAL(0, hedit->current_buffer);
+    ASSERT_TRUE(hedit->file == a);
+
+    hedit_buffer_close(hedit);
+    ASSERT_EQUAL(0, hedit->buffers_len);
+    ASSERT_NULL(hedit_buffer_current(hedit));
+    ASSERT_NULL(hedit->file);
+    ASSERT_NULL(hedit->format);
+    ASSERT_EQUAL(HEDIT_VIEW_SPLASH, hedit->view->id);
+
+    // Closing with no buffers is a no-op
+    hedit_buffer_close(hedit);
+    ASSERT_EQUAL(0, hedit->buffers_len);
+}
@@ -0,0 +1,78 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <tickit.h>
+
+#include "editor.h"
+#include "actions.h"
+#include "options.h"
+#include "file.h"
+#include "ctest.h"
+
+static HEdit* editor = NULL;
+static Options options = { 0 };
+
+static void discard_output(TickitTerm* tt, const char* bytes, size_t len, void* user) {
+}
+
+static int stop_editor(Tickit* t, TickitEventFlags flags, void* user) {
+    tickit_stop(t);
+    return 1;
+}
+
+HEdit* test_editor() {
+    if (editor == NULL) {
+
+        // Keep the configuration of whoever runs the tests out of the way, and load `heditrc.js` instead
+        char home[] = "/tmp/hedit-test-XXXXXX";
+        ASSERT_NOT_NULL(mkdtemp(home));
+        setenv("HOME", home, 1);
+        char rc[64];
+        snprintf(rc, sizeof(rc), "%s/.heditrc", home);
+        ASSERT_EQUAL(0, symlink(TEST_NATIVE_DIR "/heditrc.js", rc));
+
+        TickitTerm* tt = tickit_term_new_for_termtype("xterm");
+        ASSERT_NOT_NULL(tt);
+        tickit_term_set_output_func(tt, discard_output, NULL);
+
+        // The event loop waits on the input, which never comes: keep the write end open for that
+        int input[2];
+        ASSERT_EQUAL(0, pipe(input));
+        tickit_term_set_input_fd(tt, input[0]);
+        tickit_term_set_size(tt, 25, 80);
+        Tickit* tickit = tickit_new_for_term(tt);
+        ASSERT_NOT_NULL(tickit);
+
+        ASSERT_TRUE(hedit_init_actions());
+        editor = hedit_core_init(&options, tickit);
+        ASSERT_NOT_NULL(editor);
+        unlink(rc);
+        rmdir(home);
+    }
+
+    while (hedit_buffer_current(editor) != NULL) {
+        hedit_buffer_close(editor);
+    }
+    return editor;
+}
+
+void test_editor_run(HEdit* hedit, int msec) {
+    tickit_timer_after_msec(hedit->tickit, msec, 0, stop_editor, NULL);
+    tickit_run(hedit->tickit);
+}
+
+File* test_editor_open(HEdit* hedit, const void* data, size_t len) {
+    char path[] = "/tmp/hedit-test-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQUAL(len, write(fd, data, len));
+    close(fd);
+
+    // The contents stay mapped after the file is gone
+    File* file = hedit_file_open(path);
+    unlink(path);
+    ASSERT_NOT_NULL(file);
+    ASSERT_TRUE(hedit_buffer_open(hedit, file));
+    return file;
+}
@@ -0,0 +1,24 @@
+#ifndef __TEST_EDITOR_H__
+#define __TEST_EDITOR_H__
+
+#include <stdlib.h>
+
+#include "core.h"
+
+
+/**
+ * Returns an editor running on a virtual terminal, with no buffer open.
+ * The editor is created on first use and shared by all the tests, because V8 cannot be initialized twice:
+ * the buffers left open by the previous test are closed every time.
+ * Its user configuration is `heditrc.js`, which registers the commands used to run checks in JS.
+ */
+HEdit* test_editor();
+
+/** Runs the event loop of the editor for `msec` milliseconds, so that its timers fire. */
+void test_editor_run(HEdit* hedit, int msec);
+
+/** Opens a new buffer with the given contents, backed by a temporary file, and makes it the active one. */
+File* test_editor_open(HEdit* hedit, const void* data, size_t len);
+
+
+#endif
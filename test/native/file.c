@@ -1,4 +1,7 @@
+#include <unistd.h>
+
 #include "file.h"
+#include "util/metrics.h"
 #include "ctest.h"
 
 
@@ -262,5 +265,82 @@ CTEST2(file, iterator_can_iter_portions_of_pieces) {
     ASSERT_FILE2("ld", data->file, 9, 2);
 }
 
+CTEST2(file, only_the_last_modified_piece_is_unstable) {
+    const unsigned char* chunk;
+    size_t chunk_size;
+
+    hedit_file_insert(data->file, 0, "hello", 5);
+    FileIterator* it = hedit_file_iter(data->file, 0, 5);
+    ASSERT_TRUE(hedit_file_iter_next(it, &chunk, &chunk_size));
+    ASSERT_FALSE(hedit_file_iter_stable(it));
+    hedit_file_iter_free(it);
+
+    hedit_file_commit_revision(data->file);
+    hedit_file_insert(data->file, 0, "<", 1);
+    it = hedit_file_iter(data->file, 0, 6);
+    ASSERT_TRUE(hedit_file_iter_next(it, &chunk, &chunk_size));
+    ASSERT_DATA("<", 1, chunk, chunk_size);
+    ASSERT_FALSE(hedit_file_iter_stable(it));
+    ASSERT_TRUE(hedit_file_iter_next(it, &chunk, &chunk_size));
+    ASSERT_DATA("hello", 5, chunk, chunk_size);
+    ASSERT_TRUE(hedit_file_iter_stable(it));
+    hedit_file_iter_free(it);
+}
+
+CTEST(file, metrics_track_the_piece_chain) {
+    Metric* pieces = metrics_counter("file.pieces");
+    Metric* malloc_bytes = metrics_counter("file.blocks.malloc_bytes");
+    Metric* revisions = metrics_counter("file.revisions");
+    int64_t pieces_before = pieces->value;
+    int64_t malloc_bytes_before = malloc_bytes->value;
+    int64_t revisions_before = revisions->value;
+
+    File* file = hedit_file_open(NULL);
+    ASSERT_NOT_NULL(file);
+    ASSERT_TRUE(hedit_file_insert(file, 0, "hello", 5));
+    ASSERT_TRUE(hedit_file_commit_revision(file));
+    ASSERT_TRUE(pieces->value > pieces_before);
+    ASSERT_TRUE(malloc_bytes->value > malloc_bytes_before);
+    ASSERT_TRUE(revisions->value > revisions_before);
+
+    // Everything is released with the file
+    hedit_file_close(file);
+    ASSERT_EQUAL(pieces_before, pieces->value);
+    ASSERT_EQUAL(malloc_bytes_before, malloc_bytes->value);
+    ASSERT_EQUAL(revisions_before, revisions->value);
+}
+
+CTEST(file, offsets_over_4gib) {
+
+    // A sparse file takes no space on disk, but its offsets do not fit in 32 bits
+    const size_t size = (size_t) 5 * 1024 * 1024 * 1024;
+    const size_t offset = size - 16;
+    char path[] = "/tmp/hedit-test-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQUAL(0, ftruncate(fd, size));
+    ASSERT_EQUAL(5, pwrite(fd, "hello", 5, offset));
+    close(fd);
+
+    File* file = hedit_file_open(path);
+    ASSERT_NOT_NULL(file);
+    ASSERT_EQUAL(size, hedit_file_size(file));
+    ASSERT_FILE2("hello", file, offset, 5);
+
+    ASSERT_TRUE(hedit_file_insert(file, offset + 5, " world", 6));
+    ASSERT_EQUAL(size + 6, hedit_file_size(file));
+    ASSERT_FILE2("hello world", file, offset, 11);
+
+    ASSERT_TRUE(hedit_file_delete(file, offset, 6));
+    ASSERT_FILE2("world", file, offset, 5);
+
+    unsigned char c;
+    ASSERT_TRUE(hedit_file_read_byte(file, offset + 4, &c));
+    ASSERT_EQUAL('d', c);
+
+    hedit_file_close(file);
+    unlink(path);
+}
+
 
 #pragma GCC diagnostic pop
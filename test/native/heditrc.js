@@ -0,0 +1,63 @@
+// User configuration of the editor shared by the native tests, see `editor.c`.
+// Each command checks something that can only be observed from JS, and throws if it does not hold,
+// so that the native test running it with `hedit_command_exec` fails.
+
+import hedit from 'hedit';
+import file from 'hedit/file';
+import Format, { registerFormat } from 'hedit/format';
+
+function check(cond, message) {
+    if (!cond) {
+        throw new Error(message);
+    }
+}
+
+// Chunks kept across commands, to check that they are detached later
+let chunks = [];
+
+// Expects a file with 5 bytes, fresh from disk
+hedit.registerCommand('test-chunks-write', () => {
+    check(file.insert(0, 'ab'), 'Cannot insert.');
+    chunks = file.chunks(0, file.size);
+    check(chunks.length === 2, `Expected 2 chunks, got ${chunks.length}.`);
+    check(chunks[0].byteLength === 2 && chunks[1].byteLength === 5, 'Unexpected chunk sizes.');
+
+    // Writing to the chunks does not change the file
+    for (const chunk of chunks) {
+        new Uint8Array(chunk)[0] = 0x21;
+    }
+    const bytes = new Uint8Array(file.read(0, file.size));
+    check(bytes[0] === 0x61 && bytes[2] === 0x68, 'Writing to a chunk changed the file.');
+
+    // The inserted data is extended in place by the next insertion, while the mapped file never changes
+    check(file.insert(2, 'c'), 'Cannot insert.');
+    check(chunks[0].byteLength === 0, 'The chunk of the inserted data is still attached.');
+    check(chunks[1].byteLength === 5, 'The chunk of the mapped file has been detached.');
+});
+
+// Expects the file of `test-chunks-write` to be closed
+hedit.registerCommand('test-chunks-closed', () => {
+    for (const chunk of chunks) {
+        check(chunk.byteLength === 0, 'A chunk is still attached after closing the file.');
+    }
+    chunks = [];
+});
+
+// Never returns, so that the watchdog has to terminate it
+hedit.registerCommand('test-loop', () => {
+    for (;;) {}
+});
+
+// Checks that JS still runs
+hedit.registerCommand('test-alive', () => {});
+
+// A format whose linearization never returns
+registerFormat('test-loop', new Format().array('Loop', () => {
+    for (;;) {}
+}));
+
+// Checks that `hedit.get` sees the current value of an option, even after a change made from the native side
+hedit.registerCommand('test-option', (name, expected = '') => {
+    const value = String(hedit.get(name));
+    check(value === expected, `Expected ${name} to be '${expected}', got '${value}'.`);
+});
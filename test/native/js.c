@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "core.h"
+#include "commands.h"
+#include "format.h"
+#include "file.h"
+#include "editor.h"
+#include "ctest.h"
+
+
+/** Returns the length of the segment after the first one of the active format. */
+static size_t second_segment_len(HEdit* hedit) {
+    FormatIterator* it = hedit_format_iter(hedit->format);
+    ASSERT_NOT_NULL(hedit_format_iter_seek(it, 0));
+    FormatSegment* segment = hedit_format_iter_next(it);
+    ASSERT_NOT_NULL(segment);
+    size_t len = segment->to - segment->from;
+    hedit_format_iter_free(it);
+    return len;
+}
+
+/** Runs one of the checks registered by `heditrc.js`. */
+static bool check(HEdit* hedit, const char* name) {
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "%s", name);
+    return hedit_command_exec(hedit, cmd);
+}
+
+
+
+CTEST(js, chunks_are_copies_and_detached) {
+    HEdit* hedit = test_editor();
+    test_editor_open(hedit, "hello", 5);
+    ASSERT_TRUE(check(hedit, "test-chunks-write"));
+
+    hedit_buffer_close(hedit);
+    ASSERT_TRUE(check(hedit, "test-chunks-closed"));
+}
+
+CTEST(js, watchdog_terminates_commands) {
+    HEdit* hedit = test_editor();
+    ASSERT_TRUE(hedit_option_set(hedit, "scripttimeout", "100"));
+
+    ASSERT_FALSE(check(hedit, "test-loop"));
+    ASSERT_TRUE(check(hedit, "test-alive"));
+
+    ASSERT_TRUE(hedit_option_set(hedit, "scripttimeout", "2000"));
+}
+
+CTEST(js, watchdog_terminates_the_format_of_its_document_only) {
+    HEdit* hedit = test_editor();
+    ASSERT_TRUE(hedit_option_set(hedit, "scripttimeout", "100"));
+
+    // The first one is guessed as `string` from its magic
+    test_editor_open(hedit, "\x0a" "0123456789", 11);
+    test_editor_open(hedit, "hello", 5);
+    ASSERT_TRUE(hedit_option_set(hedit, "format", "test-loop"));
+
+    // The format is terminated, and not called anymore
+    FormatIterator* it = hedit_format_iter(hedit->format);
+    ASSERT_NULL(hedit_format_iter_seek(it, 0));
+    hedit_format_iter_free(it);
+    it = hedit_format_iter(hedit->format);
+    ASSERT_NULL(hedit_format_iter_seek(it, 0));
+    hedit_format_iter_free(it);
+
+    // While the format of the other document still works, and does not get the fallback
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    test_editor_run(hedit, 50);
+    it = hedit_format_iter(hedit->format);
+    ASSERT_NOT_NULL(hedit_format_iter_seek(it, 0));
+    hedit_format_iter_free(it);
+    ASSERT_STR("string", hedit_option_get(hedit, "format")->value.str);
+
+    // The fallback is applied once its document is active again, and JS keeps running
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 1));
+    ASSERT_STR("test-loop", hedit_option_get(hedit, "format")->value.str);
+    test_editor_run(hedit, 50);
+    ASSERT_STR("none", hedit_option_get(hedit, "format")->value.str);
+    ASSERT_TRUE(check(hedit, "test-option format none"));
+    ASSERT_TRUE(check(hedit, "test-alive"));
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    ASSERT_STR("string", hedit_option_get(hedit, "format")->value.str);
+
+    // A new format starts afresh
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 1));
+    ASSERT_TRUE(hedit_option_set(hedit, "format", "string"));
+    it = hedit_format_iter(hedit->format);
+    ASSERT_NOT_NULL(hedit_format_iter_seek(it, 0));
+    hedit_format_iter_free(it);
+
+    ASSERT_TRUE(hedit_option_set(hedit, "scripttimeout", "2000"));
+}
+
+CTEST(js, option_values_follow_the_native_changes) {
+    HEdit* hedit = test_editor();
+
+    // The first one is guessed as `string` from its magic
+    test_editor_open(hedit, "\x0a" "0123456789", 11);
+    ASSERT_TRUE(check(hedit, "test-option format string"));
+    test_editor_open(hedit, "hello", 5);
+    ASSERT_TRUE(check(hedit, "test-option format none"));
+
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    ASSERT_TRUE(check(hedit, "test-option format string"));
+    ASSERT_TRUE(hedit_option_set(hedit, "format", "none"));
+    ASSERT_TRUE(check(hedit, "test-option format none"));
+    ASSERT_TRUE(hedit_option_set(hedit, "scripttimeout", "1000"));
+    ASSERT_TRUE(check(hedit, "test-option scripttimeout 1000"));
+    ASSERT_TRUE(hedit_option_set(hedit, "scripttimeout", "2000"));
+
+    // Closing the last buffer leaves no format
+    hedit_buffer_close(hedit);
+    ASSERT_TRUE(check(hedit, "test-option format none"));
+    hedit_buffer_close(hedit);
+    ASSERT_TRUE(check(hedit, "test-option format"));
+}
+
+CTEST(js, format_caches_follow_the_changes_in_background) {
+    HEdit* hedit = test_editor();
+
+    // A `string` of 10 bytes, read once so that it is in the cache
+    File* a = test_editor_open(hedit, "\x0a" "0123456789ab", 13);
+    ASSERT_STR("string", hedit_option_get(hedit, "format")->value.str);
+    size_t len = second_segment_len(hedit);
+
+    // Shorten it to 4 bytes while another buffer is active, like a server client would
+    test_editor_open(hedit, "hello", 5);
+    ASSERT_TRUE(hedit_file_replace(a, 0, (const unsigned char*) "\x04", 1));
+
+    ASSERT_TRUE(hedit_buffer_switch(hedit, 0));
+    ASSERT_EQUAL(len - 6, second_segment_len(hedit));
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "ctest.h"
+
+static int formatted_args = 0;
+static char last_text[128];
+static log_severity last_severity;
+
+static int format_arg() {
+    formatted_args++;
+    return 42;
+}
+
+static void collect(void* user, const struct log_message* message) {
+    int* count = user;
+    (*count)++;
+    last_severity = message->severity;
+    strncpy(last_text, message->text, sizeof(last_text));
+    last_text[sizeof(last_text) - 1] = '\0';
+}
+
+CTEST(log, sinks_receive_formatted_messages) {
+    int count = 0;
+    void* token = log_register_sink(collect, LOG_DEBUG, &count);
+    ASSERT_NOT_NULL(token);
+
+    log_warn("Value %d, %s.", 42, "text");
+    ASSERT_EQUAL(1, count);
+    ASSERT_EQUAL(LOG_WARN, last_severity);
+    ASSERT_STR("Value 42, text.", last_text);
+
+    log_unregister_sink(token);
+    log_warn("Ignored.");
+    ASSERT_EQUAL(1, count);
+}
+
+static void measure(void* user, const struct log_message* message) {
+    size_t* len = user;
+    *len = strlen(message->text);
+}
+
+CTEST(log, sinks_receive_long_messages_in_full) {
+    char long_text[2000];
+    memset(long_text, 'a', sizeof(long_text) - 1);
+    long_text[sizeof(long_text) - 1] = '\0';
+
+    size_t len = 0;
+    void* token = log_register_sink(measure, LOG_DEBUG, &len);
+    log_info("%s.", long_text);
+    ASSERT_EQUAL(sizeof(long_text), len);
+    log_unregister_sink(token);
+}
+
+CTEST(log, sinks_receive_the_messages_of_their_min_severity) {
+    int count = 0;
+    void* token = log_register_sink(collect, LOG_WARN, &count);
+
+    log_info("Ignored.");
+    ASSERT_EQUAL(0, count);
+    log_warn("Received.");
+    ASSERT_EQUAL(1, count);
+    ASSERT_STR("Received.", last_text);
+
+    log_unregister_sink(token);
+}
+
+CTEST(log, sinks_ignore_the_min_severity_of_the_destination) {
+    int count = 0;
+    void* token = log_register_sink(collect, LOG_DEBUG, &count);
+
+    log_min_severity(LOG_ERROR);
+    log_debug("Received.");
+    ASSERT_EQUAL(1, count);
+    ASSERT_EQUAL(LOG_DEBUG, last_severity);
+
+    log_quiet(true);
+    log_info("Received.");
+    ASSERT_EQUAL(2, count);
+
+    log_quiet(false);
+    log_min_severity(LOG_DEBUG);
+    log_unregister_sink(token);
+}
+
+CTEST(log, messages_below_the_min_severity_are_not_formatted) {
+    int count = 0;
+    void* token = log_register_sink(collect, LOG_INFO, &count);
+    formatted_args = 0;
+
+    // Nobody wants the debug messages
+    log_min_severity(LOG_WARN);
+    log_debug("Value %d.", format_arg());
+    ASSERT_EQUAL(0, formatted_args);
+    ASSERT_EQUAL(0, count);
+
+    // While the sink wants the info ones
+    log_info("Value %d.", format_arg());
+    ASSERT_EQUAL(1, formatted_args);
+    ASSERT_EQUAL(1, count);
+
+    // And it is the lowest minimum severity that counts
+    log_unregister_sink(token);
+    log_info("Value %d.", format_arg());
+    ASSERT_EQUAL(1, formatted_args);
+
+    log_quiet(true);
+    log_error("Value %d.", format_arg());
+    ASSERT_EQUAL(1, formatted_args);
+
+    log_quiet(false);
+    log_min_severity(LOG_DEBUG);
+}
+
+CTEST(log, the_writer_outputs_all_the_messages_in_order) {
+    char path[] = "/tmp/hedit-log-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    FILE* out = fdopen(fd, "w");
+    ASSERT_NOT_NULL(out);
+
+    log_init();
+    log_destination(out);
+    log_quiet(false);
+    log_colored(false);
+
+    // Fewer than the ring can hold, so that none of them is dropped
+    for (int i = 0; i < 500; i++) {
+        log_info("Message #%d.", i);
+    }
+    log_teardown();
+
+    FILE* in = fopen(path, "r");
+    unlink(path);
+    ASSERT_NOT_NULL(in);
+    char line[256];
+    char expected[32];
+    int i = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        snprintf(expected, sizeof(expected), "Message #%d.\n", i);
+        ASSERT_NOT_NULL(strstr(line, " INFO  "));
+        ASSERT_STR(expected, strstr(line, "Message #"));
+        i++;
+    }
+    fclose(in);
+    ASSERT_EQUAL(500, i);
+}
+
+CTEST(log, the_writer_truncates_long_messages) {
+    char path[] = "/tmp/hedit-log-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    FILE* out = fdopen(fd, "w");
+    ASSERT_NOT_NULL(out);
+
+    log_init();
+    log_destination(out);
+    log_quiet(false);
+    log_colored(false);
+
+    char long_text[2000];
+    memset(long_text, 'a', sizeof(long_text) - 1);
+    long_text[sizeof(long_text) - 1] = '\0';
+    log_info("%s", long_text);
+    log_info("Next.");
+    log_teardown();
+
+    FILE* in = fopen(path, "r");
+    unlink(path);
+    ASSERT_NOT_NULL(in);
+    char line[4096];
+    ASSERT_NOT_NULL(fgets(line, sizeof(line), in));
+    ASSERT_EQUAL(479, (int) strspn(strstr(line, "aaa"), "a"));
+    ASSERT_NOT_NULL(fgets(line, sizeof(line), in));
+    ASSERT_NOT_NULL(strstr(line, "Next.\n"));
+    fclose(in);
+}
@@ -0,0 +1,62 @@
+#include <string.h>
+
+#include "util/metrics.h"
+#include "ctest.h"
+
+CTEST(metrics, metrics_are_created_once_by_name) {
+    Metric* m = metrics_counter("test.once");
+    ASSERT_NOT_NULL(m);
+    ASSERT_STR("test.once", m->name);
+    ASSERT_TRUE(m == metrics_counter("test.once"));
+
+    // A name cannot be used for metrics of different types
+    ASSERT_NULL(metrics_histogram("test.once"));
+}
+
+CTEST(metrics, counters_go_up_and_down) {
+    Metric* m = metrics_counter("test.counter");
+    metrics_add(m, 5);
+    metrics_add(m, -2);
+    ASSERT_EQUAL(3, m->value);
+
+    // Updating a NULL metric does nothing
+    metrics_add(NULL, 1);
+    metrics_observe(NULL, 1);
+}
+
+CTEST(metrics, histograms_estimate_quantiles) {
+    Metric* m = metrics_histogram("test.histogram");
+    ASSERT_EQUAL(0, metrics_quantile(m, 0.5));
+
+    for (int i = 0; i < 99; i++) {
+        metrics_observe(m, 10);
+    }
+    metrics_observe(m, 5000);
+
+    ASSERT_EQUAL(100, m->count);
+    ASSERT_EQUAL(99 * 10 + 5000, m->sum);
+    ASSERT_EQUAL(5000, m->max);
+
+    // Quantiles are rounded up to the next power of two
+    ASSERT_EQUAL(15, metrics_quantile(m, 0.5));
+    ASSERT_EQUAL(15, metrics_quantile(m, 0.9));
+    ASSERT_EQUAL(5000, metrics_quantile(m, 0.999));
+}
+
+static bool collect_names(Metric* m, void* user) {
+    char* names = user;
+    if (strncmp(m->name, "test.order.", 11) == 0) {
+        strcat(names, m->name + 11);
+    }
+    return true;
+}
+
+CTEST(metrics, iteration_is_in_name_order) {
+    metrics_counter("test.order.b");
+    metrics_histogram("test.order.c");
+    metrics_counter("test.order.a");
+
+    char names[16] = "";
+    metrics_iterate(collect_names, names);
+    ASSERT_STR("abc", names);
+}
@@ -0,0 +1,49 @@
+#include <string.h>
+
+#include "util/nametree.h"
+#include "ctest.h"
+
+CTEST_DATA(nametree) {
+    NameTree* tree;
+};
+
+CTEST_SETUP(nametree) {
+    data->tree = nametree_new();
+    ASSERT_NOT_NULL(data->tree);
+}
+
+CTEST_TEARDOWN(nametree) {
+    nametree_free(data->tree);
+}
+
+CTEST2(nametree, root_has_an_empty_name) {
+    char buf[16];
+    ASSERT_EQUAL(1, nametree_len(data->tree));
+    nametree_path(data->tree, 0, " > ", buf, sizeof(buf));
+    ASSERT_STR("", buf);
+}
+
+CTEST2(nametree, path_joins_all_the_ancestors) {
+    int header = nametree_add(data->tree, 0, "Header");
+    int magic = nametree_add(data->tree, header, "Magic");
+    int body = nametree_add(data->tree, 0, "Body");
+    ASSERT_EQUAL(1, header);
+    ASSERT_EQUAL(2, magic);
+    ASSERT_EQUAL(3, body);
+
+    char buf[64];
+    nametree_path(data->tree, magic, " > ", buf, sizeof(buf));
+    ASSERT_STR("Header > Magic", buf);
+    nametree_path(data->tree, body, " > ", buf, sizeof(buf));
+    ASSERT_STR("Body", buf);
+}
+
+CTEST2(nametree, path_is_truncated) {
+    int a = nametree_add(data->tree, 0, "Header");
+    int b = nametree_add(data->tree, a, "Magic");
+
+    char buf[10];
+    nametree_path(data->tree, b, " > ", buf, sizeof(buf));
+    ASSERT_STR("Header > ", buf);
+    ASSERT_EQUAL(9, strlen(buf));
+}
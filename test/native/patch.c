@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "patch.h"
+#include "ctest.h"
+
+
+// Silence warnings about pointer signs.
+// String literals are char*, while most of the File API wants const char*.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-sign"
+
+
+static void write_temp(char* path, const unsigned char* data, size_t len) {
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQUAL(len, write(fd, data, len));
+    close(fd);
+}
+
+static void ASSERT_CONTENTS(const unsigned char* expected, size_t len, File* file) {
+    ASSERT_EQUAL(len, hedit_file_size(file));
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c;
+        ASSERT_TRUE(hedit_file_read_byte(file, i, &c));
+        ASSERT_EQUAL(expected[i], c);
+    }
+}
+
+
+
+CTEST_DATA(patch) {
+    char original[32];
+    char patch[32];
+    File* file;
+};
+
+CTEST_SETUP(patch) {
+    strcpy(data->original, "/tmp/hedit-test-XXXXXX");
+    strcpy(data->patch, "/tmp/hedit-test-XXXXXX");
+    write_temp(data->original, "hello world", 11);
+    write_temp(data->patch, "", 0);
+    data->file = hedit_file_open(data->original);
+    ASSERT_NOT_NULL(data->file);
+}
+
+CTEST_TEARDOWN(patch) {
+    hedit_file_close(data->file);
+    unlink(data->original);
+    unlink(data->patch);
+}
+
+
+
+CTEST2(patch, apply_records_and_rle) {
+    const unsigned char ips[] =
+        "PATCH"
+        "\x00\x00\x00" "\x00\x05" "HELLO"
+        "\x00\x00\x0B" "\x00\x00" "\x00\x03" "!"
+        "EOF";
+    unlink(data->patch);
+    FILE* f = fopen(data->patch, "wb");
+    fwrite(ips, 1, sizeof(ips) - 1, f);
+    fclose(f);
+
+    ASSERT_TRUE(hedit_patch_apply(data->file, data->patch));
+    ASSERT_CONTENTS("HELLO world!!!", 14, data->file);
+
+    // The whole patch is a single revision
+    size_t pos;
+    ASSERT_TRUE(hedit_file_undo(data->file, &pos));
+    ASSERT_CONTENTS("hello world", 11, data->file);
+}
+
+CTEST2(patch, apply_truncation) {
+    const unsigned char ips[] = "PATCH" "EOF" "\x00\x00\x05";
+    unlink(data->patch);
+    FILE* f = fopen(data->patch, "wb");
+    fwrite(ips, 1, sizeof(ips) - 1, f);
+    fclose(f);
+
+    ASSERT_TRUE(hedit_patch_apply(data->file, data->patch));
+    ASSERT_CONTENTS("hello", 5, data->file);
+}
+
+CTEST2(patch, malformed_patch_leaves_file_untouched) {
+    const unsigned char ips[] = "PATCH" "\x00\x00\x00" "\x00\x05" "HELLO" "\x00\x00\x06" "\x00\x05" "WO";
+    unlink(data->patch);
+    FILE* f = fopen(data->patch, "wb");
+    fwrite(ips, 1, sizeof(ips) - 1, f);
+    fclose(f);
+
+    ASSERT_FALSE(hedit_patch_apply(data->file, data->patch));
+    ASSERT_CONTENTS("hello world", 11, data->file);
+
+    // The partial patch cannot be redone
+    size_t pos;
+    ASSERT_FALSE(hedit_file_redo(data->file, &pos));
+    ASSERT_CONTENTS("hello world", 11, data->file);
+}
+
+CTEST2(patch, records_past_the_end_extend_the_file_with_zeros) {
+    const unsigned char ips[] = "PATCH" "\x00\x00\x0E" "\x00\x01" "!" "EOF";
+    unlink(data->patch);
+    FILE* f = fopen(data->patch, "wb");
+    fwrite(ips, 1, sizeof(ips) - 1, f);
+    fclose(f);
+
+    ASSERT_TRUE(hedit_patch_apply(data->file, data->patch));
+    ASSERT_CONTENTS("hello world\0\0\0!", 15, data->file);
+}
+
+CTEST2(patch, records_too_far_past_the_end_are_rejected) {
+    const unsigned char ips[] = "IPS32" "\x7F\x00\x00\x00" "\x00\x01" "!" "EEOF";
+    unlink(data->patch);
+    FILE* f = fopen(data->patch, "wb");
+    fwrite(ips, 1, sizeof(ips) - 1, f);
+    fclose(f);
+
+    ASSERT_FALSE(hedit_patch_apply(data->file, data->patch));
+    ASSERT_CONTENTS("hello world", 11, data->file);
+}
+
+CTEST2(patch, export_roundtrip) {
+    hedit_file_replace(data->file, 0, "H", 1);
+    hedit_file_insert(data->file, 5, ",", 1);
+    hedit_file_insert(data->file, 12, "!!!!!!!!!!", 10);
+    ASSERT_CONTENTS("Hello, world!!!!!!!!!!", 22, data->file);
+
+    ASSERT_TRUE(hedit_patch_export(data->file, data->patch));
+
+    File* other = hedit_file_open(data->original);
+    ASSERT_NOT_NULL(other);
+    ASSERT_TRUE(hedit_patch_apply(other, data->patch));
+    ASSERT_CONTENTS("Hello, world!!!!!!!!!!", 22, other);
+    hedit_file_close(other);
+}
+
+CTEST2(patch, export_shrunk_file) {
+    hedit_file_delete(data->file, 0, 6);
+    ASSERT_TRUE(hedit_patch_export(data->file, data->patch));
+
+    File* other = hedit_file_open(data->original);
+    ASSERT_NOT_NULL(other);
+    ASSERT_TRUE(hedit_patch_apply(other, data->patch));
+    ASSERT_CONTENTS("world", 5, other);
+    hedit_file_close(other);
+}
+
+
+#pragma GCC diagnostic pop
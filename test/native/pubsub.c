@@ -1,3 +1,5 @@
+#include <stdlib.h>
+
 #include "util/pubsub.h"
 #include "ctest.h"
 
@@ -20,6 +22,35 @@ void increment_handler(PubSub* pubsub, const char* topic, void* data, void* user
     (*((int*) user))++;
 }
 
+typedef struct {
+    int calls;
+    int count;
+} Republisher;
+
+typedef struct {
+    Subscription* victim;
+    int* victim_count;
+} Unsubscriber;
+
+// Cancels another subscription and frees its counter, the first time only
+void unsubscribe_handler(PubSub* pubsub, const char* topic, void* data, void* user) {
+    Unsubscriber* u = user;
+    if (u->victim != NULL) {
+        pubsub_unregister(u->victim);
+        free(u->victim_count);
+        u->victim = NULL;
+    }
+}
+
+// Subscribes to the topic and publishes it again, the first time only
+void republish_handler(PubSub* pubsub, const char* topic, void* data, void* user) {
+    Republisher* r = user;
+    if (r->calls++ == 0) {
+        pubsub_register(pubsub, topic, increment_handler, &r->count);
+        pubsub_publish(pubsub, topic, NULL);
+    }
+}
+
 
 CTEST2(pubsub, subscriptions_can_be_canceled) {
     int count = 0;
@@ -140,3 +171,87 @@ CTEST2(pubsub, handlers_registered_with_comma_filter_are_called_more_than_once_i
     pubsub_publish(data->pubsub, "A.B", NULL);
     ASSERT_EQUAL(2, count);
 }
+
+CTEST2(pubsub, interned_topics_have_stable_ids) {
+    int a = pubsub_topic_intern(data->pubsub, "A");
+    int b = pubsub_topic_intern(data->pubsub, "B");
+    ASSERT_TRUE(a >= 0);
+    ASSERT_TRUE(b >= 0);
+    ASSERT_NOT_EQUAL(a, b);
+    ASSERT_EQUAL(a, pubsub_topic_intern(data->pubsub, "A"));
+}
+
+CTEST2(pubsub, interned_topics_follow_the_subscriptions) {
+    int count1 = 0;
+    int count2 = 0;
+    int topic = pubsub_topic_intern(data->pubsub, "A.B");
+
+    // Nobody is listening yet
+    pubsub_publish_interned(data->pubsub, topic, NULL);
+
+    Subscription* sub1 = pubsub_register(data->pubsub, "A.*", increment_handler, &count1);
+    pubsub_publish_interned(data->pubsub, topic, NULL);
+    ASSERT_EQUAL(1, count1);
+
+    Subscription* sub2 = pubsub_register(data->pubsub, "A.B,C", increment_handler, &count2);
+    pubsub_publish_interned(data->pubsub, topic, NULL);
+    pubsub_publish(data->pubsub, "A.B", NULL);
+    ASSERT_EQUAL(3, count1);
+    ASSERT_EQUAL(2, count2);
+
+    pubsub_unregister(sub1);
+    pubsub_publish_interned(data->pubsub, topic, NULL);
+    ASSERT_EQUAL(3, count1);
+    ASSERT_EQUAL(3, count2);
+
+    pubsub_unregister(sub2);
+    pubsub_publish_interned(data->pubsub, topic, NULL);
+    ASSERT_EQUAL(3, count2);
+}
+
+CTEST2(pubsub, handlers_can_subscribe_and_publish_the_same_topic) {
+    Republisher r = { 0 };
+    int after = 0;
+    pubsub_topic_intern(data->pubsub, "A");
+    pubsub_register(data->pubsub, "A", republish_handler, &r);
+    pubsub_register(data->pubsub, "A", increment_handler, &after);
+
+    // The nested publication calls the new handler too, while the outer one calls only the previous ones
+    pubsub_publish(data->pubsub, "A", NULL);
+    ASSERT_EQUAL(2, r.calls);
+    ASSERT_EQUAL(1, r.count);
+    ASSERT_EQUAL(2, after);
+
+    pubsub_publish(data->pubsub, "A", NULL);
+    ASSERT_EQUAL(3, r.calls);
+    ASSERT_EQUAL(2, r.count);
+    ASSERT_EQUAL(3, after);
+}
+
+CTEST2(pubsub, handlers_unregistered_during_a_publication_are_not_called) {
+    pubsub_topic_intern(data->pubsub, "A");
+
+    // Both for an interned topic and for one that is not
+    const char* topics[] = { "A", "B" };
+    for (int i = 0; i < 2; i++) {
+        int* count = calloc(1, sizeof(int));
+        ASSERT_NOT_NULL(count);
+        int after = 0;
+        Unsubscriber u = { 0 };
+        pubsub_register(data->pubsub, topics[i], unsubscribe_handler, &u);
+        u.victim = pubsub_register(data->pubsub, topics[i], increment_handler, count);
+        u.victim_count = count;
+        pubsub_register(data->pubsub, topics[i], increment_handler, &after);
+
+        pubsub_publish(data->pubsub, topics[i], NULL);
+        ASSERT_NULL(u.victim);
+        ASSERT_EQUAL(1, after);
+        pubsub_publish(data->pubsub, topics[i], NULL);
+        ASSERT_EQUAL(2, after);
+    }
+}
+
+CTEST2(pubsub, publishing_does_not_intern_the_topic) {
+    pubsub_publish(data->pubsub, "A", NULL);
+    ASSERT_EQUAL(0, pubsub_topic_intern(data->pubsub, "B"));
+}
@@ -0,0 +1,85 @@
+#include "util/segindex.h"
+#include "ctest.h"
+
+CTEST_DATA(segindex) {
+    SegmentIndex* idx;
+};
+
+CTEST_SETUP(segindex) {
+    data->idx = segindex_new();
+    ASSERT_NOT_NULL(data->idx);
+}
+
+CTEST_TEARDOWN(segindex) {
+    segindex_free(data->idx);
+}
+
+CTEST2(segindex, initial_len_is_zero) {
+    ASSERT_EQUAL(0, segindex_len(data->idx));
+    ASSERT_EQUAL(0, segindex_find(data->idx, 0));
+    ASSERT_FALSE(segindex_get(data->idx, 0, NULL, NULL, NULL, NULL));
+}
+
+CTEST2(segindex, find_returns_the_first_segment_ending_after_pos) {
+    // Segments with a gap between 10 and 19
+    ASSERT_TRUE(segindex_append(data->idx, 0, 3, 1, 0));
+    ASSERT_TRUE(segindex_append(data->idx, 4, 9, 2, 7));
+    ASSERT_TRUE(segindex_append(data->idx, 20, 29, 3, 0));
+
+    ASSERT_EQUAL(0, segindex_find(data->idx, 0));
+    ASSERT_EQUAL(0, segindex_find(data->idx, 3));
+    ASSERT_EQUAL(1, segindex_find(data->idx, 4));
+    ASSERT_EQUAL(2, segindex_find(data->idx, 15));
+    ASSERT_EQUAL(2, segindex_find(data->idx, 29));
+    ASSERT_EQUAL(3, segindex_find(data->idx, 30));
+
+    size_t from, to;
+    int color, name;
+    ASSERT_TRUE(segindex_get(data->idx, 1, &from, &to, &color, &name));
+    ASSERT_EQUAL(4, from);
+    ASSERT_EQUAL(9, to);
+    ASSERT_EQUAL(2, color);
+    ASSERT_EQUAL(7, name);
+}
+
+CTEST2(segindex, many_appends_and_truncation) {
+    for (size_t i = 0; i < 100000; i++) {
+        ASSERT_TRUE(segindex_append(data->idx, i * 2, i * 2 + 1, 0, 0));
+    }
+    ASSERT_EQUAL(100000, segindex_len(data->idx));
+    ASSERT_EQUAL(12345, segindex_find(data->idx, 24691));
+
+    segindex_truncate(data->idx, 10);
+    ASSERT_EQUAL(10, segindex_len(data->idx));
+    ASSERT_EQUAL(10, segindex_find(data->idx, 24691));
+
+    // Appending after a truncation overwrites the dropped segments
+    ASSERT_TRUE(segindex_append(data->idx, 20, 99, 5, 0));
+    ASSERT_EQUAL(10, segindex_find(data->idx, 50));
+}
+
+CTEST2(segindex, drop_shifts_the_remaining_segments) {
+    for (size_t i = 0; i < 10; i++) {
+        ASSERT_TRUE(segindex_append(data->idx, i * 10, i * 10 + 9, (int) i, (int) i));
+    }
+    size_t memory = segindex_get_memory(data->idx);
+
+    segindex_drop(data->idx, 4);
+    ASSERT_EQUAL(6, segindex_len(data->idx));
+    ASSERT_EQUAL(0, segindex_find(data->idx, 15));
+    ASSERT_EQUAL(1, segindex_find(data->idx, 55));
+
+    size_t from, to;
+    int color, name;
+    ASSERT_TRUE(segindex_get(data->idx, 0, &from, &to, &color, &name));
+    ASSERT_EQUAL(40, from);
+    ASSERT_EQUAL(49, to);
+    ASSERT_EQUAL(4, color);
+    ASSERT_EQUAL(4, name);
+
+    // The memory is kept for the next appends
+    ASSERT_EQUAL(memory, segindex_get_memory(data->idx));
+
+    segindex_drop(data->idx, 100);
+    ASSERT_EQUAL(0, segindex_len(data->idx));
+}
@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "file.h"
+#include "editor.h"
+#include "ctest.h"
+
+
+// Silence warnings about pointer signs.
+// String literals are char*, while most of the File API wants const char*.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-sign"
+
+
+typedef struct {
+    enum ServerStatus status;
+    unsigned char data[256];
+    size_t len;
+} Response;
+
+static void put_le(unsigned char* buf, uint64_t n, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (n >> (i * 8)) & 0xFF;
+    }
+}
+
+static uint64_t get_le(const unsigned char* buf, size_t size) {
+    uint64_t n = 0;
+    for (size_t i = 0; i < size; i++) {
+        n |= (uint64_t) buf[i] << (i * 8);
+    }
+    return n;
+}
+
+/** Appends an edit to a batch for `HEDIT_SERVER_OP_APPLY`, returning its new length. */
+static size_t put_edit(unsigned char* batch, size_t len, enum ServerEdit kind, size_t offset, const char* data, size_t data_len) {
+    batch[len] = kind;
+    put_le(batch + len + 1, offset, 8);
+    put_le(batch + len + 9, data_len, 4);
+    if (kind != HEDIT_SERVER_EDIT_DELETE) {
+        memcpy(batch + len + 13, data, data_len);
+        return len + 13 + data_len;
+    }
+    return len + 13;
+}
+
+static void send_request(int fd, enum ServerOp op, const void* payload, size_t len) {
+    unsigned char header[5];
+    header[0] = op;
+    put_le(header + 1, len, 4);
+    ASSERT_EQUAL(5, write(fd, header, 5));
+    if (len > 0) {
+        ASSERT_EQUAL(len, write(fd, payload, len));
+    }
+}
+
+/** Polls the server until the whole response to the last request has been received. */
+static void receive(Server* server, int fd, Response* res) {
+    unsigned char buf[5 + sizeof(res->data)];
+    size_t len = 0;
+    for (int i = 0; i < 10000; i++) {
+        hedit_server_poll(server);
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - len, MSG_DONTWAIT);
+        if (n < 0) {
+            ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+            continue;
+        }
+        ASSERT_TRUE(n > 0);
+        len += n;
+        if (len >= 5 && len == 5 + get_le(buf + 1, 4)) {
+            res->status = buf[0];
+            res->len = len - 5;
+            memcpy(res->data, buf + 5, res->len);
+            return;
+        }
+    }
+    ASSERT_FAIL();
+}
+
+static void request(Server* server, int fd, enum ServerOp op, const void* payload, size_t len, Response* res) {
+    send_request(fd, op, payload, len);
+    receive(server, fd, res);
+}
+
+static void ASSERT_FOUND(Server* server, int fd, const char* pattern, size_t start, enum ServerStatus status, size_t offset) {
+    unsigned char payload[64];
+    put_le(payload, start, 8);
+    put_le(payload + 8, 0, 8);
+    memcpy(payload + 16, pattern, strlen(pattern));
+    Response res;
+    request(server, fd, HEDIT_SERVER_OP_SEARCH, payload, 16 + strlen(pattern), &res);
+    ASSERT_EQUAL(status, res.status);
+    if (status == HEDIT_SERVER_STATUS_OK) {
+        ASSERT_EQUAL(8, res.len);
+        ASSERT_EQUAL(offset, get_le(res.data, 8));
+    }
+}
+
+static void ASSERT_CONTENTS(const unsigned char* expected, size_t len, File* file) {
+    ASSERT_EQUAL(len, hedit_file_size(file));
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c;
+        ASSERT_TRUE(hedit_file_read_byte(file, i, &c));
+        ASSERT_EQUAL(expected[i], c);
+    }
+}
+
+static int connect_client(const char* path) {
+    struct sockaddr_un addr = { 0 };
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQUAL(0, connect(fd, (struct sockaddr*) &addr, sizeof(addr)));
+    return fd;
+}
+
+static void ASSERT_SIZE(Server* server, int fd, enum ServerStatus status, size_t size) {
+    Response res;
+    request(server, fd, HEDIT_SERVER_OP_SIZE, NULL, 0, &res);
+    ASSERT_EQUAL(status, res.status);
+    if (status == HEDIT_SERVER_STATUS_OK) {
+        ASSERT_EQUAL(size, get_le(res.data, 8));
+    }
+}
+
+
+
+CTEST_DATA(server) {
+    char path[32];
+    HEdit* hedit;
+    File* file;
+    Server* server;
+    int fd;
+};
+
+CTEST_SETUP(server) {
+    data->hedit = test_editor();
+    data->file = test_editor_open(data->hedit, "hello world", 11);
+
+    // Only a free name is needed for the socket
+    strcpy(data->path, "/tmp/hedit-test-XXXXXX");
+    int fd = mkstemp(data->path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+    unlink(data->path);
+    data->server = hedit_server_start(data->hedit, data->path);
+    ASSERT_NOT_NULL(data->server);
+    data->fd = connect_client(data->path);
+}
+
+CTEST_TEARDOWN(server) {
+    close(data->fd);
+    hedit_server_stop(data->server);
+}
+
+
+
+CTEST2(server, read) {
+    ASSERT_SIZE(data->server, data->fd, HEDIT_SERVER_STATUS_OK, 11);
+
+    Response res;
+    unsigned char payload[12];
+    put_le(payload, 6, 8);
+    put_le(payload + 8, 3, 4);
+    request(data->server, data->fd, HEDIT_SERVER_OP_READ, payload, 12, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+    ASSERT_DATA("wor", 3, res.data, res.len);
+
+    // Ranges past the end are truncated
+    put_le(payload + 8, 100, 4);
+    request(data->server, data->fd, HEDIT_SERVER_OP_READ, payload, 12, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+    ASSERT_DATA("world", 5, res.data, res.len);
+
+    request(data->server, data->fd, HEDIT_SERVER_OP_READ, payload, 4, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_ERROR, res.status);
+}
+
+CTEST2(server, search_across_pieces) {
+
+    // "hello" and "world" end up in two pieces of the original file, with the inserted ones in between
+    unsigned char batch[64];
+    size_t len = put_edit(batch, 0, HEDIT_SERVER_EDIT_INSERT, 5, "a", 1);
+    len = put_edit(batch, len, HEDIT_SERVER_EDIT_INSERT, 6, "b", 1);
+    Response res;
+    request(data->server, data->fd, HEDIT_SERVER_OP_APPLY, batch, len, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+    ASSERT_CONTENTS("helloab world", 13, data->file);
+
+    ASSERT_FOUND(data->server, data->fd, "hello", 0, HEDIT_SERVER_STATUS_OK, 0);
+    ASSERT_FOUND(data->server, data->fd, "oab w", 0, HEDIT_SERVER_STATUS_OK, 4);
+    ASSERT_FOUND(data->server, data->fd, "ab", 0, HEDIT_SERVER_STATUS_OK, 5);
+    ASSERT_FOUND(data->server, data->fd, "b", 0, HEDIT_SERVER_STATUS_OK, 6);
+    ASSERT_FOUND(data->server, data->fd, "world", 0, HEDIT_SERVER_STATUS_OK, 8);
+    ASSERT_FOUND(data->server, data->fd, "oab w", 5, HEDIT_SERVER_STATUS_NOT_FOUND, 0);
+    ASSERT_FOUND(data->server, data->fd, "abx", 0, HEDIT_SERVER_STATUS_NOT_FOUND, 0);
+    ASSERT_FOUND(data->server, data->fd, "hello", 100, HEDIT_SERVER_STATUS_NOT_FOUND, 0);
+}
+
+CTEST2(server, search_spans_several_polls) {
+
+    // Large enough not to be scanned in a single poll, and sparse so that it costs nothing to create
+    const size_t size = 9 * 1024 * 1024;
+    char path[] = "/tmp/hedit-test-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQUAL(0, ftruncate(fd, size));
+    ASSERT_EQUAL(6, pwrite(fd, "needle", 6, size - 10));
+    close(fd);
+    File* file = hedit_file_open(path);
+    unlink(path);
+    ASSERT_NOT_NULL(file);
+    ASSERT_TRUE(hedit_buffer_open(data->hedit, file));
+
+    ASSERT_FOUND(data->server, data->fd, "needle", 0, HEDIT_SERVER_STATUS_OK, size - 10);
+
+    // Changing the file while the search is pending would make the result meaningless
+    unsigned char payload[22];
+    put_le(payload, 0, 8);
+    put_le(payload + 8, 0, 8);
+    memcpy(payload + 16, "needle", 6);
+    send_request(data->fd, HEDIT_SERVER_OP_SEARCH, payload, 22);
+    hedit_server_poll(data->server);
+    ASSERT_TRUE(hedit_file_insert(file, 0, "x", 1));
+    Response res;
+    receive(data->server, data->fd, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_ERROR, res.status);
+}
+
+CTEST2(server, apply) {
+    unsigned char batch[128];
+    Response res;
+
+    // The delete would only be in range if it were not for the previous edits
+    size_t len = put_edit(batch, 0, HEDIT_SERVER_EDIT_INSERT, 0, "x", 1);
+    len = put_edit(batch, len, HEDIT_SERVER_EDIT_DELETE, 0, NULL, 2);
+    len = put_edit(batch, len, HEDIT_SERVER_EDIT_DELETE, 10, NULL, 1);
+    request(data->server, data->fd, HEDIT_SERVER_OP_APPLY, batch, len, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_ERROR, res.status);
+    ASSERT_CONTENTS("hello world", 11, data->file);
+
+    len = put_edit(batch, 0, HEDIT_SERVER_EDIT_INSERT, 11, "!", 1);
+    len = put_edit(batch, len, HEDIT_SERVER_EDIT_REPLACE, 0, "HELLO", 5);
+    len = put_edit(batch, len, HEDIT_SERVER_EDIT_DELETE, 5, NULL, 1);
+    len = put_edit(batch, len, HEDIT_SERVER_EDIT_INSERT, 5, ", ", 2);
+    request(data->server, data->fd, HEDIT_SERVER_OP_APPLY, batch, len, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+    ASSERT_CONTENTS("HELLO, world!", 13, data->file);
+
+    // Truncated batch
+    request(data->server, data->fd, HEDIT_SERVER_OP_APPLY, batch, 20, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_ERROR, res.status);
+    ASSERT_CONTENTS("HELLO, world!", 13, data->file);
+}
+
+CTEST2(server, commit) {
+    unsigned char batch[64];
+    Response res;
+
+    size_t len = put_edit(batch, 0, HEDIT_SERVER_EDIT_DELETE, 0, NULL, 6);
+    request(data->server, data->fd, HEDIT_SERVER_OP_APPLY, batch, len, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+    len = put_edit(batch, 0, HEDIT_SERVER_EDIT_INSERT, 5, "!", 1);
+    request(data->server, data->fd, HEDIT_SERVER_OP_APPLY, batch, len, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+    request(data->server, data->fd, HEDIT_SERVER_OP_COMMIT, NULL, 0, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+    ASSERT_CONTENTS("world!", 6, data->file);
+
+    // Both the batches are undone together
+    size_t pos;
+    ASSERT_TRUE(hedit_file_undo(data->file, &pos));
+    ASSERT_CONTENTS("hello world", 11, data->file);
+}
+
+CTEST2(server, save) {
+    unsigned char batch[64];
+    Response res;
+
+    size_t len = put_edit(batch, 0, HEDIT_SERVER_EDIT_REPLACE, 0, "H", 1);
+    request(data->server, data->fd, HEDIT_SERVER_OP_APPLY, batch, len, &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+
+    char path[] = "/tmp/hedit-test-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+    request(data->server, data->fd, HEDIT_SERVER_OP_SAVE, path, strlen(path), &res);
+    ASSERT_EQUAL(HEDIT_SERVER_STATUS_OK, res.status);
+
+    // The file may have been replaced by the save, read it again by name
+    char contents[32];
+    FILE* in = fopen(path, "r");
+    ASSERT_NOT_NULL(in);
+    size_t n = fread(contents, 1, sizeof(contents), in);
+    fclose(in);
+    unlink(path);
+    ASSERT_DATA("Hello world", 11, contents, n);
+}
+
+CTEST2(server, clients_stay_on_their_buffer) {
+    ASSERT_SIZE(data->server, data->fd, HEDIT_SERVER_STATUS_OK, 11);
+
+    // Clients keep working on the buffer that was active at their first request
+    test_editor_open(data->hedit, "other", 5);
+    int other = connect_client(data->path);
+    ASSERT_SIZE(data->server, data->fd, HEDIT_SERVER_STATUS_OK, 11);
+    ASSERT_SIZE(data->server, other, HEDIT_SERVER_STATUS_OK, 5);
+    ASSERT_TRUE(hedit_buffer_switch(data->hedit, 0));
+    ASSERT_SIZE(data->server, other, HEDIT_SERVER_STATUS_OK, 5);
+
+    // Then fail once it is closed, even if another one takes its place
+    hedit_buffer_close(data->hedit);
+    ASSERT_SIZE(data->server, data->fd, HEDIT_SERVER_STATUS_ERROR, 0);
+    ASSERT_SIZE(data->server, other, HEDIT_SERVER_STATUS_OK, 5);
+    close(other);
+
+    // Clients that sent their first request with no buffer open bind to the next one
+    hedit_buffer_close(data->hedit);
+    int late = connect_client(data->path);
+    ASSERT_SIZE(data->server, late, HEDIT_SERVER_STATUS_ERROR, 0);
+    test_editor_open(data->hedit, "late", 4);
+    ASSERT_SIZE(data->server, late, HEDIT_SERVER_STATUS_OK, 4);
+    close(late);
+}
+
+
+#pragma GCC diagnostic pop
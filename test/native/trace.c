@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/trace.h"
+#include "ctest.h"
+
+static char* read_all(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* buf = calloc(len + 1, 1);
+    if (buf != NULL && fread(buf, 1, len, f) != len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+CTEST(trace, nothing_is_recorded_when_disabled) {
+    ASSERT_FALSE(trace_enabled);
+    TRACE_BEGIN("ignored");
+    TRACE_END("ignored");
+    trace_stop();
+}
+
+CTEST(trace, spans_are_written_on_stop) {
+    char path[] = "/tmp/hedit-trace-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0);
+    close(fd);
+
+    ASSERT_TRUE(trace_start(path));
+    TRACE_BEGIN("outer");
+    TRACE_BEGIN_ARG("inner", "<lt>\"\\");
+    TRACE_END("inner");
+    TRACE_END("outer");
+    trace_stop();
+    ASSERT_FALSE(trace_enabled);
+
+    char* json = read_all(path);
+    unlink(path);
+    ASSERT_NOT_NULL(json);
+    ASSERT_TRUE(strncmp(json, "{\"traceEvents\":[", 16) == 0);
+    ASSERT_NOT_NULL(strstr(json, "{\"ph\":\"B\",\"pid\":1,\"tid\":1,\"ts\":0,\"name\":\"outer\"}"));
+    ASSERT_NOT_NULL(strstr(json, "\"name\":\"inner\",\"args\":{\"detail\":\"<lt>\\\"\\\\\"}"));
+    ASSERT_NOT_NULL(strstr(json, "\"ph\":\"E\""));
+    ASSERT_NOT_NULL(strstr(json, "]}"));
+    free(json);
+}
+
+CTEST(trace, invalid_paths_are_reported) {
+    ASSERT_FALSE(trace_start("/nonexistent/dir/trace.json"));
+    ASSERT_FALSE(trace_enabled);
+}
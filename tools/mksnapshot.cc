@@ -0,0 +1,24 @@
+// Build time tool to generate the V8 startup snapshot with the builtin modules.
+// Usage: hedit_mksnapshot <path_to_output_file>
+
+#include <stdio.h>
+
+#include "js.h"
+#include "util/log.h"
+
+// The generator obviously runs without a snapshot
+v8::StartupData hedit_js_snapshot = { nullptr, 0 };
+
+int main(int argc, char** argv) {
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <output_file>\n", argv[0]);
+        return 1;
+    }
+
+    log_init();
+    bool ok = hedit_js_write_snapshot(argv[1]);
+    log_teardown();
+
+    return ok ? 0 : 1;
+}